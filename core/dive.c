@@ -3353,7 +3353,12 @@ struct dive *find_dive_n_near(timestamp_t when, int n, timestamp_t offset)
 	int i, j = 0;
 	struct dive *dive;
 
-	for_each_dive (i, dive) {
+	/* Only dives starting within the offset can be in range. Since the
+	 * dive table is sorted by start time, search for the first one. */
+	for (i = first_dive_after(when - offset - 1); i < dive_table.nr; i++) {
+		dive = dive_table.dives[i];
+		if (dive->when > when + offset)
+			break;
 		if (dive_within_time_range(dive, when, offset))
 			if (++j == n)
 				return dive;
@@ -3499,42 +3504,98 @@ static bool dive_check_picture_time(const struct dive *d, timestamp_t timestamp)
 	return time_from_dive(d, timestamp) < D30MIN;
 }
 
-/* Return dive closest selected dive to given timestamp or NULL if no dives are selected. */
-static struct dive *nearest_selected_dive(timestamp_t timestamp)
+struct picture_time {
+	timestamp_t timestamp;
+	int idx;
+};
+
+static int comp_picture_time(const void *_a, const void *_b)
 {
-	struct dive *d, *res = NULL;
-	int i;
-	timestamp_t offset, min = 0;
+	const struct picture_time *a = _a, *b = _b;
+	if (a->timestamp != b->timestamp)
+		return a->timestamp < b->timestamp ? -1 : 1;
+	return a->idx - b->idx;
+}
 
-	for_each_dive(i, d) {
-		if (!d->selected)
-			continue;
-		offset = time_from_dive(d, timestamp);
-		if (!res || offset < min) {
-			res = d;
-			min = offset;
-		}
+/*
+ * For each of the nr timestamps, find the closest selected dive after adding
+ * shift_time to the timestamp. If match_all is false, only dives within 30
+ * minutes of the timestamp are considered. The result is written to dives[],
+ * NULL meaning that no dive matched.
+ *
+ * The timestamps are sorted and swept against the selected dives, which are
+ * sorted chronologically in the dive table. Thus, this is O(N log N + M) for
+ * N timestamps and M dives, instead of searching the dives for every timestamp.
+ *
+ * For each timestamp, the candidates are the dive with the latest end time
+ * of all dives that started before the timestamp and the first dive that
+ * starts after it. If the dives overlap and the timestamp is within several
+ * dives, the dive that started last is preferred. If two candidates are
+ * equally close, the earlier dive is preferred.
+ */
+void match_pictures_to_dives(int nr, const timestamp_t timestamps[], int shift_time, bool match_all, struct dive *dives[])
+{
+	struct picture_time *sorted;
+	struct dive *last_started = NULL, *latest_end = NULL;
+	timestamp_t latest_end_time = 0;
+	int i, j, k;
 
-		/* We suppose that dives are sorted chronologically. Thus
-		 * if the offset starts to increase, we can end. This ignores
-		 * pathological cases such as overlapping dives. In such a
-		 * case the user will have to add pictures manually.
-		 */
-		if (offset == 0 || offset > min)
-			break;
+	if (nr <= 0)
+		return;
+	sorted = malloc(nr * sizeof(*sorted));
+	if (!sorted)
+		exit(1);
+	for (i = 0; i < nr; i++) {
+		sorted[i].timestamp = timestamps[i] + shift_time;
+		sorted[i].idx = i;
 	}
-	return res;
+	qsort(sorted, nr, sizeof(*sorted), comp_picture_time);
+
+	j = k = 0;
+	for (i = 0; i < nr; i++) {
+		timestamp_t timestamp = sorted[i].timestamp;
+		struct dive *before = NULL, *after = NULL, *dive;
+
+		/* Advance over the selected dives that started before the timestamp */
+		for (; j < dive_table.nr && dive_table.dives[j]->when <= timestamp; j++) {
+			struct dive *d = dive_table.dives[j];
+			timestamp_t end_time;
+			if (!d->selected)
+				continue;
+			last_started = d;
+			end_time = dive_endtime(d);
+			if (!latest_end || end_time > latest_end_time) {
+				latest_end = d;
+				latest_end_time = end_time;
+			}
+		}
+		if (last_started)
+			before = time_from_dive(last_started, timestamp) == 0 ? last_started : latest_end;
+		/* Find the first selected dive that starts after the timestamp */
+		if (k < j)
+			k = j;
+		while (k < dive_table.nr && !dive_table.dives[k]->selected)
+			k++;
+		if (k < dive_table.nr)
+			after = dive_table.dives[k];
+
+		if (!before || !after)
+			dive = before ? before : after;
+		else
+			dive = time_from_dive(after, timestamp) < time_from_dive(before, timestamp) ? after : before;
+		if (dive && !match_all && !dive_check_picture_time(dive, timestamp))
+			dive = NULL;
+		dives[sorted[i].idx] = dive;
+	}
+	free(sorted);
 }
 
 bool picture_check_valid_time(timestamp_t timestamp, int shift_time)
 {
-	int i;
 	struct dive *dive;
 
-	for_each_dive (i, dive)
-		if (dive->selected && dive_check_picture_time(dive, timestamp + shift_time))
-			return true;
-	return false;
+	match_pictures_to_dives(1, &timestamp, shift_time, false, &dive);
+	return dive != NULL;
 }
 
 static void dive_set_geodata_from_picture(struct dive *dive, struct picture *picture, struct dive_site_table *table)
@@ -3551,33 +3612,53 @@ static void dive_set_geodata_from_picture(struct dive *dive, struct picture *pic
 	}
 }
 
-void create_picture(const char *filename, int shift_time, bool match_all)
+static void add_picture_to_dive(struct dive *dive, const char *filename, const struct metadata *metadata, int shift_time)
 {
-	struct metadata metadata;
-	struct dive *dive;
-	timestamp_t timestamp;
-
-	get_metadata(filename, &metadata);
-	timestamp = metadata.timestamp + shift_time;
-	dive = nearest_selected_dive(timestamp);
-
-	if (!dive)
-		return;
 	if (!new_picture_for_dive(dive, filename))
 		return;
-	if (!match_all && !dive_check_picture_time(dive, timestamp))
-		return;
 
 	struct picture *picture = alloc_picture();
 	picture->filename = strdup(filename);
-	picture->offset.seconds = metadata.timestamp - dive->when + shift_time;
-	picture->location = metadata.location;
+	picture->offset.seconds = metadata->timestamp - dive->when + shift_time;
+	picture->location = metadata->location;
 
 	dive_add_picture(dive, picture);
 	dive_set_geodata_from_picture(dive, picture, &dive_site_table);
 	invalidate_dive_cache(dive);
 }
 
+void create_picture(const char *filename, int shift_time, bool match_all)
+{
+	struct metadata metadata;
+
+	get_metadata(filename, &metadata);
+	create_pictures(1, &filename, &metadata, shift_time, match_all);
+}
+
+/* Add multiple pictures, whose metadata was read already, to the selected dives */
+void create_pictures(int nr, const char *filenames[], const struct metadata *metadata, int shift_time, bool match_all)
+{
+	timestamp_t *timestamps;
+	struct dive **dives;
+	int i;
+
+	if (nr <= 0)
+		return;
+	timestamps = malloc(nr * sizeof(*timestamps));
+	dives = malloc(nr * sizeof(*dives));
+	if (!timestamps || !dives)
+		exit(1);
+	for (i = 0; i < nr; i++)
+		timestamps[i] = metadata[i].timestamp;
+	match_pictures_to_dives(nr, timestamps, shift_time, match_all, dives);
+	for (i = 0; i < nr; i++) {
+		if (dives[i])
+			add_picture_to_dive(dives[i], filenames[i], &metadata[i], shift_time);
+	}
+	free(timestamps);
+	free(dives);
+}
+
 void dive_add_picture(struct dive *dive, struct picture *newpic)
 {
 	struct picture **pic_ptr = &dive->picture_list;
@@ -3959,42 +4040,6 @@ struct divecomputer *get_dive_dc(struct dive *dive, int nr)
 	return dc;
 }
 
-struct dive *get_dive_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return dive;
-}
-
-int get_idx_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return i;
-}
-
 bool dive_site_has_gps_location(const struct dive_site *ds)
 {
 	return ds && has_location(&ds->location);
@@ -217,6 +217,9 @@ struct picture {
 extern struct picture *alloc_picture();
 extern void free_picture(struct picture *picture);
 extern void create_picture(const char *filename, int shift_time, bool match_all);
+struct metadata;
+extern void create_pictures(int nr, const char *filenames[], const struct metadata *metadata, int shift_time, bool match_all);
+extern void match_pictures_to_dives(int nr, const timestamp_t timestamps[], int shift_time, bool match_all, struct dive *dives[]);
 extern void dive_add_picture(struct dive *d, struct picture *newpic);
 extern bool dive_remove_picture(struct dive *d, const char *filename);
 extern unsigned int dive_get_picture_count(struct dive *d);
@@ -313,6 +316,7 @@ extern int save_dive_sites_logic(const char *filename, bool select_only, bool an
 
 struct membuffer;
 extern void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize);
+extern void save_dives_buffer(struct membuffer *b, const bool select_only, bool anonymize);
 
 struct user_info {
 	char *name;
@@ -0,0 +1,408 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "core/divefilter.h"
+#include "core/dive.h"
+#include "core/divesite.h"
+#include "core/divesummary.h"
+#include "core/fulltext.h"
+#include "core/gettextfromc.h"
+#include "core/pref.h"
+#include "core/qthelper.h"
+#include "core/subsurface-string.h"
+#include "core/tag.h"
+#include "core/trip.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdint.h>
+
+namespace {
+	// Check if a string-list contains at least one string containing the second argument.
+	// Comparison is non case sensitive and removes white space.
+	bool listContainsSuperstring(const QStringList &list, const QString &s)
+	{
+		return std::any_of(list.begin(), list.end(), [&s](const QString &s2)
+				   { return s2.trimmed().contains(s.trimmed(), Qt::CaseInsensitive); } );
+	}
+
+	// Check whether either all, any or none of the items of the first list is
+	// in the second list as a super string.
+	// The mode is controlled by the second argument
+	bool check(const QStringList &items, const QStringList &list, FilterData::Mode mode)
+	{
+		bool negate = mode == FilterData::Mode::NONE_OF;
+		bool any_of = mode == FilterData::Mode::ANY_OF;
+		auto fun = [&list, negate](const QString &item)
+			   { return listContainsSuperstring(list, item) != negate; };
+		return any_of ? std::any_of(items.begin(), items.end(), fun)
+			      : std::all_of(items.begin(), items.end(), fun);
+	}
+
+	QStringList getPersons(const struct dive *d)
+	{
+		return QString(d->buddy).split(",", QString::SkipEmptyParts)
+			+ QString(d->divemaster).split(",", QString::SkipEmptyParts);
+	}
+
+	bool hasPersons(const QStringList &people, const struct dive *d, FilterData::Mode mode)
+	{
+		if (people.isEmpty())
+			return true;
+		return check(people, getPersons(d), mode);
+	}
+
+	QStringList getLocations(const struct dive *d)
+	{
+		QStringList diveLocations;
+		if (d->divetrip)
+			diveLocations.push_back(QString(d->divetrip->location));
+
+		if (d->dive_site)
+			diveLocations.push_back(QString(d->dive_site->name));
+		return diveLocations;
+	}
+
+	bool hasLocations(const QStringList &locations, const struct dive *d, FilterData::Mode mode)
+	{
+		if (locations.isEmpty())
+			return true;
+		return check(locations, getLocations(d), mode);
+	}
+
+	// TODO: Finish this implementation.
+	bool hasEquipment(const QStringList &, const struct dive *, FilterData::Mode)
+	{
+		return true;
+	}
+
+	QStringList getSuits(const struct dive *d)
+	{
+		QStringList diveSuits;
+		if (d->suit)
+			diveSuits.push_back(QString(d->suit));
+		return diveSuits;
+	}
+
+	bool hasSuits(const QStringList &suits, const struct dive *d, FilterData::Mode mode)
+	{
+		if (suits.isEmpty())
+			return true;
+		return check(suits, getSuits(d), mode);
+	}
+
+	QStringList getNotes(const struct dive *d)
+	{
+		QStringList diveNotes;
+		if (d->notes)
+			diveNotes.push_back(QString(d->notes));
+		return diveNotes;
+	}
+
+	bool hasNotes(const QStringList &dnotes, const struct dive *d, FilterData::Mode mode)
+	{
+		if (dnotes.isEmpty())
+			return true;
+		return check(dnotes, getNotes(d), mode);
+	}
+
+	// Evaluate a text filter for all dives using the full text index.
+	// The index returns candidates for each item, which are then checked
+	// with the same criterion as in the per-dive functions above.
+	// If the index can't be used, e.g. because an item doesn't contain
+	// any word characters, an invalid filter is returned and the dives
+	// are checked individually.
+	FullTextFilter makeFullTextFilter(const QStringList &items, FilterData::Mode mode, int field,
+					  QStringList (*getList)(const struct dive *))
+	{
+		FullTextFilter res;
+		if (items.isEmpty())
+			return res;
+
+		// For "none of", collect the dives that match any of the items and negate.
+		bool any_of = mode != FilterData::Mode::ALL_OF;
+		std::vector<dive *> candidates, merged;
+		for (int i = 0; i < items.size(); ++i) {
+			if (!FullTextIndex::instance()->findDives(field, items[i].trimmed(), candidates))
+				return FullTextFilter();
+			const QString &item = items[i];
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+						[&item, getList](const dive *d) { return !listContainsSuperstring(getList(d), item); }),
+					 candidates.end());
+			if (i == 0) {
+				res.dives.swap(candidates);
+				continue;
+			}
+			merged.clear();
+			if (any_of)
+				std::set_union(res.dives.begin(), res.dives.end(), candidates.begin(), candidates.end(), std::back_inserter(merged));
+			else
+				std::set_intersection(res.dives.begin(), res.dives.end(), candidates.begin(), candidates.end(), std::back_inserter(merged));
+			res.dives.swap(merged);
+		}
+		res.valid = true;
+		res.negate = mode == FilterData::Mode::NONE_OF;
+		return res;
+	}
+
+	bool accepts(const FullTextFilter &filter, const struct dive *d)
+	{
+		return std::binary_search(filter.dives.begin(), filter.dives.end(), d) != filter.negate;
+	}
+
+	// The number of dives accepted by a full text filter. Used to test the most selective filters first.
+	size_t acceptedCount(const FullTextFilter &filter)
+	{
+		return filter.negate ? (size_t)dive_table.nr - std::min(filter.dives.size(), (size_t)dive_table.nr)
+				     : filter.dives.size();
+	}
+
+	bool nameMatches(const char *name, const QString &item)
+	{
+		return QString(name).trimmed().contains(item, Qt::CaseInsensitive);
+	}
+}
+
+DiveFilter::DiveFilter()
+{
+	compile();
+}
+
+void DiveFilter::setFilter(const FilterData &dataIn)
+{
+	data = dataIn;
+	compile();
+}
+
+const FilterData &DiveFilter::filterData() const
+{
+	return data;
+}
+
+void DiveFilter::compile()
+{
+	criteria.clear();
+	tagItems.clear();
+	knownTags.clear();
+	clearFullText();
+	if (!data.validFilter)
+		return;
+
+	// The numerical criteria first, since these are the cheapest
+	criteria.push_back(Criterion::RATING);
+	criteria.push_back(Criterion::VISIBILITY);
+
+	auto temp_comp = prefs.units.temperature == units::CELSIUS ? C_to_mkelvin : F_to_mkelvin;
+	minWaterTemp = (*temp_comp)(data.minWaterTemp);
+	maxWaterTemp = (*temp_comp)(data.maxWaterTemp);
+	minAirTemp = (*temp_comp)(data.minAirTemp);
+	maxAirTemp = (*temp_comp)(data.maxAirTemp);
+	criteria.push_back(Criterion::WATER_TEMP);
+	criteria.push_back(Criterion::AIR_TEMP);
+
+	QDateTime t = data.fromDate;
+	t.setTime(data.fromTime);
+	if (data.fromDate.isValid() && data.fromTime.isValid()) {
+		fromWhen = t.toMSecsSinceEpoch()/1000 + t.offsetFromUtc();
+		criteria.push_back(Criterion::FROM_DATE);
+	}
+
+	t = data.toDate;
+	t.setTime(data.toTime);
+	if (data.toDate.isValid() && data.toTime.isValid()) {
+		toWhen = t.toMSecsSinceEpoch()/1000 + t.offsetFromUtc();
+		criteria.push_back(Criterion::TO_DATE);
+	}
+
+	if (!data.logged)
+		criteria.push_back(Criterion::LOGGED);
+	if (!data.planned)
+		criteria.push_back(Criterion::PLANNED);
+
+	// For tags, match the filter items against the global tag list once.
+	// Dives usually refer to the tags of the global list, only for
+	// other tags the names have to be compared.
+	if (!data.tags.isEmpty()) {
+		for (struct tag_entry *entry = g_tag_list; entry; entry = entry->next)
+			knownTags.push_back(entry->tag);
+		std::sort(knownTags.begin(), knownTags.end());
+		for (const QString &s: data.tags) {
+			TagItem item;
+			item.item = s.trimmed();
+			item.all = item.item.isEmpty();
+			for (const divetag *tag: knownTags) {
+				if (!empty_string(tag->name) && nameMatches(tag->name, item.item))
+					item.matches.push_back(tag);
+			}
+			for (int i = 0; i < NUM_DIVEMODE; ++i)
+				item.modeMatches.push_back(gettextFromC::tr(divemode_text_ui[i]).trimmed().contains(item.item, Qt::CaseInsensitive));
+			tagItems.push_back(std::move(item));
+		}
+		criteria.push_back(Criterion::TAGS);
+	}
+
+	// The text criteria last, since these are the most expensive
+	if (!data.people.isEmpty())
+		criteria.push_back(Criterion::PEOPLE);
+	if (!data.location.isEmpty())
+		criteria.push_back(Criterion::LOCATION);
+	if (!data.suit.isEmpty())
+		criteria.push_back(Criterion::SUIT);
+	if (!data.dnotes.isEmpty())
+		criteria.push_back(Criterion::NOTES);
+	if (!data.equipment.isEmpty())
+		criteria.push_back(Criterion::EQUIPMENT);
+}
+
+void DiveFilter::prepareFullText()
+{
+	if (!data.validFilter)
+		return;
+	peopleFilter = makeFullTextFilter(data.people, data.peopleMode, FullTextIndex::PEOPLE, &getPersons);
+	locationFilter = makeFullTextFilter(data.location, data.locationMode, FullTextIndex::LOCATION, &getLocations);
+	suitFilter = makeFullTextFilter(data.suit, data.suitMode, FullTextIndex::SUIT, &getSuits);
+	notesFilter = makeFullTextFilter(data.dnotes, data.dnotesMode, FullTextIndex::NOTES, &getNotes);
+
+	// Now that we know how many dives pass the text criteria, test
+	// the most selective ones first. Unprepared criteria are tested last.
+	auto cost = [this](Criterion c) -> size_t {
+		const FullTextFilter *f = c == Criterion::PEOPLE ? &peopleFilter :
+					  c == Criterion::LOCATION ? &locationFilter :
+					  c == Criterion::SUIT ? &suitFilter :
+					  c == Criterion::NOTES ? &notesFilter : nullptr;
+		return f && f->valid ? acceptedCount(*f) : SIZE_MAX;
+	};
+	auto first = std::find_if(criteria.begin(), criteria.end(), [](Criterion c)
+				  { return c >= Criterion::PEOPLE && c <= Criterion::NOTES; });
+	std::stable_sort(first, criteria.end(), [&cost](Criterion c1, Criterion c2)
+			 { return cost(c1) < cost(c2); });
+}
+
+void DiveFilter::clearFullText()
+{
+	peopleFilter = locationFilter = suitFilter = notesFilter = FullTextFilter();
+}
+
+bool DiveFilter::tagMatches(const TagItem &item, const struct dive *d) const
+{
+	if (item.all)
+		return true;
+	for (const struct tag_entry *entry = d->tag_list; entry; entry = entry->next) {
+		const divetag *tag = entry->tag;
+		if (std::binary_search(item.matches.begin(), item.matches.end(), tag))
+			return true;
+		// Tags that were not in the global list at compile time, e.g. copies
+		// of tags of deleted dives, are compared by name.
+		if (!std::binary_search(knownTags.begin(), knownTags.end(), tag) &&
+		    !empty_string(tag->name) && nameMatches(tag->name, item.item))
+			return true;
+	}
+	int mode = d->dc.divemode;
+	return mode >= 0 && mode < NUM_DIVEMODE && item.modeMatches[mode];
+}
+
+bool DiveFilter::hasTags(const struct dive *d) const
+{
+	bool negate = data.tagsMode == FilterData::Mode::NONE_OF;
+	bool any_of = data.tagsMode == FilterData::Mode::ANY_OF;
+	auto fun = [this, d, negate](const TagItem &item)
+		   { return tagMatches(item, d) != negate; };
+	return any_of ? std::any_of(tagItems.begin(), tagItems.end(), fun)
+		      : std::all_of(tagItems.begin(), tagItems.end(), fun);
+}
+
+bool DiveFilter::check(Criterion c, const struct dive *d) const
+{
+	switch (c) {
+	case Criterion::VISIBILITY:
+		return d->visibility >= data.minVisibility && d->visibility <= data.maxVisibility;
+	case Criterion::RATING:
+		return d->rating >= data.minRating && d->rating <= data.maxRating;
+	case Criterion::WATER_TEMP:
+		return !d->watertemp.mkelvin ||
+		       (d->watertemp.mkelvin >= minWaterTemp && d->watertemp.mkelvin <= maxWaterTemp);
+	case Criterion::AIR_TEMP:
+		return !d->airtemp.mkelvin ||
+		       (d->airtemp.mkelvin >= minAirTemp && d->airtemp.mkelvin <= maxAirTemp);
+	case Criterion::FROM_DATE:
+		return d->when >= fromWhen;
+	case Criterion::TO_DATE:
+		return d->when <= toWhen;
+	case Criterion::LOGGED:
+		return has_planned(d, true);
+	case Criterion::PLANNED:
+		return has_planned(d, false);
+	case Criterion::TAGS:
+		return hasTags(d);
+	case Criterion::PEOPLE:
+		return peopleFilter.valid ? accepts(peopleFilter, d) : hasPersons(data.people, d, data.peopleMode);
+	case Criterion::LOCATION:
+		return locationFilter.valid ? accepts(locationFilter, d) : hasLocations(data.location, d, data.locationMode);
+	case Criterion::SUIT:
+		return suitFilter.valid ? accepts(suitFilter, d) : hasSuits(data.suit, d, data.suitMode);
+	case Criterion::NOTES:
+		return notesFilter.valid ? accepts(notesFilter, d) : hasNotes(data.dnotes, d, data.dnotesMode);
+	case Criterion::EQUIPMENT:
+		return hasEquipment(data.equipment, d, data.equipmentMode);
+	}
+	return true;
+}
+
+bool DiveFilter::showDive(const struct dive *d) const
+{
+	if (!data.validFilter)
+		return true;
+	return std::all_of(criteria.begin(), criteria.end(), [this, d](Criterion c) { return check(c, d); });
+}
+
+// Combine the flags with a condition on a row. The loops don't branch,
+// so that the compiler can vectorize them.
+template <typename Func>
+static void scanRows(int from, int to, char *shown, Func f)
+{
+	for (int i = from; i < to; ++i)
+		shown[i] &= f(i);
+}
+
+void DiveFilter::showRows(const DiveSummaryTable &t, int from, int to, char *shown) const
+{
+	std::fill(shown + from, shown + to, 1);
+	if (!data.validFilter)
+		return;
+
+	for (Criterion c: criteria) {
+		switch (c) {
+		case Criterion::VISIBILITY:
+			scanRows(from, to, shown, [&](int i) { return t.visibility[i] >= data.minVisibility && t.visibility[i] <= data.maxVisibility; });
+			break;
+		case Criterion::RATING:
+			scanRows(from, to, shown, [&](int i) { return t.rating[i] >= data.minRating && t.rating[i] <= data.maxRating; });
+			break;
+		case Criterion::WATER_TEMP:
+			scanRows(from, to, shown, [&](int i) { return !t.watertemp[i] ||
+								(t.watertemp[i] >= minWaterTemp && t.watertemp[i] <= maxWaterTemp); });
+			break;
+		case Criterion::AIR_TEMP:
+			scanRows(from, to, shown, [&](int i) { return !t.airtemp[i] ||
+								(t.airtemp[i] >= minAirTemp && t.airtemp[i] <= maxAirTemp); });
+			break;
+		case Criterion::FROM_DATE:
+			scanRows(from, to, shown, [&](int i) { return t.when[i] >= fromWhen; });
+			break;
+		case Criterion::TO_DATE:
+			scanRows(from, to, shown, [&](int i) { return t.when[i] <= toWhen; });
+			break;
+		case Criterion::LOGGED:
+			scanRows(from, to, shown, [&](int i) { return t.planned[i]; });
+			break;
+		case Criterion::PLANNED:
+			scanRows(from, to, shown, [&](int i) { return t.logged[i]; });
+			break;
+		default:
+			// The remaining criteria need the dive itself
+			for (int i = from; i < to; ++i) {
+				if (shown[i])
+					shown[i] = check(c, t.dives[i]);
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0
+// The filter criteria of the dive list and their evaluation.
+#ifndef DIVEFILTER_H
+#define DIVEFILTER_H
+
+#include "core/units.h"
+
+#include <QDateTime>
+#include <QStringList>
+#include <vector>
+
+struct dive;
+struct divetag;
+class DiveSummaryTable;
+
+struct FilterData {
+	// The mode ids are chosen such that they can be directly converted from / to combobox indices.
+	enum class Mode {
+		ALL_OF = 0,
+		ANY_OF = 1,
+		NONE_OF = 2
+	};
+
+	bool validFilter = false;
+	int minVisibility = 0;
+	int maxVisibility = 5;
+	int minRating = 0;
+	int maxRating = 5;
+	// The default minimum and maximum temperatures are set such that all
+	// physically reasonable dives are shown. Note that these values should
+	// work for both Celcius and Fahrenheit scales.
+	double minWaterTemp = -10;
+	double maxWaterTemp = 200;
+	double minAirTemp = -50;
+	double maxAirTemp = 200;
+	QDateTime fromDate = QDateTime(QDate(1980,1,1));
+	QTime fromTime = QTime(0,0);
+	QDateTime toDate = QDateTime::currentDateTime();
+	QTime toTime = QTime::currentTime();
+	QStringList tags;
+	QStringList people;
+	QStringList location;
+	QStringList suit;
+	QStringList dnotes;
+	QStringList equipment;
+	Mode tagsMode = Mode::ALL_OF;
+	Mode peopleMode = Mode::ALL_OF;
+	Mode locationMode = Mode::ANY_OF;
+	Mode dnotesMode = Mode::ALL_OF;
+	Mode suitMode = Mode::ANY_OF;
+	Mode equipmentMode = Mode::ALL_OF;
+	bool logged = true;
+	bool planned = true;
+};
+
+// The result of a text filter evaluated for all dives at once.
+struct FullTextFilter {
+	bool valid = false;		// if false, the filter has to be evaluated per dive
+	bool negate = false;		// if true, accept dives that are *not* in the list
+	std::vector<dive *> dives;	// sorted by pointer value
+};
+
+// The FilterData is not evaluated directly. Instead, when it is set, it is
+// compiled into a list of criteria with precomputed bounds. Criteria that
+// can't reject any dive are left out and the cheap criteria are tested first.
+class DiveFilter {
+public:
+	DiveFilter();
+	void setFilter(const FilterData &data);
+	const FilterData &filterData() const;
+
+	// Recalculate the bounds. Must be called if the units changed.
+	void compile();
+
+	// Evaluate the text criteria for all dives at once using the full
+	// text index. Until clearFullText() is called, showDive() uses the
+	// result of this evaluation, so this must only be used as long as
+	// no dives are modified, typically when filtering the whole list.
+	void prepareFullText();
+	void clearFullText();
+
+	bool showDive(const struct dive *d) const;
+
+	// Evaluate the filter for the rows from (inclusive) to to (exclusive)
+	// of the dive summary table and write the result into shown. The
+	// numerical criteria are evaluated as scans over the columns, the
+	// remaining criteria only for the dives that passed these.
+	void showRows(const DiveSummaryTable &table, int from, int to, char *shown) const;
+private:
+	enum class Criterion {
+		VISIBILITY,
+		RATING,
+		WATER_TEMP,
+		AIR_TEMP,
+		FROM_DATE,
+		TO_DATE,
+		LOGGED,
+		PLANNED,
+		TAGS,
+		PEOPLE,
+		LOCATION,
+		SUIT,
+		NOTES,
+		EQUIPMENT
+	};
+
+	// A tag filter item with the matching tags looked up in the global tag list.
+	struct TagItem {
+		QString item;				// trimmed
+		bool all;				// empty item, matches every dive
+		std::vector<const divetag *> matches;	// sorted by pointer value
+		std::vector<bool> modeMatches;		// indexed by divemode
+	};
+
+	bool check(Criterion c, const struct dive *d) const;
+	bool tagMatches(const TagItem &item, const struct dive *d) const;
+	bool hasTags(const struct dive *d) const;
+
+	FilterData data;
+	std::vector<Criterion> criteria;
+
+	unsigned long minWaterTemp, maxWaterTemp;
+	unsigned long minAirTemp, maxAirTemp;
+	timestamp_t fromWhen, toWhen;
+	std::vector<TagItem> tagItems;
+	std::vector<const divetag *> knownTags;		// sorted by pointer value
+
+	FullTextFilter peopleFilter, locationFilter, suitFilter, notesFilter;
+};
+
+#endif
@@ -460,14 +460,12 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 int get_divenr(const struct dive *dive)
 {
 	int i;
-	const struct dive *d;
 	// tempting as it may be, don't die when called with dive=NULL
-	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
-		}
-	return -1;
+	if (!dive)
+		return -1;
+	// don't compare pointers, we could be passing in a copy of the dive
+	i = get_idx_by_uniq_id(dive->id);
+	return i < dive_table.nr ? i : -1;
 }
 
 static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
@@ -775,15 +773,176 @@ int comp_dives(const struct dive *a, const struct dive *b)
 	return 0; /* this should not happen for a != b */
 }
 
-/* Dive table functions */
+/*
+ * Index of the dives in the global dive table by their unique id. It is an
+ * open-addressing hash table of the dives, with NULL for free slots. It is
+ * updated when dives are added to or removed from the dive table. Since the
+ * dive table is sorted, the position of a dive is then found by a binary search.
+ */
+static struct dive **id_index;
+static int id_index_bits, id_index_nr;
+
+static unsigned int id_index_slot(int id)
+{
+	/* Fibonacci hashing: take the high bits of the product */
+	return ((unsigned int)id * 2654435761u) >> (32 - id_index_bits);
+}
+
+static void id_index_put(struct dive *d)
+{
+	unsigned int mask = (1u << id_index_bits) - 1;
+	unsigned int slot = id_index_slot(d->id);
+
+	while (id_index[slot])
+		slot = (slot + 1) & mask;
+	id_index[slot] = d;
+}
+
+static void add_to_id_index(struct dive *d)
+{
+	/* Keep the load factor below 0.5 */
+	if (!id_index || 2 * (id_index_nr + 1) > (1 << id_index_bits)) {
+		struct dive **old = id_index;
+		int i, old_size = old ? 1 << id_index_bits : 0;
+
+		id_index_bits = old ? id_index_bits + 1 : 4;
+		id_index = calloc(1u << id_index_bits, sizeof(*id_index));
+		if (!id_index)
+			exit(1);
+		for (i = 0; i < old_size; i++) {
+			if (old[i])
+				id_index_put(old[i]);
+		}
+		free(old);
+	}
+	id_index_put(d);
+	id_index_nr++;
+}
+
+static void remove_from_id_index(const struct dive *d)
+{
+	unsigned int mask, slot, next, home;
+
+	if (!id_index)
+		return;
+	mask = (1u << id_index_bits) - 1;
+	for (slot = id_index_slot(d->id); id_index[slot] != d; slot = (slot + 1) & mask) {
+		if (!id_index[slot]) {
+			/* The id was changed after the dive was added. Search the whole index. */
+			for (slot = 0; slot <= mask && id_index[slot] != d; slot++)
+				;
+			if (slot > mask)
+				return;
+			break;
+		}
+	}
+
+	/* Close the gap: move back the following entries of the cluster
+	 * that can't be found anymore from their home slot otherwise. */
+	for (next = (slot + 1) & mask; id_index[next]; next = (next + 1) & mask) {
+		home = id_index_slot(id_index[next]->id);
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			id_index[slot] = id_index[next];
+			slot = next;
+		}
+	}
+	id_index[slot] = NULL;
+	id_index_nr--;
+}
+
+static struct dive *lookup_id_index(int id)
+{
+	unsigned int slot, mask;
+
+	if (!id_index)
+		return NULL;
+	mask = (1u << id_index_bits) - 1;
+	for (slot = id_index_slot(id); id_index[slot]; slot = (slot + 1) & mask) {
+		if (id_index[slot]->id == id)
+			return id_index[slot];
+	}
+	return NULL;
+}
+
+/* Dive table functions. Additions to and removals from the global dive
+ * table are recorded in the id index. */
 static MAKE_GROW_TABLE(dive_table, struct dive *, dives)
-MAKE_GET_INSERTION_INDEX(dive_table, struct dive *, dives, dive_less_than)
-MAKE_ADD_TO(dive_table, struct dive *, dives)
-static MAKE_REMOVE_FROM(dive_table, dives)
 static MAKE_GET_IDX(dive_table, struct dive *, dives)
 MAKE_SORT(dive_table, struct dive *, dives, comp_dives)
+
+void add_to_dive_table(struct dive_table *table, int idx, struct dive *dive)
+{
+	grow_dive_table(table);
+	memmove(&table->dives[idx + 1], &table->dives[idx], (table->nr - idx) * sizeof(table->dives[0]));
+	table->dives[idx] = dive;
+	table->nr++;
+	if (table == &dive_table)
+		add_to_id_index(dive);
+}
+
+static void remove_from_dive_table(struct dive_table *table, int idx)
+{
+	if (table == &dive_table)
+		remove_from_id_index(table->dives[idx]);
+	memmove(&table->dives[idx], &table->dives[idx + 1], (table->nr - idx - 1) * sizeof(table->dives[0]));
+	table->dives[--table->nr] = NULL;
+}
+
 MAKE_REMOVE(dive_table, struct dive *, dive)
-MAKE_CLEAR_TABLE(dive_table, dives, dive)
+
+void clear_dive_table(struct dive_table *table)
+{
+	for (int i = 0; i < table->nr; i++)
+		free_dive(table->dives[i]);
+	table->nr = 0;
+	if (table == &dive_table && id_index) {
+		memset(id_index, 0, sizeof(*id_index) << id_index_bits);
+		id_index_nr = 0;
+	}
+}
+
+struct dive *get_dive_by_uniq_id(int id)
+{
+	return get_dive(get_idx_by_uniq_id(id));
+}
+
+/* Returns dive_table.nr if there is no dive with the given id */
+int get_idx_by_uniq_id(int id)
+{
+	struct dive *d = lookup_id_index(id);
+	int i;
+
+	if (!d) {
+#ifdef DEBUG
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+#endif
+		return dive_table.nr;
+	}
+	/* The dive table may be unsorted in the middle of an operation,
+	 * e.g. while parsing. Then fall back to a linear search. */
+	i = dive_table_get_insertion_index(&dive_table, d) - 1;
+	if (i < 0 || dive_table.dives[i] != d)
+		i = get_idx_in_dive_table(&dive_table, d);
+	return i >= 0 ? i : dive_table.nr;
+}
+
+/* Dive tables are sorted, therefore use a binary search instead of the
+ * linear search of MAKE_GET_INSERTION_INDEX(). Returns the index of the
+ * first dive that is ranked after the given dive. */
+int dive_table_get_insertion_index(struct dive_table *table, struct dive *d)
+{
+	int lo = 0, hi = table->nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (dive_less_than(d, table->dives[mid]))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
 
 void insert_dive(struct dive_table *table, struct dive *d)
 {
@@ -1033,6 +1192,54 @@ static bool try_to_merge_into(struct dive *dive_to_add, int idx, struct dive_tab
 	return true;
 }
 
+/* An index over the time intervals of the dives in a sorted dive table.
+ * This is a segment tree of the maximum end time. Since the dives are
+ * sorted by start time, it gives the dives overlapping a given time
+ * without looking at every dive. */
+struct dive_interval_index {
+	int size;		/* number of leaves, a power of two */
+	timestamp_t *max_end;	/* 2 * size nodes, node 1 is the root */
+};
+
+static void build_interval_index(struct dive_interval_index *index, const struct dive_table *table)
+{
+	int i;
+
+	index->size = 1;
+	while (index->size < table->nr)
+		index->size *= 2;
+	index->max_end = malloc(2 * index->size * sizeof(*index->max_end));
+	for (i = 0; i < index->size; i++)
+		index->max_end[index->size + i] = i < table->nr ? dive_endtime(table->dives[i]) : INT64_MIN;
+	for (i = index->size - 1; i > 0; i--)
+		index->max_end[i] = MAX(index->max_end[2 * i], index->max_end[2 * i + 1]);
+}
+
+static void free_interval_index(struct dive_interval_index *index)
+{
+	free(index->max_end);
+}
+
+static int last_ending_after_rec(const struct dive_interval_index *index, int node, int node_from, int node_to,
+				 int to, timestamp_t when)
+{
+	int mid, res;
+
+	if (node_from >= to || index->max_end[node] <= when)
+		return -1;
+	if (node >= index->size)
+		return node - index->size;
+	mid = (node_from + node_to) / 2;
+	res = last_ending_after_rec(index, 2 * node + 1, mid, node_to, to, when);
+	return res >= 0 ? res : last_ending_after_rec(index, 2 * node, node_from, mid, to, when);
+}
+
+/* Return the highest index smaller than "to" of a dive that ends after "when", or -1. */
+static int last_ending_after(const struct dive_interval_index *index, int to, timestamp_t when)
+{
+	return last_ending_after_rec(index, 1, 0, index->size, to, when);
+}
+
 /* Check if a dive is ranked after the last dive of the global dive list */
 static bool dive_is_after_last(struct dive *d)
 {
@@ -1058,20 +1265,28 @@ static bool merge_dive_tables(struct dive_table *dives_from, struct dive_table *
 			      struct dive_table *dives_to_add, struct dive_table *dives_to_remove,
 			      int *num_merged)
 {
-	int i, j;
-	int last_merged_into = -1;
+	int i, j, k;
 	bool sequence_changed = false;
+	bool merged;
+	struct dive_interval_index index;
+	char *merged_into;
 
 	/* Merge newly imported dives into the dive table.
-	 * Since both lists (old and new) are sorted, we can step
-	 * through them concurrently and locate the insertions points.
-	 * Once found, check if the new dive can be merged in the
-	 * previous or next dive.
-	 * Note that this doesn't consider pathological cases such as:
-	 *  - New dive "connects" two old dives (turn three into one).
-	 *  - New dive can not be merged into adjacent but some further dive.
+	 * For every new dive, the overlapping old dives are looked up in an
+	 * interval index and tried in order of proximity: first the dives
+	 * starting before the new dive, then the ones starting during the
+	 * new dive. try_to_merge() does the cheap checks of likely_same_dive()
+	 * (duration, depth, dive computer and dive ids) before any sample-level work.
+	 * We are extra-careful to not merge into the same dive twice, as that
+	 * would put the merged-into dive twice onto the dives-to-delete list.
+	 * In principle that shouldn't happen as all dives that compare equal
+	 * by is_same_dive() were already merged, and is_same_dive() should be
+	 * transitive. But let's just go *completely* sure for the odd corner-case.
+	 * Note that this doesn't consider the pathological case of a new dive
+	 * "connecting" two old dives (turn three into one).
 	 */
-	j = 0; /* Index in dives_to */
+	build_interval_index(&index, dives_to);
+	merged_into = calloc(dives_to->nr + 1, 1);
 	for (i = 0; i < dives_from->nr; i++) {
 		struct dive *dive_to_add = dives_from->dives[i];
 
@@ -1079,37 +1294,32 @@ static bool merge_dive_tables(struct dive_table *dives_from, struct dive_table *
 			remove_dive(dive_to_add, delete_from);
 
 		/* Find insertion point. */
-		while (j < dives_to->nr && dive_less_than(dives_to->dives[j], dive_to_add))
-			j++;
-
-		/* Try to merge into previous dive.
-		 * We are extra-careful to not merge into the same dive twice, as that
-		 * would put the merged-into dive twice onto the dives-to-delete list.
-		 * In principle that shouldn't happen as all dives that compare equal
-		 * by is_same_dive() were already merged, and is_same_dive() should be
-		 * transitive. But let's just go *completely* sure for the odd corner-case. */
-		if (j > 0 && j - 1 > last_merged_into &&
-		    dive_endtime(dives_to->dives[j - 1]) > dive_to_add->when) {
-			if (try_to_merge_into(dive_to_add, j - 1, dives_to, prefer_imported,
-					      dives_to_add, dives_to_remove)) {
-				free_dive(dive_to_add);
-				last_merged_into = j - 1;
-				(*num_merged)++;
-				continue;
-			}
+		j = dive_table_get_insertion_index(dives_to, dive_to_add);
+
+		/* Try to merge into a dive starting before the new dive. */
+		merged = false;
+		for (k = last_ending_after(&index, j, dive_to_add->when); k >= 0 && !merged;
+		     k = last_ending_after(&index, k, dive_to_add->when)) {
+			merged = !merged_into[k] &&
+				 try_to_merge_into(dive_to_add, k, dives_to, prefer_imported,
+						   dives_to_add, dives_to_remove);
+			if (merged)
+				merged_into[k] = 1;
 		}
 
-		/* That didn't merge into the previous dive.
-		 * Try to merge into next dive. */
-		if (j < dives_to->nr && j > last_merged_into &&
-		    dive_endtime(dive_to_add) > dives_to->dives[j]->when) {
-			if (try_to_merge_into(dive_to_add, j, dives_to, prefer_imported,
-					      dives_to_add, dives_to_remove)) {
-				free_dive(dive_to_add);
-				last_merged_into = j;
-				(*num_merged)++;
-				continue;
-			}
+		/* That didn't work. Try to merge into a dive starting during the new dive. */
+		for (k = j; k < dives_to->nr && dive_endtime(dive_to_add) > dives_to->dives[k]->when && !merged; k++) {
+			merged = !merged_into[k] &&
+				 try_to_merge_into(dive_to_add, k, dives_to, prefer_imported,
+						   dives_to_add, dives_to_remove);
+			if (merged)
+				merged_into[k] = 1;
+		}
+
+		if (merged) {
+			free_dive(dive_to_add);
+			(*num_merged)++;
+			continue;
 		}
 
 		/* We couldnt merge dives, simply add to list of dives to-be-added. */
@@ -1117,6 +1327,8 @@ static bool merge_dive_tables(struct dive_table *dives_from, struct dive_table *
 		sequence_changed |= !dive_is_after_last(dive_to_add);
 		dive_to_add->divetrip = trip;
 	}
+	free(merged_into);
+	free_interval_index(&index);
 
 	/* we took care of all dives, clean up the import table */
 	dives_from->nr = 0;
@@ -1448,6 +1660,23 @@ void report_datafile_version(int version)
 		min_datafile_version = version;
 }
 
+/* Index of the first dive starting after the given time, or dive_table.nr
+ * if there is no such dive. The dive table is sorted by start time, so this
+ * is a binary search. */
+int first_dive_after(timestamp_t when)
+{
+	int lo = 0, hi = dive_table.nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (dive_table.dives[mid]->when <= when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 int get_dive_id_closest_to(timestamp_t when)
 {
 	int i;
@@ -1459,8 +1688,7 @@ int get_dive_id_closest_to(timestamp_t when)
 	else if (nr == 1)
 		return dive_table.dives[0]->id;
 
-	for (i = 0; i < nr && dive_table.dives[i]->when <= when; i++)
-		; // nothing
+	i = first_dive_after(when);
 
 	// again, capture the two edge cases first
 	if (i == nr)
@@ -4,20 +4,95 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <vector>
 #include "divelogexportlogic.h"
 #include "qthelper.h"
 #include "units.h"
 #include "statistics.h"
+#include "statisticscache.h"
 #include "save-html.h"
 
 static void file_copy_and_overwrite(const QString &fileName, const QString &newName)
 {
+	// When exporting into the same directory again, don't copy the theme
+	// files and photos that are already there.
+	QFileInfo source(fileName), target(newName);
+	if (target.exists() && target.size() == source.size() && target.lastModified() >= source.lastModified())
+		return;
 	QFile file(newName);
 	if (file.exists())
 		file.remove();
 	QFile::copy(fileName, newName);
 }
 
+// Copy the photos of the exported dives. A photo that belongs to multiple dives is copied only once.
+static void exportHTMLphotos(const struct html_export_entry *entries, int nr, const QString &photosDirectory)
+{
+	QHash<QString, QString> photos; // filename in the export -> local file
+	for (int i = 0; i < nr; ++i) {
+		for (struct picture *pic = entries[i].dive->picture_list; pic; pic = pic->next) {
+			QString localFile = localFilePath(QString(pic->filename));
+			photos.insert(QFileInfo(localFile).fileName(), localFile);
+		}
+	}
+	QStringList names = photos.keys();
+	QtConcurrent::blockingMap(names, [&photos, &photosDirectory](const QString &name) {
+		file_copy_and_overwrite(photos.value(name), photosDirectory + name);
+	});
+}
+
+// Write the dive data. The dives are formatted in chunks on worker threads
+// and the chunks are written to the file in order. Only a limited number of
+// chunks is kept in memory at a time.
+static void exportHTMLdives(const QString &filename, const QString &photosDirectory, const QString &samplesDirectory,
+			    const struct htmlExportSetting &hes)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		report_error(qPrintable(gettextFromC::tr("Can't open file %s")), qPrintable(filename));
+		return;
+	}
+
+	struct html_export_entry *entries;
+	int nr = html_export_entries(&entries, hes.selectedOnly);
+	bool photos = !photosDirectory.isEmpty();
+	QByteArray samplesDir = samplesDirectory.toLocal8Bit();
+	const char *samplesDirPtr = samplesDirectory.isEmpty() ? nullptr : samplesDir.constData();
+
+	const int chunkSize = 32;
+	const int chunksPerRound = std::max(QThread::idealThreadCount(), 1) * 4;
+	bool ok = file.write("trips=[") >= 0;
+	for (int start = 0; start < nr && ok; start += chunkSize * chunksPerRound) {
+		QVector<int> chunks;
+		for (int from = start; from < nr && chunks.size() < chunksPerRound; from += chunkSize)
+			chunks.push_back(from);
+		std::vector<QByteArray> formatted(chunks.size());
+		QtConcurrent::blockingMap(chunks, [&](int from) {
+			struct membuffer buf = { 0 };
+			write_html_entries(&buf, entries, nr, from, std::min(from + chunkSize, nr), photos, samplesDirPtr, hes.listOnly);
+			formatted[(from - start) / chunkSize] = QByteArray(buf.buffer, buf.len);
+			free_buffer(&buf);
+		});
+		for (const QByteArray &chunk: formatted) {
+			if (file.write(chunk) != chunk.size()) {
+				ok = false;
+				break;
+			}
+		}
+	}
+	ok = ok && file.write("]") >= 0;
+	if (!ok)
+		report_error(qPrintable(gettextFromC::tr("Can't write file %s")), qPrintable(filename));
+	file.close();
+
+	if (photos && !hes.listOnly)
+		exportHTMLphotos(entries, nr, photosDirectory);
+	free(entries);
+}
+
 static void exportHTMLsettings(const QString &filename, struct htmlExportSetting &hes)
 {
 	QString fontSize = hes.fontSize;
@@ -79,7 +154,7 @@ static void exportHTMLstatistics(const QString filename, struct htmlExportSettin
 
 	stats_t total_stats;
 
-	calculate_stats_summary(&stats, hes.selectedOnly);
+	StatisticsCache::instance()->calculateSummary(&stats, hes.selectedOnly);
 	total_stats.selection_size = 0;
 	total_stats.total_time.seconds = 0;
 
@@ -141,11 +216,17 @@ void exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes)
 		mainDir.mkdir(photosDirectory);
 	}
 
+	QString samplesDirectory;
+	if (hes.splitSamples && !hes.listOnly) {
+		samplesDirectory = exportFiles + "samples" + QDir::separator();
+		mainDir.mkdir(samplesDirectory);
+	}
+
 	exportHTMLsettings(json_settings, hes);
 	exportHTMLstatistics(stat_file, hes);
 	export_translation(qPrintable(translation));
 
-	export_HTML(qPrintable(json_dive_data), qPrintable(photosDirectory), hes.selectedOnly, hes.listOnly);
+	exportHTMLdives(json_dive_data, photosDirectory, samplesDirectory, hes);
 
 	QString searchPath = getSubsurfaceDataPath("theme");
 	if (searchPath.isEmpty()) {
@@ -12,6 +12,7 @@ struct htmlExportSetting {
 	bool subsurfaceNumbers;
 	bool yearlyStatistics;
 	QString themeFile;
+	bool splitSamples;	// write the samples of each dive into a file that is loaded on demand
 };
 
 void exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes);
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "core/divesummary.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+
+DiveSummaryTable *DiveSummaryTable::instance()
+{
+	static DiveSummaryTable self;
+	return &self;
+}
+
+DiveSummaryTable::DiveSummaryTable() : dirty(true)
+{
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &DiveSummaryTable::divesAdded);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &DiveSummaryTable::divesDeleted);
+	connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips, this, &DiveSummaryTable::divesMovedBetweenTrips);
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &DiveSummaryTable::divesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &DiveSummaryTable::divesTimeChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveSummaryTable::cylindersReset);
+}
+
+int DiveSummaryTable::size() const
+{
+	return (int)dives.size();
+}
+
+void DiveSummaryTable::resize(int rows)
+{
+	dives.resize(rows);
+	when.resize(rows);
+	duration.resize(rows);
+	maxdepth.resize(rows);
+	meandepth.resize(rows);
+	sac.resize(rows);
+	mintemp.resize(rows);
+	maxtemp.resize(rows);
+	watertemp.resize(rows);
+	airtemp.resize(rows);
+	rating.resize(rows);
+	visibility.resize(rows);
+	divemode.resize(rows);
+	logged.resize(rows);
+	planned.resize(rows);
+	trip.resize(rows);
+}
+
+void DiveSummaryTable::setRow(int row, const struct dive *d)
+{
+	dives[row] = d;
+	when[row] = d->when;
+	duration[row] = d->duration.seconds;
+	maxdepth[row] = d->maxdepth.mm;
+	meandepth[row] = d->meandepth.mm;
+	sac[row] = d->sac;
+	mintemp[row] = d->mintemp.mkelvin;
+	maxtemp[row] = d->maxtemp.mkelvin;
+	watertemp[row] = d->watertemp.mkelvin;
+	airtemp[row] = d->airtemp.mkelvin;
+	rating[row] = (int8_t)d->rating;
+	visibility[row] = (int8_t)d->visibility;
+	divemode[row] = (int8_t)d->dc.divemode;
+	logged[row] = has_planned(d, false);
+	planned[row] = has_planned(d, true);
+	trip[row] = d->divetrip;
+}
+
+void DiveSummaryTable::rebuild()
+{
+	int i;
+	struct dive *d;
+
+	resize(dive_table.nr);
+	rowOf.clear();
+	rowOf.reserve(dive_table.nr);
+	for_each_dive (i, d) {
+		setRow(i, d);
+		rowOf[d] = i;
+	}
+	dirty = false;
+}
+
+void DiveSummaryTable::update()
+{
+	// Dives may have been loaded or cleared without notification
+	if (dirty || size() != dive_table.nr)
+		rebuild();
+}
+
+void DiveSummaryTable::invalidate()
+{
+	dirty = true;
+}
+
+void DiveSummaryTable::updateDives(const QVector<dive *> &dives)
+{
+	if (dirty)
+		return;
+	for (dive *d: dives) {
+		auto it = rowOf.find(d);
+		if (it == rowOf.end()) {
+			dirty = true;
+			return;
+		}
+		setRow(it->second, d);
+	}
+}
+
+void DiveSummaryTable::divesAdded(dive_trip *, bool, const QVector<dive *> &)
+{
+	// The rows of the following dives shift, rebuild on next access
+	dirty = true;
+}
+
+void DiveSummaryTable::divesDeleted(dive_trip *, bool, const QVector<dive *> &)
+{
+	dirty = true;
+}
+
+void DiveSummaryTable::divesMovedBetweenTrips(dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives)
+{
+	updateDives(dives);
+}
+
+void DiveSummaryTable::divesChanged(const QVector<dive *> &dives, DiveField)
+{
+	updateDives(dives);
+}
+
+void DiveSummaryTable::divesTimeChanged(timestamp_t, const QVector<dive *> &)
+{
+	// The dives may have been reordered
+	dirty = true;
+}
+
+void DiveSummaryTable::cylindersReset(const QVector<dive *> &dives)
+{
+	// The SAC rate depends on the cylinders
+	updateDives(dives);
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0
+// A columnar copy of the frequently accessed values of all dives.
+//
+// The dive structures are large and scattered over the heap. Code that
+// scans all dives for only a few values, such as the filter and the
+// statistics, walks the columns of this table instead: one packed array
+// per value, indexed by the position of the dive in the dive table.
+#ifndef DIVESUMMARY_H
+#define DIVESUMMARY_H
+
+#include "core/subsurface-qt/DiveListNotifier.h"
+#include "core/units.h"
+
+#include <QObject>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct dive;
+struct dive_trip;
+
+class DiveSummaryTable : public QObject {
+	Q_OBJECT
+public:
+	static DiveSummaryTable *instance();
+
+	// Bring the table in sync with the dive table. Changes of individual
+	// dives are applied when the DiveListNotifier announces them, but
+	// adding, removing and reordering dives are only noted and the table
+	// is rebuilt here. Must be called on the main thread before accessing
+	// the columns. Afterwards, row i corresponds to dive_table.dives[i].
+	void update();
+
+	// Force a rebuild on the next update(), e.g. after a new file was loaded.
+	void invalidate();
+
+	int size() const;
+
+	// The columns
+	std::vector<const struct dive *> dives;
+	std::vector<timestamp_t> when;
+	std::vector<int32_t> duration;		// seconds
+	std::vector<int32_t> maxdepth;		// mm
+	std::vector<int32_t> meandepth;		// mm
+	std::vector<int32_t> sac;		// ml/min
+	std::vector<uint32_t> mintemp;		// mkelvin, 0 if unknown
+	std::vector<uint32_t> maxtemp;
+	std::vector<uint32_t> watertemp;
+	std::vector<uint32_t> airtemp;
+	std::vector<int8_t> rating;
+	std::vector<int8_t> visibility;
+	std::vector<int8_t> divemode;
+	std::vector<char> logged;		// has a dive computer that is not the planner
+	std::vector<char> planned;		// has a planner dive computer
+	std::vector<const struct dive_trip *> trip;
+
+private
+slots:
+	void divesAdded(dive_trip *trip, bool addTrip, const QVector<dive *> &dives);
+	void divesDeleted(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
+	void divesMovedBetweenTrips(dive_trip *from, dive_trip *to, bool deleteFrom, bool createTo, const QVector<dive *> &dives);
+	void divesChanged(const QVector<dive *> &dives, DiveField field);
+	void divesTimeChanged(timestamp_t delta, const QVector<dive *> &dives);
+	void cylindersReset(const QVector<dive *> &dives);
+
+private:
+	DiveSummaryTable();
+	void rebuild();
+	void resize(int rows);
+	void setRow(int row, const struct dive *d);
+	void updateDives(const QVector<dive *> &dives);
+
+	bool dirty;
+	std::unordered_map<const struct dive *, int> rowOf;
+};
+
+#endif
@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "core/fulltext.h"
+#include "core/dive.h"
+#include "core/divesite.h"
+#include "core/qthelper.h"
+#include "core/subsurface-string.h"
+#include "core/trip.h"
+
+#include <algorithm>
+
+namespace {
+	// A word of a query. If start is true, the word is preceded by a
+	// non-word character and therefore must be at the beginning of an indexed
+	// word. Likewise, if end is true, it must be at the end of an indexed word.
+	struct QueryWord {
+		QString word;
+		bool start, end;
+	};
+
+	// Split a string into case-folded words. Everything that is not a letter
+	// or a number is considered a separator. The callback is called with the
+	// word and the flags of the QueryWord structure.
+	template <typename Func>
+	void splitWords(const QString &s, Func f)
+	{
+		QString folded = s.toCaseFolded();
+		int len = folded.size();
+		int i = 0;
+		while (i < len) {
+			if (!folded[i].isLetterOrNumber()) {
+				++i;
+				continue;
+			}
+			int from = i;
+			while (i < len && folded[i].isLetterOrNumber())
+				++i;
+			f(folded.mid(from, i - from), from > 0, i < len);
+		}
+	}
+
+	void addWords(const char *s, std::vector<QString> &words)
+	{
+		if (empty_string(s))
+			return;
+		splitWords(QString(s), [&words](const QString &w, bool, bool) { words.push_back(w); });
+	}
+
+	void addWords(const QString &s, std::vector<QString> &words)
+	{
+		splitWords(s, [&words](const QString &w, bool, bool) { words.push_back(w); });
+	}
+
+	// Collect the words of the given field of a dive. The result is sorted
+	// and does not contain duplicates.
+	std::vector<QString> fieldWords(const struct dive *d, int field)
+	{
+		std::vector<QString> res;
+		switch (field) {
+		case FullTextIndex::NOTES:
+			addWords(d->notes, res);
+			break;
+		case FullTextIndex::PEOPLE:
+			addWords(d->buddy, res);
+			addWords(d->divemaster, res);
+			break;
+		case FullTextIndex::SUIT:
+			addWords(d->suit, res);
+			break;
+		case FullTextIndex::LOCATION:
+			if (d->divetrip)
+				addWords(d->divetrip->location, res);
+			if (d->dive_site)
+				addWords(d->dive_site->name, res);
+			break;
+		case FullTextIndex::TAGS:
+			addWords(get_taglist_string(d->tag_list), res);
+			break;
+		}
+		std::sort(res.begin(), res.end());
+		res.erase(std::unique(res.begin(), res.end()), res.end());
+		return res;
+	}
+
+	// Call the function for every indexed word that may contain the query word.
+	// Words that are delimited on both sides have to match exactly and
+	// words that are delimited at the start are found by a prefix search.
+	// Only for the remaining words the whole vocabulary has to be scanned.
+	template <typename Postings, typename Func>
+	void forEachMatch(const std::map<QString, Postings> &words, const QueryWord &q, Func f)
+	{
+		if (q.start && q.end) {
+			auto it = words.find(q.word);
+			if (it != words.end())
+				f(it->second);
+		} else if (q.start) {
+			for (auto it = words.lower_bound(q.word); it != words.end() && it->first.startsWith(q.word); ++it)
+				f(it->second);
+		} else if (q.end) {
+			for (auto it = words.begin(); it != words.end(); ++it) {
+				if (it->first.endsWith(q.word))
+					f(it->second);
+			}
+		} else {
+			for (auto it = words.begin(); it != words.end(); ++it) {
+				if (it->first.contains(q.word))
+					f(it->second);
+			}
+		}
+	}
+}
+
+FullTextIndex *FullTextIndex::instance()
+{
+	static FullTextIndex self;
+	return &self;
+}
+
+FullTextIndex::FullTextIndex()
+{
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &FullTextIndex::divesAdded);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &FullTextIndex::divesDeleted);
+	connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips, this, &FullTextIndex::divesMovedBetweenTrips);
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &FullTextIndex::divesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::tripChanged, this, &FullTextIndex::tripChanged);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &FullTextIndex::diveSiteChanged);
+}
+
+void FullTextIndex::reload()
+{
+	int i;
+	struct dive *d;
+
+	clear();
+	for_each_dive (i, d)
+		addDive(d);
+}
+
+void FullTextIndex::clear()
+{
+	for (int i = 0; i < numFields; ++i)
+		words[i].clear();
+	entries.clear();
+	diveSlots.clear();
+	freeSlots.clear();
+}
+
+void FullTextIndex::addDive(struct dive *d)
+{
+	if (entries.contains(d))
+		removeDive(d);
+
+	Entry entry;
+	if (freeSlots.empty()) {
+		entry.slot = (int)diveSlots.size();
+		diveSlots.push_back(d);
+	} else {
+		entry.slot = freeSlots.back();
+		freeSlots.pop_back();
+		diveSlots[entry.slot] = d;
+	}
+
+	for (int i = 0; i < numFields; ++i) {
+		entry.words[i] = fieldWords(d, 1 << i);
+		for (const QString &w: entry.words[i]) {
+			Postings &postings = words[i][w];
+			postings.insert(std::lower_bound(postings.begin(), postings.end(), entry.slot), entry.slot);
+		}
+	}
+	entries.insert(d, std::move(entry));
+}
+
+void FullTextIndex::removeDive(const struct dive *d)
+{
+	auto it = entries.find(d);
+	if (it == entries.end())
+		return;
+
+	int slot = it->slot;
+	for (int i = 0; i < numFields; ++i) {
+		for (const QString &w: it->words[i]) {
+			auto word_it = words[i].find(w);
+			if (word_it == words[i].end())
+				continue;
+			Postings &postings = word_it->second;
+			auto pos = std::lower_bound(postings.begin(), postings.end(), slot);
+			if (pos != postings.end() && *pos == slot)
+				postings.erase(pos);
+			if (postings.empty())
+				words[i].erase(word_it);
+		}
+	}
+	diveSlots[slot] = nullptr;
+	freeSlots.push_back(slot);
+	entries.erase(it);
+}
+
+void FullTextIndex::updateDive(struct dive *d)
+{
+	removeDive(d);
+	addDive(d);
+}
+
+bool FullTextIndex::findDives(int fields, const QString &s, std::vector<struct dive *> &res) const
+{
+	std::vector<QueryWord> query;
+	splitWords(s, [&query](const QString &w, bool start, bool end) { query.push_back({ w, start, end }); });
+	if (query.empty())
+		return false;
+
+	// Start with all slots and remove those that don't contain one of the words.
+	size_t numSlots = diveSlots.size();
+	std::vector<char> found(numSlots, 1);
+	std::vector<char> hits(numSlots);
+	for (const QueryWord &q: query) {
+		std::fill(hits.begin(), hits.end(), 0);
+		for (int i = 0; i < numFields; ++i) {
+			if (!(fields & (1 << i)))
+				continue;
+			forEachMatch(words[i], q, [&hits](const Postings &postings) {
+				for (int slot: postings)
+					hits[slot] = 1;
+			});
+		}
+		bool any = false;
+		for (size_t slot = 0; slot < numSlots; ++slot) {
+			found[slot] &= hits[slot];
+			any |= found[slot] != 0;
+		}
+		if (!any)
+			break;
+	}
+
+	res.clear();
+	for (size_t slot = 0; slot < numSlots; ++slot) {
+		if (found[slot] && diveSlots[slot])
+			res.push_back(diveSlots[slot]);
+	}
+	std::sort(res.begin(), res.end());
+	return true;
+}
+
+void FullTextIndex::divesAdded(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	for (dive *d: dives)
+		addDive(d);
+}
+
+void FullTextIndex::divesDeleted(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	for (dive *d: dives)
+		removeDive(d);
+}
+
+void FullTextIndex::divesMovedBetweenTrips(dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives)
+{
+	// The trip location is part of the location field
+	for (dive *d: dives)
+		updateDive(d);
+}
+
+void FullTextIndex::divesChanged(const QVector<dive *> &dives, DiveField field)
+{
+	switch (field) {
+	case DiveField::DIVESITE:
+	case DiveField::DIVEMASTER:
+	case DiveField::BUDDY:
+	case DiveField::SUIT:
+	case DiveField::TAGS:
+	case DiveField::NOTES:
+		for (dive *d: dives)
+			updateDive(d);
+		break;
+	default:
+		break;
+	}
+}
+
+void FullTextIndex::tripChanged(dive_trip *trip, TripField field)
+{
+	if (field != TripField::LOCATION)
+		return;
+	for (int i = 0; i < trip->dives.nr; ++i)
+		updateDive(trip->dives.dives[i]);
+}
+
+void FullTextIndex::diveSiteChanged(dive_site *ds, int)
+{
+	// The field ids are defined by a model in the UI layer. Since dive
+	// site edits are rare, simply reindex the dives on any change.
+	for (int i = 0; i < ds->dives.nr; ++i)
+		updateDive(ds->dives.dives[i]);
+}
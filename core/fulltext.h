@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0
+// An inverted index of the free-text fields of the dives. It is used to
+// speed up the text filters, which otherwise would have to search through
+// the notes, buddies, etc. of every dive on every keystroke.
+#ifndef FULLTEXT_H
+#define FULLTEXT_H
+
+#include "core/subsurface-qt/DiveListNotifier.h"
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <map>
+#include <vector>
+
+struct dive;
+
+class FullTextIndex : public QObject {
+	Q_OBJECT
+public:
+	// The indexed fields. These are bit flags, so that a query can be run
+	// on multiple fields at once.
+	enum Field {
+		NOTES = 1 << 0,
+		PEOPLE = 1 << 1,	// buddy and divemaster
+		SUIT = 1 << 2,
+		LOCATION = 1 << 3,	// dive site name and trip location
+		TAGS = 1 << 4
+	};
+	static const int numFields = 5;
+
+	static FullTextIndex *instance();
+
+	// Rebuild the index from the global dive table.
+	void reload();
+	void clear();
+
+	// The index is kept up to date by the signals of the DiveListNotifier.
+	// Frontends that modify dives behind the back of the undo commands
+	// have to call these functions manually.
+	void addDive(struct dive *d);
+	void removeDive(const struct dive *d);
+	void updateDive(struct dive *d);
+
+	// Collect the dives that might contain the string in one of the given
+	// fields. The comparison is case insensitive and the result is a superset
+	// of the actual matches: the string is split into words, which are looked
+	// up in the index and the results are intersected. The caller must
+	// check the candidates with the exact criterion. The result is sorted
+	// by pointer value. Returns false if the string contains no word
+	// characters. In that case the index can't restrict the search.
+	bool findDives(int fields, const QString &s, std::vector<struct dive *> &res) const;
+
+private
+slots:
+	void divesAdded(dive_trip *trip, bool addTrip, const QVector<dive *> &dives);
+	void divesDeleted(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
+	void divesMovedBetweenTrips(dive_trip *from, dive_trip *to, bool deleteFrom, bool createTo, const QVector<dive *> &dives);
+	void divesChanged(const QVector<dive *> &dives, DiveField field);
+	void tripChanged(dive_trip *trip, TripField field);
+	void diveSiteChanged(dive_site *ds, int field);
+
+private:
+	FullTextIndex();
+
+	// Every indexed dive is assigned a dense slot number. The posting
+	// lists store sorted slot numbers, so that the results of the
+	// individual words can be combined with simple bitmaps.
+	struct Entry {
+		int slot;
+		std::vector<QString> words[numFields];
+	};
+	using Postings = std::vector<int>;
+	std::map<QString, Postings> words[numFields];
+	QHash<const struct dive *, Entry> entries;
+	std::vector<struct dive *> diveSlots;	// nullptr for unused slots
+	std::vector<int> freeSlots;
+};
+
+#endif
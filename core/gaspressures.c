@@ -11,11 +11,12 @@
  *                                  -> fill_missing_tank_pressures() -> fill_missing_segment_pressures()
  *                                                                   -> get_pr_interpolate_data()
  *
- *  The pr_track_t related functions below implement a linked list that is used by
- *  the majority of the functions below. The linked list covers a part of the dive profile
- *  for which there are no cylinder pressure data. Each element in the linked list
- *  represents a segment between two consecutive points on the dive profile.
- *  pr_track_t is defined in gaspressures.h
+ *  The pr_track_t related functions below implement a per-cylinder array of segments
+ *  that is used by the majority of the functions below. The array covers a part of the
+ *  dive profile for which there are no cylinder pressure data. Each element in the array
+ *  represents a segment between two consecutive points on the dive profile. The segments
+ *  are stored in time order, so that they can be matched against the plot entries in a
+ *  single linear pass.
  */
 
 #include "ssrf.h"
@@ -24,6 +25,7 @@
 #include "profile.h"
 #include "gaspressures.h"
 #include "pref.h"
+#include "table.h"
 
 /*
  * simple structure to track the beginning and end tank pressure as
@@ -36,7 +38,12 @@ struct pr_track_struct {
 	int t_start;
 	int t_end;
 	int pressure_time;
-	pr_track_t *next;
+};
+
+/* time-ordered array of pressure tracking segments for one cylinder */
+struct pr_track_table {
+	int nr, allocated;
+	pr_track_t *tracks;
 };
 
 typedef struct pr_interpolate_struct pr_interpolate_t;
@@ -49,61 +56,42 @@ struct pr_interpolate_struct {
 
 enum interpolation_strategy {SAC, TIME, CONSTANT};
 
-static pr_track_t *pr_track_alloc(int start, int t_start)
+static MAKE_GROW_TABLE(pr_track_table, pr_track_t, tracks)
+
+static pr_track_t *pr_track_add(struct pr_track_table *table, int start, int t_start)
 {
-	pr_track_t *pt = malloc(sizeof(pr_track_t));
+	pr_track_t *pt;
+
+	grow_pr_track_table(table);
+	pt = table->tracks + table->nr++;
 	pt->start = start;
 	pt->end = 0;
 	pt->t_start = pt->t_end = t_start;
 	pt->pressure_time = 0;
-	pt->next = NULL;
 	return pt;
 }
 
-/* poor man's linked list */
-static pr_track_t *list_last(pr_track_t *list)
-{
-	pr_track_t *tail = list;
-	if (!tail)
-		return NULL;
-	while (tail->next) {
-		tail = tail->next;
-	}
-	return tail;
-}
-
-static pr_track_t *list_add(pr_track_t *list, pr_track_t *element)
+static void pr_track_table_free(struct pr_track_table *table)
 {
-	pr_track_t *tail = list_last(list);
-	if (!tail)
-		return element;
-	tail->next = element;
-	return list;
-}
-
-static void list_free(pr_track_t *list)
-{
-	if (!list)
-		return;
-	list_free(list->next);
-	free(list);
+	free(table->tracks);
+	table->tracks = NULL;
+	table->nr = table->allocated = 0;
 }
 
 #ifdef DEBUG_PR_TRACK
-static void dump_pr_track(int cyl, pr_track_t *track_pr)
+static void dump_pr_track(int cyl, const struct pr_track_table *track_pr)
 {
-	pr_track_t *list;
+	int i;
 
 	printf("cyl%d:\n", cyl);
-	list = track_pr;
-	while (list) {
+	for (i = 0; i < track_pr->nr; i++) {
+		const pr_track_t *list = track_pr->tracks + i;
 		printf("   start %d end %d t_start %d:%02d t_end %d:%02d pt %d\n",
 		       mbar_to_PSI(list->start),
 		       mbar_to_PSI(list->end),
 		       FRACTION(list->t_start, 60),
 		       FRACTION(list->t_end, 60),
 		       list->pressure_time);
-		list = list->next;
 	}
 }
 #endif
@@ -126,11 +114,13 @@ static void dump_pr_track(int cyl, pr_track_t *track_pr)
  * segments according to how big of a time_pressure area
  * they have.
  */
-static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_strategy strategy)
+static void fill_missing_segment_pressures(struct pr_track_table *track_pr, enum interpolation_strategy strategy)
 {
 	double magic;
+	pr_track_t *list = track_pr->tracks;
+	pr_track_t *last = track_pr->tracks + track_pr->nr - 1;
 
-	while (list) {
+	while (list <= last) {
 		int start = list->start, end;
 		pr_track_t *tmp = list;
 		int pt_sum = 0, pt = 0;
@@ -141,9 +131,9 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 			if (end)
 				break;
 			end = start;
-			if (!tmp->next)
+			if (tmp == last)
 				break;
-			tmp = tmp->next;
+			tmp++;
 		}
 
 		if (!start)
@@ -170,7 +160,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 				list->end = pressure;
 				if (list == tmp)
 					break;
-				list = list->next;
+				list++;
 				list->start = pressure;
 			}
 			break;
@@ -187,7 +177,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 		}
 
 		/* Ok, we've done that set of segments */
-		list = list->next;
+		list++;
 	}
 }
 
@@ -211,7 +201,8 @@ static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment,
 	interpolate.acc_pressure_time = 0;
 	interpolate.pressure_time = 0;
 
-	for (i = 0; i < pi->nr; i++) {
+	/* The plot entries are sorted by time - only walk the entries of this segment */
+	for (i = get_plot_entry_index(pi, segment->t_start); i < pi->nr; i++) {
 		entry = pi->entry + i;
 
 		if (entry->sec < segment->t_start)
@@ -225,17 +216,18 @@ static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment,
 	return interpolate;
 }
 
-static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, pr_track_t *track_pr, int cyl)
+static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, struct pr_track_table *track_pr, int cyl)
 {
 	int i;
 	struct plot_data *entry;
 	pr_interpolate_t interpolate = { 0, 0, 0, 0 };
 	pr_track_t *last_segment = NULL;
 	int cur_pr;
+	int seg_idx = 0;
 	enum interpolation_strategy strategy;
 
 	/* no segment where this cylinder is used */
-	if (!track_pr)
+	if (!track_pr->nr)
 		return;
 
 	if (dive->cylinder[cyl].cylinder_use == OC_GAS)
@@ -243,7 +235,7 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 	else
 		strategy = TIME;
 	fill_missing_segment_pressures(track_pr, strategy); // Interpolate the missing tank pressure values ..
-	cur_pr = track_pr->start;			       // in the pr_track_t lists of structures
+	cur_pr = track_pr->tracks[0].start;		       // in the pr_track_t arrays of structures
 							       // and keep the starting pressure for each cylinder.
 #ifdef DEBUG_PR_TRACK
 	dump_pr_track(cyl, track_pr);
@@ -277,14 +269,16 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 			continue;		// and skip to next point.
 		}
 		// If there is NO valid pressure value..
-		// Find the pressure segment corresponding to this entry..
-		segment = track_pr;
-		while (segment && segment->t_end < entry->sec) // Find the track_pr with end time..
-			segment = segment->next;	       // ..that matches the plot_info time (entry->sec)
+		// Find the pressure segment corresponding to this entry.
+		// Both the plot entries and the segments are ordered by time,
+		// so we only ever have to move forward in the segment array.
+		while (seg_idx < track_pr->nr && track_pr->tracks[seg_idx].t_end < entry->sec)
+			seg_idx++;
 
 		// After last segment? All done.
-		if (!segment)
+		if (seg_idx >= track_pr->nr)
 			break;
+		segment = track_pr->tracks + seg_idx;
 
 		// Before first segment, or between segments.. Go on, no interpolation.
 		if (segment->t_start > entry->sec)
@@ -359,11 +353,11 @@ static void debug_print_pressures(struct plot_info *pi)
 
 /* This function goes through the list of tank pressures, of structure plot_info for the dive profile where each
  * item in the list corresponds to one point (node) of the profile. It finds values for which there are no tank
- * pressures (pressure==0). For each missing item (node) of tank pressure it creates a pr_track_alloc structure
- * that represents a segment on the dive profile and that contains tank pressures. There is a linked list of
- * pr_track_alloc structures for each cylinder. These pr_track_alloc structures ultimately allow for filling
+ * pressures (pressure==0). For each missing item (node) of tank pressure it adds a pr_track_t structure
+ * that represents a segment on the dive profile and that contains tank pressures. There is an array of
+ * pr_track_t structures for each cylinder. These pr_track_t structures ultimately allow for filling
  * the missing tank pressure values on the dive profile using the depth_pressure of the dive. To do this, it
- * calculates the summed pressure-time value for the duration of the dive and stores these * in the pr_track_alloc
+ * calculates the summed pressure-time value for the duration of the dive and stores these in the pr_track_t
  * structures. This function is called by create_plot_info_new() in profile.c
  */
 void populate_pressure_information(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, int sensor)
@@ -371,7 +365,7 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 	UNUSED(dc);
 	int first, last, cyl;
 	cylinder_t *cylinder = dive->cylinder + sensor;
-	pr_track_t *track = NULL;
+	struct pr_track_table track = { 0, 0, NULL };
 	pr_track_t *current = NULL;
 	const struct event *ev, *b_ev;
 	int missing_pr = 0, dense = 1;
@@ -471,18 +465,17 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 		// missing entries that need to be interpolated.
 		// Or maybe we didn't have a previous one at all,
 		// and this is the first pressure entry.
-		current = pr_track_alloc(pressure, entry->sec);
-		track = list_add(track, current);
+		current = pr_track_add(&track, pressure, entry->sec);
 		dense = 1;
 	}
 
 	if (missing_pr) {
-		fill_missing_tank_pressures(dive, pi, track, sensor);
+		fill_missing_tank_pressures(dive, pi, &track, sensor);
 	}
 
 #ifdef PRINT_PRESSURES_DEBUG
 	debug_print_pressures(pi);
 #endif
 
-	list_free(track);
+	pr_track_table_free(&track);
 }
@@ -4,6 +4,7 @@
 #include "divelist.h"
 #include "qthelper.h"
 #include "imagedownloader.h"
+#include "thumbnailpack.h"
 #include "videoframeextractor.h"
 #include "qt-models/divepicturemodel.h"
 #include "metadata.h"
@@ -25,13 +26,22 @@ ImageDownloader *ImageDownloader::instance()
 	return &imageDownloader;
 }
 
-ImageDownloader::ImageDownloader()
+// Number of concurrent downloads
+static const int maxDownloads = 4;
+
+ImageDownloader::ImageDownloader() : downloading(0)
 {
 	connect(&manager, &QNetworkAccessManager::finished, this, &ImageDownloader::saveImage);
 }
 
 void ImageDownloader::load(QUrl url, QString filename)
 {
+	// Don't flood the network with requests, keep the surplus in a queue.
+	if (downloading >= maxDownloads) {
+		pending.enqueue({ url, filename });
+		return;
+	}
+	++downloading;
 	QNetworkRequest request(url);
 	request.setAttribute(QNetworkRequest::User, filename);
 	manager.get(request);
@@ -68,6 +78,12 @@ void ImageDownloader::saveImage(QNetworkReply *reply)
 	}
 
 	reply->deleteLater();
+
+	--downloading;
+	if (!pending.isEmpty()) {
+		QPair<QUrl, QString> next = pending.dequeue();
+		load(next.first, next.second);
+	}
 }
 
 static bool hasVideoFileExtension(const QString &filename)
@@ -180,11 +196,17 @@ Thumbnailer::Thumbnailer() : failImage(renderIcon(":filter-close", maxThumbnailS
 			     dummyImage(renderIcon(":camera-icon", maxThumbnailSize())),
 			     videoImage(renderIcon(":video-icon", maxThumbnailSize())),
 			     videoOverlayImage(renderIconWidth(":video-overlay", maxThumbnailSize())),
-			     unknownImage(renderIcon(":unknown-icon", maxThumbnailSize()))
+			     unknownImage(renderIcon(":unknown-icon", maxThumbnailSize())),
+			     nextId(0),
+			     nextSequence(0)
 {
-	// Currently, we only process one image at a time. Stefan Fuchs reported problems when
+	// Currently, we only decode one image at a time. Stefan Fuchs reported problems when
 	// calculating multiple thumbnails at once and this hopefully helps.
-	pool.setMaxThreadCount(1);
+	// Reading thumbnails from the cache is cheap and may run in parallel.
+	maxJobs[StageCache] = 2;
+	maxJobs[StageDecode] = 1;
+	running[StageCache] = running[StageDecode] = 0;
+	pool.setMaxThreadCount(maxJobs[StageCache] + maxJobs[StageDecode]);
 	connect(ImageDownloader::instance(), &ImageDownloader::loaded, this, &Thumbnailer::imageDownloaded);
 	connect(ImageDownloader::instance(), &ImageDownloader::failed, this, &Thumbnailer::imageDownloadFailed);
 	connect(VideoFrameExtractor::instance(), &VideoFrameExtractor::extracted, this, &Thumbnailer::frameExtracted);
@@ -250,44 +272,113 @@ Thumbnailer::Thumbnail Thumbnailer::getVideoThumbnailFromStream(QDataStream &str
 	return { res, MEDIATYPE_VIDEO, (int32_t)duration };
 }
 
-// Fetch a thumbnail from cache.
-// If Thumbnail::QImage is null, the thumbnail is scheduled for recreation.
-Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture_filename)
+// Thumbnails used to be stored in individual files. If there is such a file
+// for the picture, move its content to the thumbnail pack.
+// TODO: remove this code in due course
+static bool importThumbnailFile(const QString &picture_filename)
 {
 	QString filename = thumbnailFileName(picture_filename);
 	if (filename.isEmpty())
-		return { QImage(), MEDIATYPE_UNKNOWN, 0 };
+		return false;
 	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	QByteArray data = file.readAll();
+	file.close();
+
+	QDataStream stream(data);
+	quint32 type, duration = 0;
+	stream >> type;
+	if (type == MEDIATYPE_VIDEO)
+		stream >> duration;
+	if (stream.status() != QDataStream::Ok)
+		return false;
+	ThumbnailPack::instance()->put(picture_filename, type, (qint32)duration, data);
+	file.remove();
+	return true;
+}
+
+// The thumbnails of the largest level are stored under the name of the
+// picture, the smaller levels under the name with the level appended.
+static QString levelKey(const QString &picture_filename, int level)
+{
+	if (level >= Thumbnailer::maxThumbnailLevel)
+		return picture_filename;
+	return picture_filename + QChar(0) + QString::number(level);
+}
+
+// Scale a thumbnail down to the size of the given level. This is done
+// with smooth transformation, since it happens only once per thumbnail.
+static QImage scaleToLevel(const QImage &img, int level)
+{
+	int size = Thumbnailer::thumbnailLevelSize(level);
+	if (img.isNull() || (img.width() <= size && img.height() <= size))
+		return img;
+	return img.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+// Fetch a thumbnail of the given level from cache.
+// If Thumbnail::QImage is null, the thumbnail is scheduled for recreation.
+Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture_filename, int level)
+{
+	if (picture_filename.isEmpty())
+		return { QImage(), MEDIATYPE_UNKNOWN, 0 };
+
+	// Try the requested level first. Only pictures are stored at the
+	// smaller levels.
+	if (level < maxThumbnailLevel) {
+		Thumbnail res = getThumbnailFromPack(picture_filename, levelKey(picture_filename, level));
+		if (!res.img.isNull())
+			return res;
+	}
+
+	Thumbnail res = getThumbnailFromPack(picture_filename, picture_filename);
+	if (res.img.isNull() || level >= maxThumbnailLevel)
+		return res;
+
+	// Calculate the smaller level from the largest level and store it for the next time.
+	res.img = scaleToLevel(res.img, level);
+	if (res.type == MEDIATYPE_PICTURE)
+		addPictureLevelToCache(picture_filename, res.img, level);
+	return res;
+}
+
+Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromPack(const QString &picture_filename, const QString &key)
+{
+	ThumbnailPack::Entry entry;
+	QByteArray data;
+	if (!ThumbnailPack::instance()->get(key, entry, data)) {
+		if (key != picture_filename || !importThumbnailFile(picture_filename) ||
+		    !ThumbnailPack::instance()->get(key, entry, data))
+			return { QImage(), MEDIATYPE_UNKNOWN, 0 };
+	}
 
 	if (prefs.auto_recalculate_thumbnails) {
 		// Check if thumbnails is older than the (local) image file
 		QString filenameLocal = localFilePath(qPrintable(picture_filename));
 		QFileInfo pictureInfo(filenameLocal);
-		QFileInfo thumbnailInfo(file);
-		if (pictureInfo.exists() && thumbnailInfo.exists()) {
+		if (pictureInfo.exists()) {
 			QDateTime pictureTime = pictureInfo.lastModified();
-			QDateTime thumbnailTime = thumbnailInfo.lastModified();
-			if (pictureTime.isValid() && thumbnailTime.isValid() && thumbnailTime < pictureTime) {
-				// Both files exist, have valid timestamps and thumbnail was calculated before picture.
+			if (pictureTime.isValid() && entry.created < pictureTime.toMSecsSinceEpoch()) {
+				// Picture has a valid timestamp and thumbnail was calculated before picture.
 				// Return an empty thumbnail to signal recalculation of the thumbnail
 				return { QImage(), MEDIATYPE_UNKNOWN, 0 };
 			}
 		}
 	}
 
-	if (!file.open(QIODevice::ReadOnly))
-		return { QImage(), MEDIATYPE_UNKNOWN, 0 };
-	QDataStream stream(&file);
+	// The type is also stored in the index, so unknown files don't need to be decoded.
+	if (entry.type == MEDIATYPE_UNKNOWN)
+		return { unknownImage, MEDIATYPE_UNKNOWN, 0 };
 
-	// Each thumbnail file is composed of a media-type and an image file.
+	// Each thumbnail is composed of a media-type and an image file.
+	QDataStream stream(data);
 	quint32 type;
-	QImage res;
 	stream >> type;
 
 	switch (type) {
 	case MEDIATYPE_PICTURE:	return getPictureThumbnailFromStream(stream);
 	case MEDIATYPE_VIDEO:	return getVideoThumbnailFromStream(stream, picture_filename);
-	case MEDIATYPE_UNKNOWN:	return { unknownImage, MEDIATYPE_UNKNOWN, 0 };
 	default:		return { QImage(), MEDIATYPE_UNKNOWN, 0 };
 	}
 }
@@ -295,33 +386,30 @@ Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture
 Thumbnailer::Thumbnail Thumbnailer::addVideoThumbnailToCache(const QString &picture_filename, duration_t duration,
 							     const QImage &image, duration_t position)
 {
-	// The format of video thumbnails:
+	// The format of video thumbnails in the thumbnail pack:
 	//	uint32	MEDIATYPE_VIDEO
 	//	uint32	duration of video in seconds
 	//	uint32	number of pictures (0 = we didn't manage to extract a picture)
 	//	for each picture:
 	//		uint32	offset in msec from begining of video
 	//		QImage	frame
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
 
-		stream << (quint32)MEDIATYPE_VIDEO;
-		stream << (quint32)duration.seconds;
+	stream << (quint32)MEDIATYPE_VIDEO;
+	stream << (quint32)duration.seconds;
 
-		if (image.isNull()) {
-			// No image provided
-			stream << (quint32)0;
-		} else {
-			// Currently, we support at most one image
-			stream << (quint32)1;
-			stream << (quint32)position.seconds;
-			stream << image;
-		}
-
-		file.commit();
+	if (image.isNull()) {
+		// No image provided
+		stream << (quint32)0;
+	} else {
+		// Currently, we support at most one image
+		stream << (quint32)1;
+		stream << (quint32)position.seconds;
+		stream << image;
 	}
+
+	ThumbnailPack::instance()->put(picture_filename, MEDIATYPE_VIDEO, duration.seconds, data);
 	return { videoImage, MEDIATYPE_VIDEO, duration };
 }
 
@@ -341,29 +429,34 @@ Thumbnailer::Thumbnail Thumbnailer::fetchVideoThumbnail(const QString &filename,
 
 Thumbnailer::Thumbnail Thumbnailer::addPictureThumbnailToCache(const QString &picture_filename, const QImage &thumbnail)
 {
-	// The format of a picture-thumbnail is very simple:
+	// Store the thumbnail at every level, so that the smaller levels
+	// are not calculated from an outdated thumbnail later.
+	for (int level = 0; level <= maxThumbnailLevel; ++level)
+		addPictureLevelToCache(picture_filename, scaleToLevel(thumbnail, level), level);
+	return { thumbnail, MEDIATYPE_PICTURE, 0 };
+}
+
+void Thumbnailer::addPictureLevelToCache(const QString &picture_filename, const QImage &thumbnail, int level)
+{
+	// The format of a picture-thumbnail in the thumbnail pack is very simple:
 	// 	uint32	MEDIATYPE_PICTURE
 	// 	QImage	thumbnail
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
 
-		stream << (quint32)MEDIATYPE_PICTURE;
-		stream << thumbnail;
-		file.commit();
-	}
-	return { thumbnail, MEDIATYPE_PICTURE, 0 };
+	stream << (quint32)MEDIATYPE_PICTURE;
+	stream << thumbnail;
+
+	ThumbnailPack::instance()->put(levelKey(picture_filename, level), MEDIATYPE_PICTURE, 0, data);
 }
 
 Thumbnailer::Thumbnail Thumbnailer::addUnknownThumbnailToCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-		stream << (quint32)MEDIATYPE_UNKNOWN;
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream << (quint32)MEDIATYPE_UNKNOWN;
+
+	ThumbnailPack::instance()->put(picture_filename, MEDIATYPE_UNKNOWN, 0, data);
 	return { unknownImage, MEDIATYPE_UNKNOWN, 0 };
 }
 
@@ -378,8 +471,8 @@ void Thumbnailer::frameExtracted(QString filename, QImage thumbnail, duration_t
 		markVideoThumbnail(thumbnail);
 		addVideoThumbnailToCache(filename, duration, thumbnail, offset);
 		QMutexLocker l(&lock);
-		workingOn.remove(filename);
-		emit thumbnailChanged(filename, thumbnail, duration);
+		removeFromWorkQueue(filename);
+		emitAllLevels(filename, thumbnail, duration);
 	}
 }
 
@@ -392,7 +485,7 @@ void Thumbnailer::frameExtractionFailed(QString filename, duration_t duration)
 	// add to the thumbnail cache as a video image with unknown thumbnail.
 	addVideoThumbnailToCache(filename, duration, QImage(), { 0 });
 	QMutexLocker l(&lock);
-	workingOn.remove(filename);
+	removeFromWorkQueue(filename);
 }
 
 void Thumbnailer::frameExtractionInvalid(QString filename, duration_t)
@@ -402,65 +495,210 @@ void Thumbnailer::frameExtractionInvalid(QString filename, duration_t)
 	// to recalculate thumbnails with an updated ffmpeg binary..?
 	addUnknownThumbnailToCache(filename);
 	QMutexLocker l(&lock);
-	workingOn.remove(filename);
+	removeFromWorkQueue(filename);
 }
 
-void Thumbnailer::recalculate(QString filename)
+// Remove all levels of a thumbnail from the work-queue. Call with the lock held.
+void Thumbnailer::removeFromWorkQueue(const QString &filename)
 {
-	Thumbnail thumbnail = getHashedImage(filename, true);
+	for (int level = 0; level <= maxThumbnailLevel; ++level)
+		removeJob({ filename, level });
+}
 
-	// If we couldn't load the image from disk -> leave old thumbnail.
-	// The case "load from web" is a bit inconsistent: it will call into processItem() later
-	// and therefore a "broken" image symbol may be shown.
-	if (thumbnail.type == MEDIATYPE_STILL_LOADING || thumbnail.type == MEDIATYPE_IO_ERROR)
+// Send a thumbnail to the users of all levels. Call with the lock held.
+void Thumbnailer::emitAllLevels(const QString &filename, const QImage &img, duration_t duration)
+{
+	for (int level = 0; level <= maxThumbnailLevel; ++level)
+		emit thumbnailChanged(filename, scaleToLevel(img, level), duration, level);
+}
+
+// The functions below manage the work queue. Call them with the lock held.
+void Thumbnailer::addJob(const JobKey &key, Priority priority, Stage stage, bool recalculate)
+{
+	Job &job = jobs[key];
+	job.id = nextId++;
+	job.priority = priority;
+	job.stage = stage;
+	job.recalculate = recalculate;
+	job.tryDownload = true;
+	job.downloaded = false;
+	job.requests = 1;
+	enqueue(key, job);
+}
+
+void Thumbnailer::enqueue(const JobKey &key, Job &job)
+{
+	job.state = Job::Queued;
+	job.sequence = nextSequence++;
+	queues[job.stage].insert({ job.priority, job.sequence }, key);
+}
+
+void Thumbnailer::setJobPriority(const JobKey &key, Job &job, Priority priority)
+{
+	if (job.priority == priority)
+		return;
+	if (job.state != Job::Queued) {
+		job.priority = priority;
 		return;
+	}
+	queues[job.stage].remove({ job.priority, job.sequence });
+	job.priority = priority;
+	enqueue(key, job);
+}
+
+void Thumbnailer::removeJob(const JobKey &key)
+{
+	auto it = jobs.find(key);
+	if (it == jobs.end())
+		return;
+	if (it->state == Job::Queued)
+		queues[it->stage].remove({ it->priority, it->sequence });
+	jobs.erase(it);
+}
+
+// Remove a job that ran to completion. If the job was replaced in the
+// meantime by a new request, the new request is kept.
+void Thumbnailer::finishJob(const JobKey &key, quint64 id)
+{
+	auto it = jobs.find(key);
+	if (it != jobs.end() && it->id == id)
+		jobs.erase(it);
+}
+
+// Start the most urgent jobs of each stage, as long as there are free slots.
+void Thumbnailer::schedule()
+{
+	for (int i = 0; i < NumStages; ++i) {
+		Stage stage = static_cast<Stage>(i);
+		while (running[stage] < maxJobs[stage] && !queues[stage].isEmpty()) {
+			auto it = queues[stage].begin();
+			JobKey key = it.value();
+			queues[stage].erase(it);
+			Job &job = jobs[key];
+			job.state = Job::Running;
+			++running[stage];
+			QtConcurrent::run(&pool, [this, key, job, stage]() { runJob(key, job, stage); });
+		}
+	}
+}
+
+void Thumbnailer::runJob(JobKey key, Job job, Stage stage)
+{
+	if (stage == StageCache)
+		lookupItem(key, job.id);
+	else if (job.recalculate)
+		recalculate(key, job.id);
+	else
+		processItem(key, job.id, job.tryDownload);
 
 	QMutexLocker l(&lock);
-	emit thumbnailChanged(filename, thumbnail.img, thumbnail.duration);
-	workingOn.remove(filename);
+	--running[stage];
+	schedule();
 }
 
-void Thumbnailer::processItem(QString filename, bool tryDownload)
+// Send the thumbnail if it is in the cache. Otherwise, enqueue the job for
+// calculation of the thumbnail.
+void Thumbnailer::lookupItem(const JobKey &key, quint64 id)
 {
-	Thumbnail thumbnail = getThumbnailFromCache(filename);
+	Thumbnail thumbnail = getThumbnailFromCache(key.first, key.second);
 
-	if (thumbnail.img.isNull()) {
-		thumbnail = getHashedImage(filename, tryDownload);
-		if (thumbnail.type == MEDIATYPE_STILL_LOADING)
-			return;
+	QMutexLocker l(&lock);
+	if (!thumbnail.img.isNull()) {
+		emit thumbnailChanged(key.first, thumbnail.img, thumbnail.duration, key.second);
+		finishJob(key, id);
+		return;
+	}
 
-		if (thumbnail.img.isNull()) {
-			thumbnail.img = failImage;
-		} else {
-			int size = maxThumbnailSize();
-			thumbnail.img = thumbnail.img.scaled(size, size, Qt::KeepAspectRatio);
-		}
+	auto it = jobs.find(key);
+	if (it != jobs.end() && it->id == id) {
+		it->stage = StageDecode;
+		enqueue(key, *it);
+	}
+}
+
+// Keep the job, but don't enqueue it. It will be enqueued again once the
+// download has finished. If the download finished while the job was still
+// running, enqueue it right away.
+void Thumbnailer::waitForDownload(const JobKey &key, quint64 id)
+{
+	QMutexLocker l(&lock);
+	auto it = jobs.find(key);
+	if (it == jobs.end() || it->id != id)
+		return;
+	if (it->downloaded) {
+		it->downloaded = false;
+		enqueue(key, *it);
+	} else {
+		it->state = Job::Waiting;
+	}
+}
+
+void Thumbnailer::recalculate(const JobKey &key, quint64 id)
+{
+	Thumbnail thumbnail = getHashedImage(key.first, true);
+
+	if (thumbnail.type == MEDIATYPE_STILL_LOADING) {
+		waitForDownload(key, id);
+		return;
+	}
+
+	QMutexLocker l(&lock);
+	// If we couldn't load the image from disk -> leave old thumbnail.
+	if (thumbnail.type != MEDIATYPE_IO_ERROR)
+		emitAllLevels(key.first, thumbnail.img, thumbnail.duration);
+	finishJob(key, id);
+}
+
+void Thumbnailer::processItem(const JobKey &key, quint64 id, bool tryDownload)
+{
+	int level = key.second;
+	Thumbnail thumbnail = getHashedImage(key.first, tryDownload);
+	if (thumbnail.type == MEDIATYPE_STILL_LOADING) {
+		waitForDownload(key, id);
+		return;
 	}
 
+	if (thumbnail.img.isNull())
+		thumbnail.img = failImage;
+	else
+		thumbnail.img = scaleToLevel(thumbnail.img, level);
+
 	QMutexLocker l(&lock);
-	emit thumbnailChanged(filename, thumbnail.img, thumbnail.duration);
-	workingOn.remove(filename);
+	emit thumbnailChanged(key.first, thumbnail.img, thumbnail.duration, level);
+	finishJob(key, id);
 }
 
 void Thumbnailer::imageDownloaded(QString filename)
 {
-	// Image was downloaded -> try thumbnailing again.
+	// Image was downloaded -> try thumbnailing again for all requested levels.
 	QMutexLocker l(&lock);
-	workingOn[filename] = QtConcurrent::run(&pool, [this, filename]() { processItem(filename, false); });
+	for (int level = 0; level <= maxThumbnailLevel; ++level) {
+		JobKey key(filename, level);
+		auto it = jobs.find(key);
+		if (it == jobs.end())
+			continue;
+		it->tryDownload = false;
+		if (it->state == Job::Waiting)
+			enqueue(key, *it);
+		else if (it->state == Job::Running)
+			it->downloaded = true;
+	}
+	schedule();
 }
 
 void Thumbnailer::imageDownloadFailed(QString filename)
 {
-	emit thumbnailChanged(filename, failImage, duration_t{ 0 });
 	QMutexLocker l(&lock);
-	workingOn.remove(filename);
+	emitAllLevels(filename, failImage, duration_t{ 0 });
+	removeFromWorkQueue(filename);
 }
 
-QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous)
+QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous, int size, Priority priority)
 {
+	int level = thumbnailLevel(size);
 	if (synchronous) {
 		// In synchronous mode, first try the thumbnail cache.
-		Thumbnail thumbnail = getThumbnailFromCache(filename);
+		Thumbnail thumbnail = getThumbnailFromCache(filename, level);
 		if (!thumbnail.img.isNull())
 			return thumbnail.img;
 
@@ -469,29 +707,47 @@ QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous)
 		if (thumbnail.type == MEDIATYPE_STILL_LOADING || thumbnail.img.isNull())
 			return failImage; // No support for delayed thumbnails (web).
 
-		int size = maxThumbnailSize();
-		return thumbnail.img.scaled(size, size, Qt::KeepAspectRatio);
+		return scaleToLevel(thumbnail.img, level);
 	}
 
 	QMutexLocker l(&lock);
 
-	// We are not currently fetching this thumbnail - add it to the list.
-	if (!workingOn.contains(filename)) {
-		workingOn.insert(filename,
-				 QtConcurrent::run(&pool, [this, filename]() { processItem(filename, true); }));
+	// We are not currently fetching this thumbnail - add it to the queue.
+	// If we are, make sure that it is fetched at least with the given priority.
+	JobKey key(filename, level);
+	auto it = jobs.find(key);
+	if (it == jobs.end()) {
+		addJob(key, priority, StageCache, false);
+	} else {
+		++it->requests;
+		if (priority < it->priority)
+			setJobPriority(key, *it, priority);
 	}
+	schedule();
 	return dummyImage;
 }
 
+void Thumbnailer::setPriority(const QVector<QString> &filenames, int size, Priority priority)
+{
+	int level = thumbnailLevel(size);
+	QMutexLocker l(&lock);
+	for (const QString &filename: filenames) {
+		JobKey key(filename, level);
+		auto it = jobs.find(key);
+		if (it != jobs.end())
+			setJobPriority(key, *it, priority);
+	}
+}
+
 void Thumbnailer::calculateThumbnails(const QVector<QString> &filenames)
 {
 	QMutexLocker l(&lock);
 	for (const QString &filename: filenames) {
-		if (!workingOn.contains(filename)) {
-			workingOn.insert(filename,
-					 QtConcurrent::run(&pool, [this, filename]() { recalculate(filename); }));
-		}
+		JobKey key(filename, maxThumbnailLevel);
+		if (!jobs.contains(key))
+			addJob(key, PriorityBackground, StageDecode, true);
 	}
+	schedule();
 }
 
 void Thumbnailer::clearWorkQueue()
@@ -500,10 +756,24 @@ void Thumbnailer::clearWorkQueue()
 	// we don't get thumbnails that we don't care about.
 	VideoFrameExtractor::instance()->clearWorkQueue();
 
+	// Jobs that are currently running are finished, but their results are not
+	// acted upon, since they are not in the list of jobs anymore.
+	QMutexLocker l(&lock);
+	for (int i = 0; i < NumStages; ++i)
+		queues[i].clear();
+	jobs.clear();
+}
+
+void Thumbnailer::cancelThumbnails(const QVector<QString> &filenames, int size)
+{
+	int level = thumbnailLevel(size);
 	QMutexLocker l(&lock);
-	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
-		it->cancel();
-	workingOn.clear();
+	for (const QString &filename: filenames) {
+		JobKey key(filename, level);
+		auto it = jobs.find(key);
+		if (it != jobs.end() && --it->requests <= 0)
+			removeJob(key);
+	}
 }
 
 static const int maxZoom = 3;	// Maximum zoom: thrice of standard size
@@ -518,6 +788,22 @@ int Thumbnailer::maxThumbnailSize()
 	return defaultThumbnailSize() * maxZoom;
 }
 
+const int Thumbnailer::maxThumbnailLevel;
+
+int Thumbnailer::thumbnailLevelSize(int level)
+{
+	return static_cast<int>(round(defaultThumbnailSize() * pow(maxZoom, level - 1)));
+}
+
+int Thumbnailer::thumbnailLevel(int size)
+{
+	for (int level = 0; level < maxThumbnailLevel; ++level) {
+		if (thumbnailLevelSize(level) >= size)
+			return level;
+	}
+	return maxThumbnailLevel;
+}
+
 int Thumbnailer::thumbnailSize(double zoomLevel)
 {
 	// Calculate size of thumbnails. The standard size is defaultIconMetrics().sz_pic.
@@ -5,6 +5,8 @@
 #include "metadata.h"
 #include <QImage>
 #include <QFuture>
+#include <QPair>
+#include <QQueue>
 #include <QNetworkReply>
 #include <QThreadPool>
 
@@ -20,6 +22,8 @@ signals:
 	void failed(QString filename);
 private:
 	QNetworkAccessManager manager;
+	int downloading;			// number of running downloads
+	QQueue<QPair<QUrl, QString>> pending;	// downloads waiting for a free slot
 	void loadFromUrl(const QString &filename, const QUrl &);
 	void saveImage(QNetworkReply *reply);
 };
@@ -30,6 +34,16 @@ class Thumbnailer : public QObject {
 public:
 	static Thumbnailer *instance();
 
+	// Thumbnails are calculated in the order of their priority.
+	// Views should request the thumbnails that are on screen with
+	// PriorityVisible and update the priorities as the user scrolls.
+	enum Priority {
+		PriorityVisible,	// shown on screen
+		PriorityAdjacent,	// next to the thumbnails on screen
+		PriorityPrefetch,	// not shown, but may be scrolled to
+		PriorityBackground	// forced recalculation
+	};
+
 	// Schedule a thumbnail for fetching or calculation.
 	// If synchronous is false, returns a placeholder thumbnail.
 	// The actual thumbnail will be sent via a signal later.
@@ -37,16 +51,33 @@ public:
 	// In this mode only precalculated thumbnails or thumbnails
 	// from pictures are returned. Video extraction and remote
 	// images are not supported.
-	QImage fetchThumbnail(const QString &filename, bool synchronous);
+	// The thumbnail is returned at the smallest level at least as large as
+	// the given size, see thumbnailLevel() below.
+	QImage fetchThumbnail(const QString &filename, bool synchronous, int size, Priority priority = PriorityVisible);
+
+	// Change the priority of thumbnails that were requested but not yet sent.
+	void setPriority(const QVector<QString> &filenames, int size, Priority priority);
 
 	// Schedule multiple thumbnails for forced recalculation
 	void calculateThumbnails(const QVector<QString> &filenames);
 
 	// If we change dive, clear all unfinished thumbnail creations
 	void clearWorkQueue();
+
+	// Withdraw requests for thumbnails of the given size. Thumbnails that
+	// were also requested by others are still fetched.
+	void cancelThumbnails(const QVector<QString> &filenames, int size);
 	static int maxThumbnailSize();
 	static int defaultThumbnailSize();
 	static int thumbnailSize(double zoomLevel);
+
+	// Thumbnails are calculated and stored at a few discrete sizes ("levels"),
+	// so that small thumbnails don't have to be scaled down from large images
+	// when displayed. Level 0 is a third of the default size, level 1 is the
+	// default size and level 2 is the maximum size.
+	static const int maxThumbnailLevel = 2;
+	static int thumbnailLevelSize(int level);
+	static int thumbnailLevel(int size);	// smallest level at least as large as size
 public slots:
 	void imageDownloaded(QString filename);
 	void imageDownloadFailed(QString filename);
@@ -54,7 +85,9 @@ public slots:
 	void frameExtractionFailed(QString filename, duration_t duration);
 	void frameExtractionInvalid(QString filename, duration_t duration);
 signals:
-	void thumbnailChanged(QString filename, QImage thumbnail, duration_t duration);
+	// Sent when the thumbnail of the given level was calculated. Users should
+	// ignore the thumbnails of levels they didn't ask for.
+	void thumbnailChanged(QString filename, QImage thumbnail, duration_t duration, int level);
 private:
 	struct Thumbnail {
 		QImage img;
@@ -62,15 +95,51 @@ private:
 		duration_t duration;
 	};
 
+	// A thumbnail request is processed in two stages. First, the thumbnail is
+	// looked up in the cache, which is cheap. Only if that fails, the picture
+	// is loaded and scaled, which is expensive. Each stage has its own queue,
+	// ordered by priority, and its own limit on the number of concurrent jobs.
+	// Thus, cached thumbnails are not held up by the decoding of other pictures.
+	enum Stage {
+		StageCache,
+		StageDecode,
+		NumStages
+	};
+	typedef QPair<QString, int> JobKey;	// filename and level
+	struct Job {
+		enum State { Queued, Running, Waiting } state;	// Waiting: for a download
+		quint64 id;		// to recognize a job that was replaced by a new request
+		quint64 sequence;	// position in the queue among jobs of the same priority
+		Priority priority;
+		Stage stage;
+		bool recalculate;	// don't use the cached thumbnail
+		bool tryDownload;
+		bool downloaded;	// the download finished before the job started waiting for it
+		int requests;		// number of fetchThumbnail() calls that are not cancelled
+	};
+
 	Thumbnailer();
 	Thumbnail fetchVideoThumbnail(const QString &filename, const QString &originalFilename, duration_t duration);
 	Thumbnail extractVideoThumbnail(const QString &picture_filename, duration_t duration);
 	Thumbnail addPictureThumbnailToCache(const QString &picture_filename, const QImage &thumbnail);
+	void addPictureLevelToCache(const QString &picture_filename, const QImage &thumbnail, int level);
 	Thumbnail addVideoThumbnailToCache(const QString &picture_filename, duration_t duration, const QImage &thumbnail, duration_t position);
 	Thumbnail addUnknownThumbnailToCache(const QString &picture_filename);
-	void recalculate(QString filename);
-	void processItem(QString filename, bool tryDownload);
-	Thumbnail getThumbnailFromCache(const QString &picture_filename);
+	void addJob(const JobKey &key, Priority priority, Stage stage, bool recalculate);
+	void enqueue(const JobKey &key, Job &job);
+	void setJobPriority(const JobKey &key, Job &job, Priority priority);
+	void removeJob(const JobKey &key);
+	void finishJob(const JobKey &key, quint64 id);
+	void schedule();
+	void runJob(JobKey key, Job job, Stage stage);
+	void lookupItem(const JobKey &key, quint64 id);
+	void waitForDownload(const JobKey &key, quint64 id);
+	void recalculate(const JobKey &key, quint64 id);
+	void processItem(const JobKey &key, quint64 id, bool tryDownload);
+	void removeFromWorkQueue(const QString &filename);
+	void emitAllLevels(const QString &filename, const QImage &img, duration_t duration);
+	Thumbnail getThumbnailFromCache(const QString &picture_filename, int level);
+	Thumbnail getThumbnailFromPack(const QString &picture_filename, const QString &key);
 	Thumbnail getPictureThumbnailFromStream(QDataStream &stream);
 	Thumbnail getVideoThumbnailFromStream(QDataStream &stream, const QString &filename);
 	Thumbnail fetchImage(const QString &filename, const QString &originalFilename, bool tryDownload);
@@ -85,7 +154,12 @@ private:
 	QImage videoOverlayImage;	// Overlay for video thumbnails
 	QImage unknownImage;		// Place holder for files where we couldn't determine the type
 
-	QMap<QString,QFuture<void>> workingOn;
+	QMap<JobKey, Job> jobs;				// all requests that were not yet answered
+	QMap<QPair<int, quint64>, JobKey> queues[NumStages];	// by priority and sequence
+	int running[NumStages];
+	int maxJobs[NumStages];
+	quint64 nextId;
+	quint64 nextSequence;
 };
 
 #endif // IMAGEDOWNLOADER_H
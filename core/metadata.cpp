@@ -6,6 +6,10 @@
 #include <QString>
 #include <QFile>
 #include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QtConcurrent>
 
 // Weirdly, android builds fail owing to undefined UINT64_MAX
 #ifndef UINT64_MAX
@@ -516,14 +520,13 @@ static bool parseASF(QFile &f, metadata *metadata)
 	return false;
 }
 
-extern "C" mediatype_t get_metadata(const char *filename_in, metadata *data)
+static mediatype_t read_metadata(const QString &filename, metadata *data)
 {
 	data->timestamp = 0;
 	data->duration.seconds = 0;
 	data->location.lat.udeg = 0;
 	data->location.lon.udeg = 0;
 
-	QString filename = localFilePath(QString(filename_in));
 	QFile f(filename);
 	if (!f.open(QIODevice::ReadOnly))
 		return MEDIATYPE_IO_ERROR;
@@ -546,6 +549,69 @@ extern "C" mediatype_t get_metadata(const char *filename_in, metadata *data)
 	return res;
 }
 
+// The metadata of a file is read multiple times when importing pictures: for
+// the time-shift dialog, for matching to dives and for thumbnailing. Therefore,
+// cache the metadata. The entries are checked against the size and the modification
+// time of the file, so that changed files are read again.
+struct CachedMetadata {
+	qint64 size;
+	qint64 mtime;
+	mediatype_t type;
+	metadata data;
+};
+static QHash<QString, CachedMetadata> metadataCache;
+static QMutex metadataCacheLock;
+
+extern "C" mediatype_t get_metadata(const char *filename_in, metadata *data)
+{
+	QString filename = localFilePath(QString(filename_in));
+	QFileInfo info(filename);
+	qint64 size = info.size();
+	qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+	{
+		QMutexLocker l(&metadataCacheLock);
+		auto it = metadataCache.find(filename);
+		if (it != metadataCache.end() && it->size == size && it->mtime == mtime) {
+			*data = it->data;
+			return it->type;
+		}
+	}
+
+	mediatype_t res = read_metadata(filename, data);
+	if (res != MEDIATYPE_IO_ERROR) {
+		QMutexLocker l(&metadataCacheLock);
+		metadataCache.insert(filename, { size, mtime, res, *data });
+	}
+	return res;
+}
+
+static media_metadata scan_file(const QString &filename)
+{
+	media_metadata res;
+	res.type = get_metadata(qPrintable(filename), &res.data);
+	return res;
+}
+
+QVector<media_metadata> scan_metadata(const QVector<QString> &filenames, std::function<bool(int)> progress)
+{
+	// The files are read on the global thread pool. The parsers only read
+	// the headers, so that the scan is bound by the latency of the disk and
+	// profits from many reads in flight.
+	QFuture<media_metadata> future = QtConcurrent::mapped(filenames, scan_file);
+	while (progress) {
+		bool finished = future.isFinished();
+		if (!progress(finished ? filenames.size() : future.progressValue())) {
+			future.cancel();
+			future.waitForFinished();
+			return {};
+		}
+		if (finished)
+			break;
+		QThread::msleep(50);
+	}
+	return future.results().toVector();
+}
+
 extern "C" timestamp_t picture_get_timestamp(const char *filename)
 {
 	struct metadata data;
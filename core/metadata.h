@@ -26,6 +26,20 @@ timestamp_t picture_get_timestamp(const char *filename);
 
 #ifdef __cplusplus
 }
+
+#include <QString>
+#include <QVector>
+#include <functional>
+
+struct media_metadata {
+	mediatype_t type;
+	struct metadata data;
+};
+
+// Read the metadata of multiple files in parallel. The results are in the order of the files.
+// The progress function is called with the number of processed files. If it returns false,
+// the scan is canceled and an empty vector is returned.
+QVector<media_metadata> scan_metadata(const QVector<QString> &filenames, std::function<bool(int)> progress = {});
 #endif
 
 #endif // METADATA_H
@@ -196,47 +196,73 @@ static int get_local_sac(struct plot_data *entry1, struct plot_data *entry2, str
 }
 
 #define HALF_INTERVAL 9 * 30
+
+static int plot_depth(const struct plot_data *entry)
+{
+	return entry->depth;
+}
+
 /*
- * Run the min/max calculations: over a 9 minute interval
- * around the entry point (indices 0, 1, 2 respectively).
+ * Sliding window extremum over the plot entries: for every entry, find the
+ * index of the entry with the smallest (or largest) value in the interval of
+ * +/- half_interval seconds around it and store it in res[]. In case of ties,
+ * the first such entry is taken.
+ *
+ * Since the entries are sorted by time, both ends of the window only ever move
+ * forward. We keep a deque of candidate indices whose values are monotonic, so
+ * the front of the deque is always the extremum of the current window and every
+ * entry is pushed and popped at most once. Thus, this is O(n) instead of O(n*w).
  */
-static void analyze_plot_info_minmax(struct plot_info *pi, int entry_index)
+static void plot_window_extremum(const struct plot_info *pi, int half_interval, int (*value)(const struct plot_data *), bool maximum, int *res)
 {
-	struct plot_data *plot_entry = pi->entry + entry_index;  // fixed
-	struct plot_data *p = plot_entry;  // moves with 'entry'
-	int start = p->sec - HALF_INTERVAL, end = p->sec + HALF_INTERVAL;
-	int min, max;
-
-	/* Go back 'seconds' in time */
-	while (entry_index > 0) {
-		if (p[-1].sec < start)
-			break;
-		entry_index--;
-		p--;
-	}
+	int *deque;
+	int head = 0, tail = 0; /* deque is [head, tail) */
+	int i, next = 0;
 
-	// indexes to the min/max entries
-	min = max = entry_index;
+	if (pi->nr <= 0)
+		return;
+	deque = malloc(pi->nr * sizeof(*deque));
+	for (i = 0; i < pi->nr; i++) {
+		int start = pi->entry[i].sec - half_interval;
+		int end = pi->entry[i].sec + half_interval;
+
+		/* Add all entries up to the end of the window */
+		for (; next < pi->nr && pi->entry[next].sec <= end; next++) {
+			int v = value(pi->entry + next);
+			while (tail > head &&
+			       (maximum ? value(pi->entry + deque[tail - 1]) < v :
+					  value(pi->entry + deque[tail - 1]) > v))
+				tail--;
+			deque[tail++] = next;
+		}
 
-	/* Then go forward until we hit an entry past the time */
-	while (entry_index < pi->nr) {
-		int time = p->sec;
-		int depth = p->depth;
+		/* And drop the entries that fell out at the beginning */
+		while (pi->entry[deque[head]].sec < start)
+			head++;
 
-		if (time > end)
-			break;
+		res[i] = deque[head];
+	}
+	free(deque);
+}
 
-		if (depth < pi->entry[min].depth)
-			min = entry_index;
-		if (depth > pi->entry[max].depth)
-			max = entry_index;
+/*
+ * Run the min/max calculations: over a 9 minute interval
+ * around each entry point.
+ */
+static void analyze_plot_info_minmax(struct plot_info *pi)
+{
+	int i;
+	int *min = malloc(pi->nr * sizeof(*min));
+	int *max = malloc(pi->nr * sizeof(*max));
 
-		p++;
-		entry_index++;
+	plot_window_extremum(pi, HALF_INTERVAL, plot_depth, false, min);
+	plot_window_extremum(pi, HALF_INTERVAL, plot_depth, true, max);
+	for (i = 0; i < pi->nr; i++) {
+		pi->entry[i].min = min[i];
+		pi->entry[i].max = max[i];
 	}
-
-	plot_entry->min = min;
-	plot_entry->max = max;
+	free(min);
+	free(max);
 }
 
 static velocity_t velocity(int speed)
@@ -271,6 +297,7 @@ struct plot_info *analyze_plot_info(struct plot_info *pi)
 {
 	int i;
 	int nr = pi->nr;
+	int back = 0; /* last entry at least 15 seconds before the current one, if any */
 
 	/* Smoothing function: 5-point triangular smooth */
 	for (i = 2; i < nr; i++) {
@@ -281,6 +308,9 @@ struct plot_info *analyze_plot_info(struct plot_info *pi)
 			depth = entry[-2].depth + 2 * entry[-1].depth + 3 * entry[0].depth + 2 * entry[1].depth + entry[2].depth;
 			entry->smoothed = (depth + 4) / 9;
 		}
+		/* The times are sorted, therefore the 15 second look-back only moves forward */
+		while (back + 1 < i && entry->sec - pi->entry[back + 1].sec >= 15)
+			back++;
 		/* vertical velocity in mm/sec */
 		/* Linus wants to smooth this - let's at least look at the samples that aren't FAST or CRAZY */
 		if (entry[0].sec - entry[-1].sec) {
@@ -288,11 +318,9 @@ struct plot_info *analyze_plot_info(struct plot_info *pi)
 			entry->velocity = velocity(entry->speed);
 			/* if our samples are short and we aren't too FAST*/
 			if (entry[0].sec - entry[-1].sec < 15 && entry->velocity < FAST) {
-				int past = -2;
-				while (i + past > 0 && entry[0].sec - entry[past].sec < 15)
-					past--;
-				entry->velocity = velocity((entry[0].depth - entry[past].depth) /
-							   (entry[0].sec - entry[past].sec));
+				struct plot_data *past = pi->entry + back;
+				entry->velocity = velocity((entry->depth - past->depth) /
+							   (entry->sec - past->sec));
 			}
 		} else {
 			entry->velocity = STABLE;
@@ -301,8 +329,7 @@ struct plot_info *analyze_plot_info(struct plot_info *pi)
 	}
 
 	/* get minmax data */
-	for (i = 0; i < nr; i++)
-		analyze_plot_info_minmax(pi, i);
+	analyze_plot_info_minmax(pi);
 
 	return pi;
 }
@@ -1383,7 +1410,7 @@ struct divecomputer *select_dc(struct dive *dive)
 	return get_dive_dc(dive, i);
 }
 
-static void plot_string(struct plot_info *pi, struct plot_data *entry, struct membuffer *b)
+void plot_string(struct plot_info *pi, struct plot_data *entry, struct membuffer *b)
 {
 	int pressurevalue, mod, ead, end, eadd;
 	const char *depth_unit, *pressure_unit, *temp_unit, *vertical_speed_unit;
@@ -1535,18 +1562,45 @@ static void plot_string(struct plot_info *pi, struct plot_data *entry, struct me
 	strip_mb(b);
 }
 
+/*
+ * Return the index of the first plot entry at or after the given time,
+ * or pi->nr if there is none. The entries are sorted by time, so this
+ * is a simple binary search.
+ */
+int get_plot_entry_index(const struct plot_info *pi, int time)
+{
+	int low = 0, high = pi->nr;
+
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		if (pi->entry[mid].sec < time)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+/*
+ * Find the plot entry to show for the given time. If a membuffer is
+ * passed, the description of the entry is formatted into it - callers
+ * that cache the description can pass NULL and only format on a miss.
+ */
 struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *mb)
 {
-	struct plot_data *entry = NULL;
+	struct plot_data *entry;
 	int i;
 
 	/* The two first and the two last plot entries do not have useful data */
-	for (i = 2; i < pi->nr - 2; i++) {
-		entry = pi->entry + i;
-		if (entry->sec >= time)
-			break;
-	}
-	if (entry)
+	if (pi->nr <= 4)
+		return NULL;
+	i = get_plot_entry_index(pi, time);
+	if (i < 2)
+		i = 2;
+	else if (i > pi->nr - 3)
+		i = pi->nr - 3;
+	entry = pi->entry + i;
+	if (mb)
 		plot_string(pi, entry, mb);
 	return entry;
 }
@@ -80,7 +80,9 @@ extern void compare_samples(struct plot_data *e1, struct plot_data *e2, char *bu
 extern struct plot_info *analyze_plot_info(struct plot_info *pi);
 extern void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, struct deco_state *planner_ds);
 extern void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_de, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+extern int get_plot_entry_index(const struct plot_info *pi, int time);
 extern struct plot_data *get_plot_details_new(struct plot_info *pi, int time, struct membuffer *);
+extern void plot_string(struct plot_info *pi, struct plot_data *entry, struct membuffer *b);
 extern void free_plot_info_data(struct plot_info *pi);
 
 /*
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "profilerenderer.h"
+#include "dive.h"
+#include "display.h"
+#include "profile.h"
+#include "color.h"
+#include "units.h"
+
+#include <QImage>
+#include <QPainter>
+#include <QPainterPath>
+#include <QLinearGradient>
+#include <QFontDatabase>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+	// Maps times and depths to the profile area of the target rectangle
+	struct ProfileMapping {
+		QRectF area;
+		int maxtime;
+		int maxdepth;
+
+		double x(int sec) const
+		{
+			return area.left() + area.width() * sec / maxtime;
+		}
+		double y(int mm) const
+		{
+			return area.top() + area.height() * mm / maxdepth;
+		}
+	};
+
+	struct ProfileJob {
+		struct dive *d;
+		QString filename;
+		struct plot_info pi;
+	};
+}
+
+// Choose a step for the axis labels so that we get at most 'max' of them
+static int axisStep(int range, const int *steps, int nr, int max)
+{
+	for (int i = 0; i < nr; i++) {
+		if (range / steps[i] <= max)
+			return steps[i];
+	}
+	return steps[nr - 1];
+}
+
+static void paintAxes(QPainter &painter, const ProfileMapping &m, bool grayscale)
+{
+	static const int timeSteps[] = { 60, 2 * 60, 5 * 60, 10 * 60, 15 * 60, 20 * 60, 30 * 60, 60 * 60, 120 * 60 };
+	// in mm, such that the labels are round numbers in both unit systems
+	static const int metricDepthSteps[] = { 1000, 3000, 5000, 10000, 20000, 50000 };
+	static const int imperialDepthSteps[] = { 3048, 6096, 15240, 30480, 60960 };
+	const bool metric = get_units()->length == units::METERS;
+	const int *depthSteps = metric ? metricDepthSteps : imperialDepthSteps;
+	int nrDepthSteps = metric ? (int)(sizeof(metricDepthSteps) / sizeof(int)) : (int)(sizeof(imperialDepthSteps) / sizeof(int));
+	QFontMetricsF fm(painter.font());
+
+	int timeStep = axisStep(m.maxtime, timeSteps, sizeof(timeSteps) / sizeof(int), 12);
+	for (int sec = timeStep; sec < m.maxtime; sec += timeStep) {
+		painter.setPen(QPen(getColor(TIME_GRID, grayscale), 0));
+		painter.drawLine(QPointF(m.x(sec), m.area.top()), QPointF(m.x(sec), m.area.bottom()));
+		painter.setPen(getColor(TIME_TEXT, grayscale));
+		QString label = QString::number(sec / 60);
+		painter.drawText(QPointF(m.x(sec) - fm.width(label) / 2, m.area.bottom() + fm.ascent()), label);
+	}
+
+	int depthStep = axisStep(m.maxdepth, depthSteps, nrDepthSteps, 8);
+	for (int mm = depthStep; mm < m.maxdepth; mm += depthStep) {
+		const char *unit;
+		painter.setPen(QPen(getColor(DEPTH_GRID, grayscale), 0));
+		painter.drawLine(QPointF(m.area.left(), m.y(mm)), QPointF(m.area.right(), m.y(mm)));
+		painter.setPen(getColor(SAMPLE_DEEP, grayscale));
+		QString label = QString::number(lrint(get_depth_units(mm, NULL, &unit))) + unit;
+		painter.drawText(QPointF(m.area.left() - fm.width(label) - 2, m.y(mm) + fm.ascent() / 2), label);
+	}
+}
+
+static void paintDepth(QPainter &painter, const ProfileMapping &m, const struct plot_info &pi, bool grayscale)
+{
+	QPolygonF poly;
+	poly.reserve(pi.nr + 2);
+	for (int i = 0; i < pi.nr; i++)
+		poly.append(QPointF(m.x(pi.entry[i].sec), m.y(pi.entry[i].depth)));
+
+	QLinearGradient gradient(0, m.area.top(), 0, m.area.bottom());
+	gradient.setColorAt(0, getColor(DEPTH_TOP, grayscale));
+	gradient.setColorAt(1, getColor(DEPTH_BOTTOM, grayscale));
+	QPolygonF filled = poly;
+	filled.append(QPointF(poly.last().x(), m.area.top()));
+	filled.append(QPointF(poly.first().x(), m.area.top()));
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(gradient);
+	painter.drawPolygon(filled);
+
+	painter.setBrush(Qt::NoBrush);
+	painter.setPen(QPen(getColor(SAMPLE_DEEP, grayscale), 1.5));
+	painter.drawPolyline(poly);
+}
+
+static void paintCeilings(QPainter &painter, const ProfileMapping &m, const struct plot_info &pi, bool grayscale)
+{
+	QPolygonF calculated, reported;
+	bool haveCalculated = false, haveReported = false;
+
+	for (int i = 0; i < pi.nr; i++) {
+		const struct plot_data *entry = pi.entry + i;
+		int stop = entry->in_deco && entry->stopdepth ? std::min(entry->stopdepth, entry->depth) : 0;
+		haveCalculated |= entry->ceiling > 0;
+		haveReported |= stop > 0;
+		calculated.append(QPointF(m.x(entry->sec), m.y(entry->ceiling)));
+		reported.append(QPointF(m.x(entry->sec), m.y(stop)));
+	}
+
+	painter.setPen(Qt::NoPen);
+	if (prefs.calcceiling && haveCalculated) {
+		QLinearGradient gradient(0, m.area.top(), 0, m.area.bottom());
+		gradient.setColorAt(0, getColor(CALC_CEILING_SHALLOW, grayscale));
+		gradient.setColorAt(1, getColor(CALC_CEILING_DEEP, grayscale));
+		calculated.append(QPointF(calculated.last().x(), m.area.top()));
+		calculated.append(QPointF(calculated.first().x(), m.area.top()));
+		painter.setBrush(gradient);
+		painter.drawPolygon(calculated);
+	}
+	if (prefs.dcceiling && haveReported) {
+		QLinearGradient gradient(0, m.area.top(), 0, m.area.bottom());
+		gradient.setColorAt(0, getColor(CEILING_SHALLOW, grayscale));
+		gradient.setColorAt(1, getColor(CEILING_DEEP, grayscale));
+		reported.append(QPointF(reported.last().x(), m.area.top()));
+		reported.append(QPointF(reported.first().x(), m.area.top()));
+		painter.setBrush(gradient);
+		painter.drawPolygon(reported);
+	}
+	painter.setBrush(Qt::NoBrush);
+}
+
+static void paintMeanDepth(QPainter &painter, const ProfileMapping &m, const struct plot_info &pi, bool grayscale)
+{
+	if (!prefs.show_average_depth || !pi.meandepth)
+		return;
+	painter.setPen(QPen(getColor(MEAN_DEPTH, grayscale), 1, Qt::DashLine));
+	painter.drawLine(QPointF(m.area.left(), m.y(pi.meandepth)), QPointF(m.area.right(), m.y(pi.meandepth)));
+}
+
+// The temperature is plotted into the band between 70% and 90% of the profile height
+static void paintTemperature(QPainter &painter, const ProfileMapping &m, const struct plot_info &pi, bool grayscale)
+{
+	int range = std::max(pi.maxtemp - pi.mintemp, 2000);
+	double top = m.area.top() + m.area.height() * 0.7;
+	double height = m.area.height() * 0.2;
+	QPolygonF poly;
+
+	if (!pi.maxtemp)
+		return;
+	for (int i = 0; i < pi.nr; i++) {
+		const struct plot_data *entry = pi.entry + i;
+		if (!entry->temperature)
+			continue;
+		poly.append(QPointF(m.x(entry->sec), top + height * (pi.maxtemp - entry->temperature) / range));
+	}
+	painter.setPen(QPen(getColor(TEMP_PLOT, grayscale), 1.5));
+	painter.drawPolyline(poly);
+}
+
+// The tank pressures are plotted from the bottom of the profile to 80% of its height
+static void paintPressures(QPainter &painter, const ProfileMapping &m, const struct plot_info &pi, bool grayscale)
+{
+	if (pi.maxpressure <= 0)
+		return;
+
+	painter.setPen(QPen(getColor(PRESSURE_TEXT, grayscale), 1.5));
+	for (int cyl = 0; cyl < MAX_CYLINDERS; cyl++) {
+		QPolygonF poly;
+		for (int i = 0; i < pi.nr; i++) {
+			const struct plot_data *entry = pi.entry + i;
+			int mbar = get_plot_pressure(entry, cyl);
+			if (!mbar) {
+				// draw the segments separately, e.g. for gas switches
+				if (poly.size() > 1)
+					painter.drawPolyline(poly);
+				poly.clear();
+				continue;
+			}
+			poly.append(QPointF(m.x(entry->sec), m.area.bottom() - m.area.height() * 0.8 * mbar / pi.maxpressure));
+		}
+		if (poly.size() > 1)
+			painter.drawPolyline(poly);
+	}
+}
+
+static void paintEvents(QPainter &painter, const ProfileMapping &m, const struct dive *d, const struct plot_info &pi, bool grayscale)
+{
+	double size = std::max(4.0, m.area.height() / 50);
+
+	painter.setPen(QPen(getColor(EVENTS, grayscale), 1));
+	painter.setBrush(getColor(EVENTS, grayscale));
+	for (const struct event *ev = d->dc.events; ev; ev = ev->next) {
+		if (ev->deleted)
+			continue;
+		int idx = std::min(get_plot_entry_index(&pi, ev->time.seconds), pi.nr - 1);
+		QPointF pos(m.x(ev->time.seconds), m.y(pi.entry[idx].depth));
+		QPolygonF triangle;
+		triangle << pos << pos + QPointF(-size / 2, -size) << pos + QPointF(size / 2, -size);
+		painter.drawPolygon(triangle);
+	}
+	painter.setBrush(Qt::NoBrush);
+}
+
+void paintProfile(QPainter &painter, const QRect &rect, const struct dive *d, const struct plot_info &pi, bool grayscale)
+{
+	// get_maxtime() and get_maxdepth() take a non-const pointer
+	struct plot_info info = pi;
+	QFont font = painter.font();
+
+	painter.save();
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setClipRect(rect);
+	painter.fillRect(rect, getColor(BACKGROUND, grayscale));
+	if (info.nr <= 0) {
+		painter.restore();
+		return;
+	}
+
+	font.setPixelSize(std::max(8, rect.height() / 30));
+	painter.setFont(font);
+	QFontMetricsF fm(font);
+
+	ProfileMapping m;
+	m.maxtime = std::max(get_maxtime(&info), 1);
+	m.maxdepth = std::max(get_maxdepth(&info), 1);
+	m.area = QRectF(rect).adjusted(fm.width("000m") + 4, fm.height() / 2, -fm.height() / 2, -fm.height() - 2);
+
+	paintAxes(painter, m, grayscale);
+	paintDepth(painter, m, info, grayscale);
+	paintCeilings(painter, m, info, grayscale);
+	paintMeanDepth(painter, m, info, grayscale);
+	paintTemperature(painter, m, info, grayscale);
+	paintPressures(painter, m, info, grayscale);
+	if (d)
+		paintEvents(painter, m, d, info, grayscale);
+	painter.restore();
+}
+
+static bool saveProfileImage(const ProfileJob &job, const QSize &size)
+{
+	QImage image(size, QImage::Format_ARGB32_Premultiplied);
+	QPainter painter(&image);
+	paintProfile(painter, image.rect(), job.d, job.pi);
+	painter.end();
+	return image.save(job.filename);
+}
+
+int exportProfileImages(const QVector<struct dive *> &dives, const QVector<QString> &filenames, const QSize &size)
+{
+	// Work in batches, so that we don't keep the plot info of all dives in memory at once
+	const int batchSize = std::max(QThread::idealThreadCount(), 1) * 4;
+	// Painting text outside of the GUI thread is not supported on all platforms
+	const bool parallel = QFontDatabase::supportsThreadedFontRendering();
+	int nr = std::min(dives.size(), filenames.size());
+	int written = 0;
+
+	for (int start = 0; start < nr; start += batchSize) {
+		int end = std::min(start + batchSize, nr);
+		std::vector<ProfileJob> jobs(end - start);
+		QVector<QFuture<bool>> futures;
+
+		// The deco calculations are not reentrant, therefore create the plot infos here
+		for (int i = start; i < end; i++) {
+			ProfileJob &job = jobs[i - start];
+			job.d = dives[i];
+			job.filename = filenames[i];
+			memset(&job.pi, 0, sizeof(job.pi));
+			create_plot_info_new(job.d, &job.d->dc, &job.pi, false, NULL);
+		}
+
+		for (const ProfileJob &job: jobs) {
+			if (parallel)
+				futures.append(QtConcurrent::run([&job, size]() { return saveProfileImage(job, size); }));
+			else if (saveProfileImage(job, size))
+				written++;
+		}
+		for (QFuture<bool> &future: futures) {
+			if (future.result())
+				written++;
+		}
+
+		for (ProfileJob &job: jobs)
+			free_plot_info_data(&job.pi);
+	}
+	return written;
+}
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef PROFILERENDERER_H
+#define PROFILERENDERER_H
+
+#include <QString>
+#include <QVector>
+
+class QPainter;
+class QRect;
+class QSize;
+struct dive;
+struct plot_info;
+
+// Headless rendering of dive profiles.
+//
+// Contrary to the interactive ProfileWidget2, these functions paint a static
+// profile (depth, ceilings, mean depth, temperature, tank pressures, events
+// and the axes) directly with a QPainter: there is no QGraphicsScene, no
+// widget and no animation involved. Painting only reads the plot info, so
+// many profiles can be painted in parallel. Calculating the plot info, on the
+// other hand, uses the non-reentrant deco code and must be done on one thread.
+
+// Paint an already calculated profile into the given rectangle.
+void paintProfile(QPainter &painter, const QRect &rect, const struct dive *d, const struct plot_info &pi, bool grayscale = false);
+
+// Render the profiles of the given dives and save them as images. The plot info
+// is calculated on the calling thread, painting and encoding of the images is
+// done on the global thread pool. Returns the number of successfully written files.
+int exportProfileImages(const QVector<struct dive *> &dives, const QVector<QString> &filenames, const QSize &size);
+
+#endif // PROFILERENDERER_H
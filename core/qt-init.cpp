@@ -1,5 +1,5 @@
 // SPDX-License-Identifier: GPL-2.0
-#include <QApplication>
+#include <QGuiApplication>
 #include <Qt>
 #include <QNetworkProxy>
 #include <QLibraryInfo>
@@ -13,7 +13,7 @@ static QTranslator *qtTranslator, *ssrfTranslator;
 
 void init_qt_late()
 {
-	QApplication *application = qApp;
+	QCoreApplication *application = QCoreApplication::instance();
 	// tell Qt to use system proxies
 	// note: on Linux, "system" == "environment variables"
 	QNetworkProxyFactory::setUseSystemConfiguration(true);
@@ -21,7 +21,9 @@ void write_attribute(struct membuffer *b, const char *att_name, const char *valu
 	put_format(b, "\"%s", separator);
 }
 
-void save_photos(struct membuffer *b, const char *photos_dir, struct dive *dive)
+/* The photos themselves are copied by the caller, since the same
+ * photo may belong to more than one dive. */
+void save_photos(struct membuffer *b, struct dive *dive)
 {
 	struct picture *pic = dive->picture_list;
 
@@ -36,7 +38,6 @@ void save_photos(struct membuffer *b, const char *photos_dir, struct dive *dive)
 		put_string(b, "{\"filename\":\"");
 		put_quoted(b, fname, 1, 0);
 		put_string(b, "\"}");
-		copy_image_and_overwrite(local_file_path(pic), photos_dir, fname);
 		free(fname);
 		pic = pic->next;
 	} while (pic);
@@ -170,23 +171,61 @@ static void put_cylinder_HTML(struct membuffer *b, struct dive *dive)
 }
 
 
-void put_HTML_samples(struct membuffer *b, struct dive *dive)
+static void put_sample_array(struct membuffer *b, struct dive *dive)
 {
 	int i;
-	put_format(b, "\"maxdepth\":%d,", dive->dc.maxdepth.mm);
-	put_format(b, "\"duration\":%d,", dive->dc.duration.seconds);
 	struct sample *s = dive->dc.sample;
-
-	if (!dive->dc.samples)
-		return;
-
-	char *separator = "\"samples\":[";
+	char *separator = "[";
 	for (i = 0; i < dive->dc.samples; i++) {
 		put_format(b, "%s[%d,%d,%d,%d]", separator, s->time.seconds, s->depth.mm, s->pressure[0].mbar, s->temperature.mkelvin);
 		separator = ", ";
 		s++;
 	}
-	put_string(b, "],");
+	put_string(b, "]");
+}
+
+/* The samples make up most of the exported data. If samples_dir is given, they
+ * are written into a file of their own, which is only loaded when the dive is shown.
+ * This may be called from worker threads, therefore errors are not reported.
+ * Instead, the samples are written inline. */
+static bool write_samples_file(struct membuffer *b, struct dive *dive, const char *samples_dir, int dive_no)
+{
+	struct membuffer samples = { 0 };
+	char *file_name;
+	FILE *f;
+	bool ok = false;
+
+	put_format(&samples, "samples_loaded(%d,", dive_no);
+	put_sample_array(&samples, dive);
+	put_string(&samples, ");\n");
+
+	file_name = format_string("%sdive%d.js", samples_dir, dive_no);
+	f = subsurface_fopen(file_name, "w");
+	if (f) {
+		flush_buffer(&samples, f);
+		ok = !ferror(f);
+		ok = !fclose(f) && ok;
+	}
+	if (ok)
+		put_format(b, "\"samples_file\":\"samples/dive%d.js\",", dive_no);
+	free(file_name);
+	free_buffer(&samples);
+	return ok;
+}
+
+void put_HTML_samples(struct membuffer *b, struct dive *dive, const char *samples_dir, int dive_no)
+{
+	put_format(b, "\"maxdepth\":%d,", dive->dc.maxdepth.mm);
+	put_format(b, "\"duration\":%d,", dive->dc.duration.seconds);
+
+	if (!dive->dc.samples)
+		return;
+
+	if (samples_dir && write_samples_file(b, dive, samples_dir, dive_no))
+		return;
+	put_string(b, "\"samples\":");
+	put_sample_array(b, dive);
+	put_string(b, ",");
 }
 
 void put_HTML_coordinates(struct membuffer *b, struct dive *dive)
@@ -342,10 +381,10 @@ void put_HTML_tags(struct membuffer *b, struct dive *dive, const char *pre, cons
 }
 
 /* if exporting list_only mode, we neglect exporting the samples, bookmarks and cylinders */
-void write_one_dive(struct membuffer *b, struct dive *dive, const char *photos_dir, int *dive_no, const bool list_only)
+static void write_one_dive(struct membuffer *b, struct dive *dive, int dive_no, bool photos, const char *samples_dir, const bool list_only)
 {
 	put_string(b, "{");
-	put_format(b, "\"number\":%d,", *dive_no);
+	put_format(b, "\"number\":%d,", dive_no);
 	put_format(b, "\"subsurface_number\":%d,", dive->number);
 	put_HTML_date(b, dive, "\"date\":\"", "\",");
 	put_HTML_time(b, dive, "\"time\":\"", "\",");
@@ -366,81 +405,31 @@ void write_one_dive(struct membuffer *b, struct dive *dive, const char *photos_d
 	if (!list_only) {
 		put_cylinder_HTML(b, dive);
 		put_weightsystem_HTML(b, dive);
-		put_HTML_samples(b, dive);
+		put_HTML_samples(b, dive, samples_dir, dive_no);
 		put_HTML_bookmarks(b, dive);
 		write_dive_status(b, dive);
-		if (photos_dir && strcmp(photos_dir, ""))
-			save_photos(b, photos_dir, dive);
+		if (photos)
+			save_photos(b, dive);
 		write_divecomputers(b, dive);
 	}
 	put_HTML_notes(b, dive, "\"notes\":\"", "\"");
 	put_string(b, "}\n");
-	(*dive_no)++;
 }
 
-void write_no_trip(struct membuffer *b, int *dive_no, bool selected_only, const char *photos_dir, const bool list_only, char *sep)
+static bool export_dive(const struct dive *dive, bool selected_only)
 {
-	int i;
-	struct dive *dive;
-	char *separator = "";
-	bool found_sel_dive = 0;
-
-	for_each_dive (i, dive) {
-		// write dive if it doesn't belong to any trip and the dive is selected
-		// or we are in exporting all dives mode.
-		if (!dive->divetrip && (dive->selected || !selected_only)) {
-			if (!found_sel_dive) {
-				put_format(b, "%c{", *sep);
-				(*sep) = ',';
-				put_format(b, "\"name\":\"Other\",");
-				put_format(b, "\"dives\":[");
-				found_sel_dive = 1;
-			}
-			put_string(b, separator);
-			separator = ", ";
-			write_one_dive(b, dive, photos_dir, dive_no, list_only);
-		}
-	}
-	if (found_sel_dive)
-		put_format(b, "]}\n\n");
+	return dive->selected || !selected_only;
 }
 
-void write_trip(struct membuffer *b, dive_trip_t *trip, int *dive_no, bool selected_only, const char *photos_dir, const bool list_only, char *sep)
+/* Collect the exported dives in the order in which they are written: the dives
+ * of each trip in the order of the trips' first dives, followed by the dives
+ * without a trip, which are put into the group "Other". */
+int html_export_entries(struct html_export_entry **entries_out, bool selected_only)
 {
-	struct dive *dive;
-	char *separator = "";
-	bool found_sel_dive = 0;
-
-	for (int i = 0; i < trip->dives.nr; i++) {
-		dive = trip->dives.dives[i];
-		if (!dive->selected && selected_only)
-			continue;
-
-		// save trip if found at least one selected dive.
-		if (!found_sel_dive) {
-			found_sel_dive = 1;
-			put_format(b, "%c {", *sep);
-			(*sep) = ',';
-			write_attribute(b, "name", trip->location, ", ");
-			put_format(b, "\"dives\":[");
-		}
-		put_string(b, separator);
-		separator = ", ";
-		write_one_dive(b, dive, photos_dir, dive_no, list_only);
-	}
-
-	// close the trip object if contain dives.
-	if (found_sel_dive)
-		put_format(b, "]}\n\n");
-}
-
-void write_trips(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only)
-{
-	int i, dive_no = 0;
+	int i, j, nr = 0;
 	struct dive *dive;
 	dive_trip_t *trip;
-	char sep_ = ' ';
-	char *sep = &sep_;
+	struct html_export_entry *entries = malloc(dive_table.nr * sizeof(*entries));
 
 	for (i = 0; i < trip_table.nr; ++i)
 		trip_table.trips[i]->saved = 0;
@@ -452,37 +441,73 @@ void write_trips(struct membuffer *b, const char *photos_dir, bool selected_only
 		if (!trip || trip->saved)
 			continue;
 
-		/* We haven't seen this trip before - save it and all dives */
+		/* We haven't seen this trip before - save all its dives */
 		trip->saved = 1;
-		write_trip(b, trip, &dive_no, selected_only, photos_dir, list_only, sep);
+		for (j = 0; j < trip->dives.nr; j++) {
+			if (!export_dive(trip->dives.dives[j], selected_only))
+				continue;
+			entries[nr].dive = trip->dives.dives[j];
+			entries[nr].trip = trip;
+			nr++;
+		}
+	}
+
+	/*Save all remaining dives into Others*/
+	for_each_dive (i, dive) {
+		if (dive->divetrip || !export_dive(dive, selected_only))
+			continue;
+		entries[nr].dive = dive;
+		entries[nr].trip = NULL;
+		nr++;
 	}
 
-	/*Save all remaining trips into Others*/
-	write_no_trip(b, &dive_no, selected_only, photos_dir, list_only, sep);
+	*entries_out = entries;
+	return nr;
 }
 
-void export_list(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only)
+static void write_group_header(struct membuffer *b, const dive_trip_t *trip, char sep)
 {
-	put_string(b, "trips=[");
-	write_trips(b, photos_dir, selected_only, list_only);
-	put_string(b, "]");
+	if (trip) {
+		put_format(b, "%c {", sep);
+		write_attribute(b, "name", trip->location, ", ");
+	} else {
+		put_format(b, "%c{", sep);
+		put_format(b, "\"name\":\"Other\",");
+	}
+	put_format(b, "\"dives\":[");
 }
 
-void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only)
+/* Write the dives [from, to) of the entries. The dive number in the export is
+ * the index into the entries, therefore any range can be written on its own
+ * and the concatenation of consecutive ranges gives the same output as
+ * writing all entries at once. */
+void write_html_entries(struct membuffer *b, const struct html_export_entry *entries, int nr, int from, int to,
+			bool photos, const char *samples_dir, const bool list_only)
 {
-	FILE *f;
-
-	struct membuffer buf = { 0 };
-	export_list(&buf, photos_dir, selected_only, list_only);
+	int i;
 
-	f = subsurface_fopen(file_name, "w+");
-	if (!f) {
-		report_error(translate("gettextFromC", "Can't open file %s"), file_name);
-	} else {
-		flush_buffer(&buf, f); /*check for writing errors? */
-		fclose(f);
+	for (i = from; i < to; i++) {
+		bool first_in_group = i == 0 || entries[i - 1].trip != entries[i].trip;
+		if (first_in_group)
+			write_group_header(b, entries[i].trip, i == 0 ? ' ' : ',');
+		else
+			put_string(b, ", ");
+		write_one_dive(b, entries[i].dive, i, photos, samples_dir, list_only);
+		if (i == nr - 1 || entries[i + 1].trip != entries[i].trip)
+			put_format(b, "]}\n\n");
 	}
-	free_buffer(&buf);
+}
+
+void export_list(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only)
+{
+	struct html_export_entry *entries;
+	int nr = html_export_entries(&entries, selected_only);
+	bool photos = photos_dir && strcmp(photos_dir, "");
+
+	put_string(b, "trips=[");
+	write_html_entries(b, entries, nr, 0, nr, photos, NULL, list_only);
+	put_string(b, "]");
+	free(entries);
 }
 
 void export_translation(const char *file_name)
@@ -541,6 +566,7 @@ void export_translation(const char *file_name)
 	//dive detailed view
 	write_attribute(b, "Dive_No", translate("gettextFromC", "Dive #"), ", ");
 	write_attribute(b, "Dive_profile", translate("gettextFromC", "Dive profile"), ", ");
+	write_attribute(b, "No_profile", translate("gettextFromC", "No dive profile available"), ", ");
 	write_attribute(b, "Dive_information", translate("gettextFromC", "Dive information"), ", ");
 	write_attribute(b, "Dive_equipment", translate("gettextFromC", "Dive equipment"), ", ");
 	write_attribute(b, "Type", translate("gettextFromC", "Type"), ", ");
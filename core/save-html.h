@@ -19,8 +19,20 @@ void put_HTML_quoted(struct membuffer *b, const char *text);
 void put_HTML_pressure_units(struct membuffer *b, pressure_t pressure, const char *pre, const char *post);
 void put_HTML_weight_units(struct membuffer *b, unsigned int grams, const char *pre, const char *post);
 void put_HTML_volume_units(struct membuffer *b, unsigned int ml, const char *pre, const char *post);
+void put_HTML_samples(struct membuffer *b, struct dive *dive, const char *samples_dir, int dive_no);
 
-void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only);
+/* A dive of the export and the trip it is listed under (NULL for the "Other" group) */
+struct html_export_entry {
+	struct dive *dive;
+	struct dive_trip *trip;
+};
+
+/* Fills out a newly allocated array of the exported dives, which has to be freed by the caller. */
+int html_export_entries(struct html_export_entry **entries, bool selected_only);
+/* Writes the entries [from, to) of an array of nr entries. The dives are numbered by
+ * their index, so that ranges can be formatted independently and concatenated. */
+void write_html_entries(struct membuffer *b, const struct html_export_entry *entries, int nr, int from, int to,
+			bool photos, const char *samples_dir, const bool list_only);
 void export_list(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only);
 
 void export_translation(const char *file_name);
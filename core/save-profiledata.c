@@ -192,7 +192,7 @@ static void put_st_event(struct membuffer *b, struct plot_data *entry, int offse
 	put_format(b, "\n");
 }
 
-static void save_profiles_buffer(struct membuffer *b, bool select_only)
+void save_profiles_buffer(struct membuffer *b, bool select_only)
 {
 	int i;
 	struct dive *dive;
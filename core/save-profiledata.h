@@ -9,6 +9,7 @@ extern "C" {
 #endif
 
 int save_profiledata(const char *filename, bool selected_only);
+void save_profiles_buffer(struct membuffer *b, bool selected_only);
 void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, int length);
 
 #ifdef __cplusplus
@@ -41,6 +41,9 @@ static const QByteArray st_windowState_default;
 int qPrefDisplay::st_lastState;
 static int st_lastState_default = false;
 
+bool qPrefDisplay::st_opengl_profile;
+static bool st_opengl_profile_default = false;
+
 qPrefDisplay::qPrefDisplay(QObject *parent) : QObject(parent)
 {
 }
@@ -70,6 +73,7 @@ void qPrefDisplay::loadSync(bool doSync)
 		load_geometry();
 		load_windowState();
 		load_lastState();
+		load_opengl_profile();
 
 	}
 }
@@ -202,3 +206,5 @@ HANDLE_PROP_QBYTEARRAY(Display, "MainWindow/geometry", geometry);
 HANDLE_PROP_QBYTEARRAY(Display, "MainWindow/windowState", windowState);
 
 HANDLE_PROP_INT(Display, "MainWindow/lastState", lastState);
+
+HANDLE_PROP_BOOL(Display, "ProfileMap/opengl", opengl_profile);
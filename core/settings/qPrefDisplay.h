@@ -25,6 +25,7 @@ class qPrefDisplay : public QObject {
 	Q_PROPERTY(QByteArray geometry READ geometry WRITE set_geometry NOTIFY geometryChanged);
 	Q_PROPERTY(QByteArray windowState READ windowState WRITE set_windowState NOTIFY windowStateChanged);
 	Q_PROPERTY(int lastState READ lastState WRITE set_lastState NOTIFY lastStateChanged);
+	Q_PROPERTY(bool opengl_profile READ opengl_profile WRITE set_opengl_profile NOTIFY opengl_profileChanged);
 
 public:
 	qPrefDisplay(QObject *parent = NULL);
@@ -53,6 +54,7 @@ public:
 	static QByteArray geometry() { return st_geometry; }
 	static QByteArray windowState() { return st_windowState; }
 	static int lastState() { return st_lastState; }
+	static bool opengl_profile() { return st_opengl_profile; }
 
 public slots:
 	static void set_animation_speed(int value);
@@ -72,6 +74,7 @@ public slots:
 	static void set_geometry(const QByteArray& value);
 	static void set_windowState(const QByteArray& value);
 	static void set_lastState(int value);
+	static void set_opengl_profile(bool value);
 
 signals:
 	void animation_speedChanged(int value);
@@ -91,6 +94,7 @@ signals:
 	void geometryChanged(const QByteArray& value);
 	void windowStateChanged(const QByteArray& value);
 	void lastStateChanged(int value);
+	void opengl_profileChanged(bool value);
 
 private:
 	// functions to load/sync variable with disk
@@ -113,6 +117,7 @@ private:
 	static void load_geometry();
 	static void load_windowState();
 	static void load_lastState();
+	static void load_opengl_profile();
 
 	// font helper function
 	static void setCorrectFont();
@@ -129,5 +134,6 @@ private:
 	static QByteArray st_geometry;
 	static QByteArray st_windowState;
 	static int st_lastState;
+	static bool st_opengl_profile;
 };
 #endif
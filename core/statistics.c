@@ -5,6 +5,7 @@
  * char *get_minutes(int seconds);
  * void calculate_stats_summary(struct stats_summary *out, bool selected_only);
  * void calculate_stats_selected(stats_t *stats_selection);
+ * void calculate_stats_groups(struct stats_grouping *out, const enum stats_group_by *by, int nr, bool selected_only);
  */
 #include "gettext.h"
 #include <string.h>
@@ -12,6 +13,9 @@
 
 #include "dive.h"
 #include "display.h"
+#include "divesite.h"
+#include "subsurface-string.h"
+#include "tag.h"
 #include "trip.h"
 #include "statistics.h"
 #include "units.h"
@@ -304,6 +308,253 @@ void calculate_stats_selected(stats_t *stats_selection)
 	stats_selection->selection_size = nr;
 }
 
+/*
+ * Grouped statistics. The dive table is scanned only once, independent of
+ * the number of groupings: for every dive the aggregated values are
+ * calculated and for every requested grouping an entry (key, dive) is
+ * recorded for each key of the dive. Then the entries of each grouping
+ * are sorted by key and every run of equal keys forms a group.
+ */
+struct group_entry {
+	char *key;
+	int dive;	/* index into the values of the scan */
+};
+
+struct group_entries {
+	struct group_entry *entries;
+	int nr, allocated;
+};
+
+/* Takes ownership of the key */
+static void add_group_entry_owned(struct group_entries *e, char *key, int dive)
+{
+	if (e->nr >= e->allocated) {
+		e->allocated = (e->nr + 1) * 3 / 2;
+		e->entries = realloc(e->entries, e->allocated * sizeof(struct group_entry));
+	}
+	e->entries[e->nr].key = key;
+	e->entries[e->nr].dive = dive;
+	e->nr++;
+}
+
+static void add_group_entry(struct group_entries *e, const char *key, int dive)
+{
+	if (!empty_string(key))
+		add_group_entry_owned(e, strdup(key), dive);
+}
+
+/* Add the names of a comma separated list, such as the buddies */
+static void add_group_names(struct group_entries *e, const char *s, int dive)
+{
+	while (!empty_string(s)) {
+		const char *end = strchr(s, ',');
+		const char *from = s;
+		size_t len = end ? (size_t)(end - s) : strlen(s);
+
+		while (len && isspace((unsigned char)*from)) {
+			from++;
+			len--;
+		}
+		while (len && isspace((unsigned char)from[len - 1]))
+			len--;
+		if (len) {
+			char *name = malloc(len + 1);
+			memcpy(name, from, len);
+			name[len] = '\0';
+			add_group_entry_owned(e, name, dive);
+		}
+		s = end ? end + 1 : NULL;
+	}
+}
+
+/* Duplicate keys of a dive are removed when building the groups */
+static void add_group_keys(struct group_entries *e, enum stats_group_by by, const struct dive *dive, int idx)
+{
+	const struct tag_entry *tag;
+	const struct divecomputer *dc;
+	struct tm tm;
+	char buf[8];
+	int i;
+
+	switch (by) {
+	case STATS_BY_SITE:
+		if (dive->dive_site)
+			add_group_entry(e, dive->dive_site->name, idx);
+		break;
+	case STATS_BY_BUDDY:
+		add_group_names(e, dive->buddy, idx);
+		add_group_names(e, dive->divemaster, idx);
+		break;
+	case STATS_BY_TAG:
+		for (tag = dive->tag_list; tag; tag = tag->next)
+			add_group_entry(e, tag->tag->name, idx);
+		break;
+	case STATS_BY_SUIT:
+		add_group_entry(e, dive->suit, idx);
+		break;
+	case STATS_BY_CYLINDER_TYPE:
+		for (i = 0; i < MAX_CYLINDERS; i++) {
+			if (is_cylinder_used(dive, i))
+				add_group_entry(e, dive->cylinder[i].type.description, idx);
+		}
+		break;
+	case STATS_BY_GASMIX:
+		for (i = 0; i < MAX_CYLINDERS; i++) {
+			if (is_cylinder_used(dive, i))
+				add_group_entry(e, gasname(dive->cylinder[i].gasmix), idx);
+		}
+		break;
+	case STATS_BY_DIVE_COMPUTER:
+		for (dc = &dive->dc; dc; dc = dc->next)
+			add_group_entry(e, dc->model, idx);
+		break;
+	case STATS_BY_HOUR:
+		utc_mkdate(dive->when, &tm);
+		snprintf(buf, sizeof(buf), "%02d", tm.tm_hour);
+		add_group_entry(e, buf, idx);
+		break;
+	default:
+		break;
+	}
+}
+
+static int compare_group_entries(const void *a, const void *b)
+{
+	const struct group_entry *e1 = a, *e2 = b;
+	int res = strcmp(e1->key, e2->key);
+	if (res)
+		return res;
+	return e1->dive - e2->dive;
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+	int i1 = *(const int *)a, i2 = *(const int *)b;
+	return (i1 > i2) - (i1 < i2);
+}
+
+static void make_groups(struct stats_grouping *out, struct group_entries *e, int (*values)[STATS_VAR_NUM])
+{
+	int first, last, i, v;
+
+	out->nr = 0;
+	out->groups = NULL;
+	if (!e->nr)
+		return;
+	qsort(e->entries, e->nr, sizeof(struct group_entry), compare_group_entries);
+
+	/* There can't be more groups than entries */
+	out->groups = calloc(e->nr, sizeof(struct stats_group));
+	for (first = 0; first < e->nr; first = last) {
+		struct stats_group *group = &out->groups[out->nr++];
+
+		for (last = first; last < e->nr && !strcmp(e->entries[last].key, e->entries[first].key); last++) {
+			if (last == first || e->entries[last].dive != e->entries[last - 1].dive)
+				group->dive_count++;
+		}
+		group->name = e->entries[first].key;
+		e->entries[first].key = NULL;
+
+		for (v = 0; v < STATS_VAR_NUM; v++) {
+			struct stats_aggregate *aggregate = &group->var[v];
+			aggregate->values = malloc(group->dive_count * sizeof(int));
+			for (i = first; i < last; i++) {
+				int value;
+				if (i > first && e->entries[i].dive == e->entries[i - 1].dive)
+					continue;
+				value = values[e->entries[i].dive][v];
+				if (!value)
+					continue;
+				aggregate->values[aggregate->count++] = value;
+				aggregate->sum += value;
+			}
+			qsort(aggregate->values, aggregate->count, sizeof(int), compare_ints);
+			if (aggregate->count) {
+				aggregate->min = aggregate->values[0];
+				aggregate->max = aggregate->values[aggregate->count - 1];
+			}
+		}
+	}
+	for (i = 0; i < e->nr; i++)
+		free(e->entries[i].key);
+}
+
+/*
+ * Calculate the statistics for nr groupings at once. The results are
+ * written to the first nr elements of out, which must be freed with
+ * free_stats_groups().
+ */
+void calculate_stats_groups(struct stats_grouping *out, const enum stats_group_by *by, int nr, bool selected_only)
+{
+	int idx, j, n = 0;
+	struct dive *dive;
+	int (*values)[STATS_VAR_NUM];
+	struct group_entries *entries;
+
+	values = malloc((dive_table.nr + 1) * sizeof(*values));
+	entries = calloc(nr, sizeof(struct group_entries));
+	for_each_dive (idx, dive) {
+		if (selected_only && !dive->selected)
+			continue;
+		values[n][STATS_VAR_DURATION] = dive->duration.seconds;
+		values[n][STATS_VAR_MAX_DEPTH] = dive->maxdepth.mm;
+		values[n][STATS_VAR_MEAN_DEPTH] = dive->meandepth.mm;
+		values[n][STATS_VAR_SAC] = dive->sac;
+		values[n][STATS_VAR_WATER_TEMP] = dive->watertemp.mkelvin;
+		values[n][STATS_VAR_OTU] = dive->otu;
+		values[n][STATS_VAR_CNS] = dive->cns;
+		values[n][STATS_VAR_RATING] = dive->rating;
+		for (j = 0; j < nr; j++)
+			add_group_keys(&entries[j], by[j], dive, n);
+		n++;
+	}
+
+	for (j = 0; j < nr; j++) {
+		out[j].by = by[j];
+		make_groups(&out[j], &entries[j], values);
+		free(entries[j].entries);
+	}
+	free(entries);
+	free(values);
+}
+
+void free_stats_groups(struct stats_grouping *groupings, int nr)
+{
+	int i, j, v;
+
+	for (i = 0; i < nr; i++) {
+		for (j = 0; j < groupings[i].nr; j++) {
+			struct stats_group *group = &groupings[i].groups[j];
+			free(group->name);
+			for (v = 0; v < STATS_VAR_NUM; v++)
+				free(group->var[v].values);
+		}
+		free(groupings[i].groups);
+		groupings[i].groups = NULL;
+		groupings[i].nr = 0;
+	}
+}
+
+int stats_aggregate_avg(const struct stats_aggregate *aggregate)
+{
+	return aggregate->count ? lrint((double)aggregate->sum / aggregate->count) : 0;
+}
+
+/* Nearest-rank percentile, e.g. percent = 50 gives the median */
+int stats_aggregate_percentile(const struct stats_aggregate *aggregate, int percent)
+{
+	int idx;
+
+	if (!aggregate->count)
+		return 0;
+	idx = (percent * aggregate->count + 99) / 100 - 1;
+	if (idx < 0)
+		idx = 0;
+	if (idx >= aggregate->count)
+		idx = aggregate->count - 1;
+	return aggregate->values[idx];
+}
+
 #define SOME_GAS 5000 // 5bar drop in cylinder pressure makes cylinder used
 
 bool has_gaschange_event(const struct dive *dive, const struct divecomputer *dc, int idx)
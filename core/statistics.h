@@ -53,6 +53,56 @@ struct stats_summary {
 	stats_t *stats_by_temp;
 };
 
+/*
+ * Statistics grouped by arbitrary keys. A dive can belong to more than one
+ * group of a grouping, e.g. if it has more than one buddy or tag. Dives
+ * without a key, e.g. without dive site, are not part of any group.
+ */
+enum stats_group_by {
+	STATS_BY_SITE,
+	STATS_BY_BUDDY,		/* buddies and divemasters */
+	STATS_BY_TAG,
+	STATS_BY_SUIT,
+	STATS_BY_CYLINDER_TYPE,
+	STATS_BY_GASMIX,
+	STATS_BY_DIVE_COMPUTER,
+	STATS_BY_HOUR,		/* hour of the day the dive started */
+	STATS_BY_NUM
+};
+
+/* The values that are aggregated for each group */
+enum stats_variable {
+	STATS_VAR_DURATION,	/* seconds */
+	STATS_VAR_MAX_DEPTH,	/* mm */
+	STATS_VAR_MEAN_DEPTH,	/* mm */
+	STATS_VAR_SAC,		/* ml/min */
+	STATS_VAR_WATER_TEMP,	/* mkelvin */
+	STATS_VAR_OTU,
+	STATS_VAR_CNS,		/* % */
+	STATS_VAR_RATING,
+	STATS_VAR_NUM
+};
+
+/* Zero values are considered unknown and are not part of the aggregate */
+struct stats_aggregate {
+	int count;
+	int64_t sum;
+	int min, max;
+	int *values;		/* all values in ascending order, for percentiles */
+};
+
+struct stats_group {
+	char *name;
+	int dive_count;
+	struct stats_aggregate var[STATS_VAR_NUM];
+};
+
+struct stats_grouping {
+	enum stats_group_by by;
+	int nr;
+	struct stats_group *groups;	/* sorted by name */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -62,6 +112,10 @@ extern void init_stats_summary(struct stats_summary *stats);
 extern void free_stats_summary(struct stats_summary *stats);
 extern void calculate_stats_summary(struct stats_summary *stats, bool selected_only);
 extern void calculate_stats_selected(stats_t *stats_selection);
+extern void calculate_stats_groups(struct stats_grouping *out, const enum stats_group_by *by, int nr, bool selected_only);
+extern void free_stats_groups(struct stats_grouping *groupings, int nr);
+extern int stats_aggregate_avg(const struct stats_aggregate *aggregate);
+extern int stats_aggregate_percentile(const struct stats_aggregate *aggregate, int percent);
 extern void get_gas_used(struct dive *dive, volume_t gases[MAX_CYLINDERS]);
 extern void selected_dives_gas_parts(volume_t *o2_tot, volume_t *he_tot);
 
@@ -0,0 +1,422 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "core/statisticscache.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divesummary.h"
+#include "core/gettext.h"
+#include "core/trip.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+
+StatisticsCache *StatisticsCache::instance()
+{
+	static StatisticsCache self;
+	return &self;
+}
+
+StatisticsCache::StatisticsCache() : valid(false)
+{
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &StatisticsCache::divesAdded);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &StatisticsCache::divesDeleted);
+	connect(&diveListNotifier, &DiveListNotifier::divesMovedBetweenTrips, this, &StatisticsCache::divesMovedBetweenTrips);
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &StatisticsCache::divesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &StatisticsCache::divesTimeChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &StatisticsCache::cylindersReset);
+	invalidate();
+}
+
+void StatisticsCache::Bucket::addExtrema(const DiveValues *v)
+{
+	// Zero durations, depths and temperatures are treated as unknown
+	if (v->duration > longest_time)
+		longest_time = v->duration;
+	if (v->duration && (!shortest_time || v->duration < shortest_time))
+		shortest_time = v->duration;
+	if (v->maxdepth > max_depth)
+		max_depth = v->maxdepth;
+	if (v->maxdepth && (!min_depth || v->maxdepth < min_depth))
+		min_depth = v->maxdepth;
+	if (v->maxtemp && (!max_temp || v->maxtemp > max_temp))
+		max_temp = v->maxtemp;
+	if (v->mintemp && (!min_temp || v->mintemp < min_temp))
+		min_temp = v->mintemp;
+	/* less than .1 l/min is bogus, even with a pSCR */
+	if (v->duration && v->sac > 100) {
+		if (v->sac > max_sac)
+			max_sac = v->sac;
+		if (!min_sac || v->sac < min_sac)
+			min_sac = v->sac;
+	}
+}
+
+void StatisticsCache::Bucket::add(DiveValues *v)
+{
+	v->pos[kind] = (int)dives.size();
+	dives.push_back(v);
+	total_time += v->duration;
+	combined_max_depth += v->maxdepth;
+	if (v->mintemp || v->maxtemp) {
+		combined_temp += v->mintemp ? (v->mintemp + v->maxtemp) / 2 : v->maxtemp;
+		combined_count++;
+	}
+	if (v->duration && v->meandepth) {
+		total_average_depth_time += v->duration;
+		depth_time += (int64_t)v->duration * v->meandepth;
+	}
+	if (v->duration && v->sac > 100) {
+		total_sac_time += v->duration;
+		sac_time += (int64_t)v->duration * v->sac;
+	}
+	if (extremaValid)
+		addExtrema(v);
+}
+
+// The dive knows its position in the bucket. Move the last dive into its
+// place, so that removing is O(1) even for the buckets holding all dives.
+void StatisticsCache::Bucket::remove(DiveValues *v)
+{
+	int pos = v->pos[kind];
+	if (pos < 0 || pos >= (int)dives.size() || dives[pos] != v)
+		return;
+	dives[pos] = dives.back();
+	dives[pos]->pos[kind] = pos;
+	dives.pop_back();
+	v->pos[kind] = -1;
+
+	total_time -= v->duration;
+	combined_max_depth -= v->maxdepth;
+	if (v->mintemp || v->maxtemp) {
+		combined_temp -= v->mintemp ? (v->mintemp + v->maxtemp) / 2 : v->maxtemp;
+		combined_count--;
+	}
+	if (v->duration && v->meandepth) {
+		total_average_depth_time -= v->duration;
+		depth_time -= (int64_t)v->duration * v->meandepth;
+	}
+	if (v->duration && v->sac > 100) {
+		total_sac_time -= v->duration;
+		sac_time -= (int64_t)v->duration * v->sac;
+	}
+
+	// Only if the removed dive may have held one of the extreme values,
+	// these have to be recalculated.
+	if (extremaValid &&
+	    (v->duration == shortest_time || v->duration == longest_time ||
+	     v->maxdepth == min_depth || v->maxdepth == max_depth ||
+	     (v->mintemp && v->mintemp == min_temp) || (v->maxtemp && v->maxtemp == max_temp) ||
+	     (v->duration && v->sac > 100 && (v->sac == min_sac || v->sac == max_sac))))
+		extremaValid = false;
+}
+
+void StatisticsCache::Bucket::fill(stats_t *stats)
+{
+	if (!extremaValid) {
+		shortest_time = longest_time = 0;
+		min_depth = max_depth = 0;
+		min_sac = max_sac = 0;
+		min_temp = max_temp = 0;
+		for (const DiveValues *v: dives)
+			addExtrema(v);
+		extremaValid = true;
+	}
+
+	stats->selection_size = dives.size();
+	stats->total_time.seconds = total_time;
+	stats->total_average_depth_time.seconds = total_average_depth_time;
+	stats->shortest_time.seconds = shortest_time;
+	stats->longest_time.seconds = longest_time;
+	stats->max_depth.mm = max_depth;
+	stats->min_depth.mm = min_depth;
+	stats->avg_depth.mm = total_average_depth_time ? lrint((double)depth_time / total_average_depth_time) : 0;
+	stats->combined_max_depth.mm = combined_max_depth;
+	stats->max_sac.mliter = max_sac;
+	stats->min_sac.mliter = min_sac;
+	stats->avg_sac.mliter = total_sac_time ? lrint((double)sac_time / total_sac_time) : 0;
+	stats->total_sac_time.seconds = total_sac_time;
+	stats->max_temp.mkelvin = max_temp;
+	stats->min_temp.mkelvin = min_temp;
+	stats->combined_temp.mkelvin = combined_temp;
+	stats->combined_count = combined_count;
+}
+
+void StatisticsCache::addToBuckets(DiveValues *v)
+{
+	all.add(v);
+	if (v->type_idx >= 0)
+		byType[v->type_idx].add(v);
+	byDepth[v->depth_idx].add(v);
+	byTemp[v->temp_idx].add(v);
+	byYear.emplace(v->year, Bucket(BucketYear)).first->second.add(v);
+	byMonth.emplace(std::make_pair(v->year, v->month), Bucket(BucketMonth)).first->second.add(v);
+	if (v->trip) {
+		allTrips.add(v);
+		byTrip.emplace(v->trip, Bucket(BucketTrip)).first->second.add(v);
+	}
+}
+
+// Remove a dive from a bucket of a map and remove the bucket if it became empty.
+template <typename Map, typename Key, typename Value>
+static void removeFromMap(Map &map, const Key &key, Value *v)
+{
+	auto it = map.find(key);
+	if (it == map.end())
+		return;
+	it->second.remove(v);
+	if (it->second.dives.empty())
+		map.erase(it);
+}
+
+void StatisticsCache::removeFromBuckets(DiveValues *v)
+{
+	all.remove(v);
+	if (v->type_idx >= 0)
+		byType[v->type_idx].remove(v);
+	byDepth[v->depth_idx].remove(v);
+	byTemp[v->temp_idx].remove(v);
+	removeFromMap(byYear, v->year, v);
+	removeFromMap(byMonth, std::make_pair(v->year, v->month), v);
+	if (v->trip) {
+		allTrips.remove(v);
+		removeFromMap(byTrip, v->trip, v);
+	}
+}
+
+// The arguments come either from the dive or from the columns of the dive summary table
+StatisticsCache::DiveValues StatisticsCache::makeValues(int duration, int maxdepth, int meandepth, int sac,
+							uint32_t mintemp, uint32_t maxtemp, int divemode,
+							timestamp_t when, const dive_trip *trip)
+{
+	struct tm tm;
+	DiveValues v;
+
+	v.duration = duration;
+	v.maxdepth = maxdepth;
+	v.meandepth = meandepth;
+	v.sac = sac;
+	v.mintemp = mintemp;
+	v.maxtemp = maxtemp;
+	v.type_idx = divemode >= 0 && divemode < NUM_DIVEMODE ? divemode : -1;
+	v.depth_idx = std::max(0, std::min(maxdepth / (STATS_DEPTH_BUCKET * 1000), STATS_MAX_DEPTH / STATS_DEPTH_BUCKET - 1));
+	v.temp_idx = std::max(0, std::min((int)mkelvin_to_C(mintemp) / STATS_TEMP_BUCKET, STATS_MAX_TEMP / STATS_TEMP_BUCKET - 1));
+	utc_mkdate(when, &tm);
+	v.year = tm.tm_year;
+	v.month = tm.tm_mon + 1;
+	v.trip = trip;
+	return v;
+}
+
+void StatisticsCache::addValues(const struct dive *d, const DiveValues &v)
+{
+	if (values.count(d))
+		removeDive(d);
+
+	// The elements of an unordered_map don't move, so the buckets can refer to them
+	DiveValues *stored = &(values[d] = v);
+	addToBuckets(stored);
+}
+
+void StatisticsCache::addDive(const struct dive *d)
+{
+	addValues(d, makeValues(d->duration.seconds, d->maxdepth.mm, d->meandepth.mm, d->sac,
+				d->mintemp.mkelvin, d->maxtemp.mkelvin, d->dc.divemode, d->when, d->divetrip));
+}
+
+void StatisticsCache::removeDive(const struct dive *d)
+{
+	auto it = values.find(d);
+	if (it == values.end())
+		return;
+	removeFromBuckets(&it->second);
+	values.erase(it);
+}
+
+void StatisticsCache::updateDive(const struct dive *d)
+{
+	removeDive(d);
+	addDive(d);
+}
+
+void StatisticsCache::reload()
+{
+	// Read the values from the columns instead of the dives
+	DiveSummaryTable *t = DiveSummaryTable::instance();
+	t->update();
+
+	invalidate();
+	values.reserve(t->size());
+	for (int i = 0; i < t->size(); ++i) {
+		addValues(t->dives[i], makeValues(t->duration[i], t->maxdepth[i], t->meandepth[i], t->sac[i],
+						  t->mintemp[i], t->maxtemp[i], t->divemode[i], t->when[i], t->trip[i]));
+	}
+	valid = true;
+}
+
+void StatisticsCache::invalidate()
+{
+	valid = false;
+	values.clear();
+	all = Bucket(BucketAll);
+	allTrips = Bucket(BucketAllTrips);
+	for (Bucket &b: byType)
+		b = Bucket(BucketType);
+	for (Bucket &b: byDepth)
+		b = Bucket(BucketDepth);
+	for (Bucket &b: byTemp)
+		b = Bucket(BucketTemp);
+	byYear.clear();
+	byMonth.clear();
+	byTrip.clear();
+}
+
+void StatisticsCache::calculateSummary(struct stats_summary *out, bool selected_only)
+{
+	if (selected_only) {
+		calculate_stats_summary(out, true);
+		return;
+	}
+
+	// Dives may have been loaded or cleared without notification
+	if (!valid || values.size() != (size_t)dive_table.nr)
+		reload();
+
+	const int numDepth = STATS_MAX_DEPTH / STATS_DEPTH_BUCKET;
+	const int numTemp = STATS_MAX_TEMP / STATS_TEMP_BUCKET;
+
+	// Allocate the arrays with a zeroed terminating entry each
+	size_t size = sizeof(stats_t) * (byYear.size() + 1);
+	size_t msize = sizeof(stats_t) * (byMonth.size() + 1);
+	size_t trsize = sizeof(stats_t) * (byTrip.size() + 2);
+	size_t tsize = sizeof(stats_t) * (NUM_DIVEMODE + 1);
+	size_t dsize = sizeof(stats_t) * (numDepth + 2);
+	size_t tmsize = sizeof(stats_t) * (numTemp + 2);
+	free_stats_summary(out);
+	out->stats_yearly = (stats_t *)calloc(1, size);
+	out->stats_monthly = (stats_t *)calloc(1, msize);
+	out->stats_by_trip = (stats_t *)calloc(1, trsize);
+	out->stats_by_type = (stats_t *)calloc(1, tsize);
+	out->stats_by_depth = (stats_t *)calloc(1, dsize);
+	out->stats_by_temp = (stats_t *)calloc(1, tmsize);
+	if (!out->stats_yearly || !out->stats_monthly || !out->stats_by_trip ||
+	    !out->stats_by_type || !out->stats_by_depth || !out->stats_by_temp)
+		return;
+
+	// The maps are sorted chronologically
+	int i = 0;
+	for (auto &year: byYear) {
+		stats_t *s = &out->stats_yearly[i++];
+		year.second.fill(s);
+		s->period = year.first;
+		s->is_year = true;
+	}
+	i = 0;
+	for (auto &month: byMonth) {
+		stats_t *s = &out->stats_monthly[i++];
+		month.second.fill(s);
+		s->period = month.first.second;
+	}
+
+	// Trips are sorted by their first dive, as in the dive table
+	if (!byTrip.empty()) {
+		std::vector<std::pair<timestamp_t, const dive_trip *>> trips;
+		for (auto &trip: byTrip)
+			trips.push_back(std::make_pair(trip_date(trip.first), trip.first));
+		std::sort(trips.begin(), trips.end());
+		allTrips.fill(&out->stats_by_trip[0]);
+		out->stats_by_trip[0].is_trip = true;
+		out->stats_by_trip[0].location = (char *)translate("gettextFromC", "All (by trip stats)");
+		i = 1;
+		for (auto &trip: trips) {
+			stats_t *s = &out->stats_by_trip[i++];
+			byTrip[trip.second].fill(s);
+			s->is_trip = true;
+			s->location = trip.second->location;
+		}
+	}
+
+	// Setting the is_trip to true to show the location as first
+	// field in the statistics window
+	all.fill(&out->stats_by_type[0]);
+	out->stats_by_type[0].location = (char *)translate("gettextFromC", "All (by type stats)");
+	out->stats_by_type[0].is_trip = true;
+	for (i = 0; i < NUM_DIVEMODE; ++i) {
+		byType[i].fill(&out->stats_by_type[i + 1]);
+		out->stats_by_type[i + 1].location = (char *)translate("gettextFromC", divemode_text_ui[i]);
+		out->stats_by_type[i + 1].is_trip = true;
+	}
+
+	all.fill(&out->stats_by_depth[0]);
+	out->stats_by_depth[0].location = (char *)translate("gettextFromC", "All (by max depth stats)");
+	out->stats_by_depth[0].is_trip = true;
+	for (i = 0; i < numDepth; ++i)
+		byDepth[i].fill(&out->stats_by_depth[i + 1]);
+
+	all.fill(&out->stats_by_temp[0]);
+	out->stats_by_temp[0].location = (char *)translate("gettextFromC", "All (by min. temp stats)");
+	out->stats_by_temp[0].is_trip = true;
+	for (i = 0; i < numTemp; ++i)
+		byTemp[i].fill(&out->stats_by_temp[i + 1]);
+
+	// add labels for depth ranges up to maximum depth seen
+	if (!all.dives.empty()) {
+		int max_depth = std::min(out->stats_by_depth[0].max_depth.mm, STATS_MAX_DEPTH * 1000);
+		for (i = 0; i * (STATS_DEPTH_BUCKET * 1000) < max_depth; ++i)
+			out->stats_by_depth[i + 1].is_trip = true;
+
+		int max_temp = std::min((int)mkelvin_to_C(out->stats_by_temp[0].max_temp.mkelvin), STATS_MAX_TEMP);
+		for (i = 0; i * STATS_TEMP_BUCKET < max_temp; ++i)
+			out->stats_by_temp[i + 1].is_trip = true;
+	}
+}
+
+void StatisticsCache::divesAdded(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	if (!valid)
+		return;
+	for (dive *d: dives)
+		addDive(d);
+}
+
+void StatisticsCache::divesDeleted(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	if (!valid)
+		return;
+	for (dive *d: dives)
+		removeDive(d);
+}
+
+void StatisticsCache::divesMovedBetweenTrips(dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives)
+{
+	if (!valid)
+		return;
+	for (dive *d: dives)
+		updateDive(d);
+}
+
+void StatisticsCache::divesChanged(const QVector<dive *> &dives, DiveField)
+{
+	// Many fields, e.g. the mode or the water temperature, influence the
+	// statistics. Updating a dive is cheap, so don't bother checking.
+	if (!valid)
+		return;
+	for (dive *d: dives)
+		updateDive(d);
+}
+
+void StatisticsCache::divesTimeChanged(timestamp_t, const QVector<dive *> &dives)
+{
+	if (!valid)
+		return;
+	for (dive *d: dives)
+		updateDive(d);
+}
+
+void StatisticsCache::cylindersReset(const QVector<dive *> &dives)
+{
+	// The SAC rate depends on the cylinders
+	if (!valid)
+		return;
+	for (dive *d: dives)
+		updateDive(d);
+}
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0
+// Incrementally maintained statistics of all dives.
+//
+// calculate_stats_summary() loops over the whole dive table. This class
+// keeps the aggregates of the yearly, monthly, by-trip, by-type, by-depth
+// and by-temperature buckets up to date by applying the changes announced by
+// the DiveListNotifier. Adding, removing or editing a dive only touches the
+// buckets the dive belongs to.
+#ifndef STATISTICSCACHE_H
+#define STATISTICSCACHE_H
+
+#include "core/statistics.h"
+#include "core/subsurface-qt/DiveListNotifier.h"
+
+#include <QObject>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+class StatisticsCache : public QObject {
+	Q_OBJECT
+public:
+	static StatisticsCache *instance();
+
+	// Fill out the summary in the same format as calculate_stats_summary().
+	// For statistics of the selected dives, this simply calls calculate_stats_summary().
+	void calculateSummary(struct stats_summary *out, bool selected_only);
+
+	// Drop the cached data. It will be recalculated on next access.
+	void invalidate();
+
+private
+slots:
+	void divesAdded(dive_trip *trip, bool addTrip, const QVector<dive *> &dives);
+	void divesDeleted(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
+	void divesMovedBetweenTrips(dive_trip *from, dive_trip *to, bool deleteFrom, bool createTo, const QVector<dive *> &dives);
+	void divesChanged(const QVector<dive *> &dives, DiveField field);
+	void divesTimeChanged(timestamp_t delta, const QVector<dive *> &dives);
+	void cylindersReset(const QVector<dive *> &dives);
+
+private:
+	StatisticsCache();
+
+	// The buckets a dive belongs to. A dive is in at most one bucket of each kind.
+	enum BucketKind {
+		BucketAll,
+		BucketType,
+		BucketDepth,
+		BucketTemp,
+		BucketYear,
+		BucketMonth,
+		BucketAllTrips,
+		BucketTrip,
+		NumBucketKinds
+	};
+
+	// The values of a dive that enter the statistics. They are kept,
+	// so that the contribution of a dive can be removed after it was edited.
+	struct DiveValues {
+		int duration;
+		int maxdepth;
+		int meandepth;
+		int sac;
+		uint32_t mintemp, maxtemp;
+		int type_idx, depth_idx, temp_idx;
+		int year, month;
+		const dive_trip *trip;
+		int pos[NumBucketKinds];	// index of the dive in the bucket of each kind
+	};
+
+	// The sums are kept exactly, the averages are calculated when the
+	// summary is filled out. The extreme values are updated when dives
+	// are added. If a dive holding an extreme value is removed, they are
+	// recalculated from the dives of this bucket only.
+	struct Bucket {
+		BucketKind kind;
+		std::vector<DiveValues *> dives;
+		int64_t total_time = 0;
+		int64_t total_average_depth_time = 0;
+		int64_t depth_time = 0;
+		int64_t total_sac_time = 0;
+		int64_t sac_time = 0;
+		int64_t combined_max_depth = 0;
+		uint64_t combined_temp = 0;
+		unsigned int combined_count = 0;
+
+		bool extremaValid = true;
+		int shortest_time = 0, longest_time = 0;
+		int min_depth = 0, max_depth = 0;
+		int min_sac = 0, max_sac = 0;
+		uint32_t min_temp = 0, max_temp = 0;
+
+		explicit Bucket(BucketKind kind = BucketAll) : kind(kind) { }
+		void add(DiveValues *v);
+		void remove(DiveValues *v);
+		void addExtrema(const DiveValues *v);
+		void fill(stats_t *stats);
+	};
+
+	static DiveValues makeValues(int duration, int maxdepth, int meandepth, int sac,
+				     uint32_t mintemp, uint32_t maxtemp, int divemode,
+				     timestamp_t when, const dive_trip *trip);
+	void reload();
+	void addValues(const struct dive *d, const DiveValues &v);
+	void addDive(const struct dive *d);
+	void removeDive(const struct dive *d);
+	void updateDive(const struct dive *d);
+	void addToBuckets(DiveValues *v);
+	void removeFromBuckets(DiveValues *v);
+
+	bool valid;
+	std::unordered_map<const struct dive *, DiveValues> values;
+	Bucket all, allTrips;
+	Bucket byType[NUM_DIVEMODE];
+	Bucket byDepth[STATS_MAX_DEPTH / STATS_DEPTH_BUCKET];
+	Bucket byTemp[STATS_MAX_TEMP / STATS_TEMP_BUCKET];
+	std::map<int, Bucket> byYear;
+	std::map<std::pair<int, int>, Bucket> byMonth;
+	std::map<const dive_trip *, Bucket> byTrip;
+};
+
+#endif
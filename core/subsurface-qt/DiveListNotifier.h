@@ -67,6 +67,9 @@ signals:
 	// This is necessary, so that the user can't click on the "undo" button and undo
 	// an unrelated command.
 	void commandExecuted();
+
+	// Sent when the outermost batch (see startBatch() below) is finished.
+	void batchFinished();
 public:
 	// Desktop uses the QTreeView class to present the list of dives. The layout
 	// of this class gives us a very fundamental problem, as we can not easily
@@ -97,9 +100,37 @@ public:
 	// 	... do work ...
 	// }
 	InCommandMarker enterCommand();
+
+	// Commands that add, remove or reorder many dives at once can start
+	// a batch. During a batch the signals are sent as usual, but the dive
+	// list models don't apply them one by one. Instead, they reload once
+	// when the batch is finished. For small changes this is not worth it
+	// and would lose the state of the views (e.g. expanded trips). Therefore,
+	// a batch is only started if at least minBatchSize dives are affected.
+	static const int minBatchSize = 100;
+	class BatchMarker {
+		DiveListNotifier *notifier;	// null if no batch was started
+		BatchMarker(DiveListNotifier *);
+		friend DiveListNotifier;
+	public:
+		BatchMarker(BatchMarker &&);
+		BatchMarker(const BatchMarker &) = delete;
+		~BatchMarker();
+	};
+
+	// Usage:
+	// {
+	// 	auto batch = diveListNotifier.startBatch(dives.size());
+	// 	... add or remove dives ...
+	// } // batchFinished() is sent here
+	// ... set selection ...
+	BatchMarker startBatch(int numDives);
+	bool inBatch() const;
 private:
 	friend InCommandMarker;
+	friend BatchMarker;
 	bool commandExecuting;
+	int batchDepth = 0;
 };
 
 // The DiveListNotifier class has only trivial state.
@@ -129,4 +160,31 @@ inline DiveListNotifier::InCommandMarker DiveListNotifier::enterCommand()
 	return InCommandMarker(*this);
 }
 
+inline DiveListNotifier::BatchMarker::BatchMarker(DiveListNotifier *notifierIn) : notifier(notifierIn)
+{
+	if (notifier)
+		++notifier->batchDepth;
+}
+
+inline DiveListNotifier::BatchMarker::BatchMarker(BatchMarker &&other) : notifier(other.notifier)
+{
+	other.notifier = nullptr;
+}
+
+inline DiveListNotifier::BatchMarker::~BatchMarker()
+{
+	if (notifier && --notifier->batchDepth == 0)
+		emit notifier->batchFinished();
+}
+
+inline DiveListNotifier::BatchMarker DiveListNotifier::startBatch(int numDives)
+{
+	return BatchMarker(numDives >= minBatchSize ? this : nullptr);
+}
+
+inline bool DiveListNotifier::inBatch() const
+{
+	return batchDepth > 0;
+}
+
 #endif
@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "core/thumbnailpack.h"
+#include "core/pref.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QSaveFile>
+#include <QtEndian>
+#include <string.h>
+
+// The format of the pack:
+//	char[8]	magic
+//	uint32	version
+//	for each record:
+//		uint32	size of payload
+//		char[20] SHA-1 of the picture filename
+//		int64	creation time in ms since the epoch
+//		uint32	media type
+//		int32	duration of video in seconds
+//		char[]	payload
+// All numbers are big-endian, as written by QDataStream.
+static const char packMagic[8] = { 'S', 'S', 'R', 'F', 'T', 'H', 'M', 'B' };
+static const quint32 packVersion = 1;
+static const int packHeaderSize = 12;
+static const int hashSize = 20;
+static const int recordHeaderSize = 40;
+
+// Compact if the garbage is larger than this and makes up more than half of the file
+static const qint64 minGarbageForCompaction = 1024 * 1024;
+
+ThumbnailPack *ThumbnailPack::instance()
+{
+	static ThumbnailPack self(QString(system_default_directory()) + "/thumbnails.pack");
+	return &self;
+}
+
+ThumbnailPack::ThumbnailPack(const QString &filenameIn) : filename(filenameIn),
+	mapped(nullptr),
+	mappedSize(0),
+	size(0),
+	garbage(0)
+{
+	open();
+	compactIfNeeded();
+}
+
+ThumbnailPack::~ThumbnailPack()
+{
+	close();
+}
+
+QByteArray ThumbnailPack::hash(const QString &pictureFilename)
+{
+	return QCryptographicHash::hash(pictureFilename.toUtf8(), QCryptographicHash::Sha1);
+}
+
+void ThumbnailPack::open()
+{
+	file.setFileName(filename);
+	if (!file.open(QIODevice::ReadWrite)) {
+		qWarning() << "Cannot open thumbnail pack" << filename;
+		return;
+	}
+
+	// Start a new pack if this is not a pack we understand
+	QByteArray header = file.read(packHeaderSize);
+	if (header.size() < packHeaderSize || memcmp(header.constData(), packMagic, sizeof(packMagic)) ||
+	    qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.constData()) + sizeof(packMagic)) != packVersion) {
+		file.resize(0);
+		file.seek(0);
+		QDataStream stream(&file);
+		stream.writeRawData(packMagic, sizeof(packMagic));
+		stream << packVersion;
+		file.flush();
+	}
+	readIndex();
+}
+
+void ThumbnailPack::close()
+{
+	if (mapped)
+		file.unmap(mapped);
+	mapped = nullptr;
+	mappedSize = 0;
+	file.close();
+	index.clear();
+	size = garbage = 0;
+}
+
+bool ThumbnailPack::map(qint64 needed)
+{
+	if (mapped && mappedSize >= needed)
+		return true;
+	if (mapped)
+		file.unmap(mapped);
+	mappedSize = file.size();
+	mapped = mappedSize >= needed ? file.map(0, mappedSize) : nullptr;
+	if (!mapped)
+		mappedSize = 0;
+	return mapped != nullptr;
+}
+
+void ThumbnailPack::readIndex()
+{
+	index.clear();
+	garbage = 0;
+	size = packHeaderSize;
+
+	qint64 fileSize = file.size();
+	if (fileSize > packHeaderSize && !map(fileSize)) {
+		qWarning() << "Cannot map thumbnail pack" << filename;
+		fileSize = packHeaderSize;
+	}
+
+	// Walk the record headers. Stop at a truncated record, which may be
+	// the remains of an interrupted write.
+	while (size + recordHeaderSize <= fileSize) {
+		const uchar *p = mapped + size;
+		Entry entry;
+		entry.size = qFromBigEndian<quint32>(p);
+		entry.offset = size + recordHeaderSize;
+		if (entry.offset + entry.size > fileSize)
+			break;
+		QByteArray key(reinterpret_cast<const char *>(p + 4), hashSize);
+		entry.created = qFromBigEndian<qint64>(p + 24);
+		entry.type = qFromBigEndian<quint32>(p + 32);
+		entry.duration = qFromBigEndian<qint32>(p + 36);
+
+		auto it = index.find(key);
+		if (it != index.end()) {
+			garbage += recordHeaderSize + it->size;
+			*it = entry;
+		} else {
+			index.insert(key, entry);
+		}
+		size = entry.offset + entry.size;
+	}
+
+	if (size < file.size()) {
+		qWarning() << "Dropping truncated record in thumbnail pack" << filename;
+		if (mapped)
+			file.unmap(mapped);
+		mapped = nullptr;
+		mappedSize = 0;
+		file.resize(size);
+	}
+}
+
+bool ThumbnailPack::get(const QString &pictureFilename, Entry &entry, QByteArray &data)
+{
+	QMutexLocker l(&lock);
+	auto it = index.find(hash(pictureFilename));
+	if (it == index.end())
+		return false;
+	entry = *it;
+
+	// Copy the payload, since the mapping may change once the lock is released.
+	if (map(entry.offset + entry.size)) {
+		data = QByteArray(reinterpret_cast<const char *>(mapped) + entry.offset, entry.size);
+	} else {
+		file.seek(entry.offset);
+		data = file.read(entry.size);
+	}
+	return data.size() == (int)entry.size;
+}
+
+void ThumbnailPack::put(const QString &pictureFilename, quint32 type, qint32 duration, const QByteArray &data)
+{
+	QByteArray key = hash(pictureFilename);
+	Entry entry { 0, (quint32)data.size(), QDateTime::currentMSecsSinceEpoch(), type, duration };
+
+	// Write the record in one go, so that an interrupted write leaves
+	// at most one truncated record at the end of the file.
+	QByteArray record;
+	record.reserve(recordHeaderSize + data.size());
+	QDataStream stream(&record, QIODevice::WriteOnly);
+	stream << entry.size;
+	stream.writeRawData(key.constData(), hashSize);
+	stream << entry.created << entry.type << entry.duration;
+	stream.writeRawData(data.constData(), data.size());
+
+	QMutexLocker l(&lock);
+	if (!file.isOpen())
+		return;
+	if (!file.seek(size) || file.write(record) != record.size() || !file.flush()) {
+		qWarning() << "Cannot write to thumbnail pack" << filename;
+		file.resize(size);
+		return;
+	}
+
+	entry.offset = size + recordHeaderSize;
+	size += record.size();
+	auto it = index.find(key);
+	if (it != index.end()) {
+		garbage += recordHeaderSize + it->size;
+		*it = entry;
+	} else {
+		index.insert(key, entry);
+	}
+	compactIfNeeded();
+}
+
+void ThumbnailPack::compactIfNeeded()
+{
+	if (garbage > minGarbageForCompaction && garbage * 2 > size)
+		compactLocked();
+}
+
+void ThumbnailPack::compact()
+{
+	QMutexLocker l(&lock);
+	compactLocked();
+}
+
+void ThumbnailPack::compactLocked()
+{
+	if (!file.isOpen() || !map(size))
+		return;
+
+	QSaveFile out(filename);
+	if (!out.open(QIODevice::WriteOnly)) {
+		qWarning() << "Cannot compact thumbnail pack" << filename;
+		return;
+	}
+	QDataStream stream(&out);
+	stream.writeRawData(packMagic, sizeof(packMagic));
+	stream << packVersion;
+	for (auto it = index.cbegin(); it != index.cend(); ++it) {
+		const Entry &entry = it.value();
+		stream << entry.size;
+		stream.writeRawData(it.key().constData(), hashSize);
+		stream << entry.created << entry.type << entry.duration;
+		stream.writeRawData(reinterpret_cast<const char *>(mapped) + entry.offset, entry.size);
+	}
+	if (stream.status() != QDataStream::Ok) {
+		out.cancelWriting();
+		return;
+	}
+
+	// The old file has to be closed before it can be replaced.
+	close();
+	if (!out.commit())
+		qWarning() << "Cannot replace thumbnail pack" << filename;
+	open();
+}
+
+int ThumbnailPack::count() const
+{
+	QMutexLocker l(&lock);
+	return index.size();
+}
+
+qint64 ThumbnailPack::garbageSize() const
+{
+	QMutexLocker l(&lock);
+	return garbage;
+}
+
+qint64 ThumbnailPack::fileSize() const
+{
+	QMutexLocker l(&lock);
+	return size;
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0
+// A single file containing all thumbnails.
+//
+// Storing every thumbnail in its own file means thousands of small files
+// and an open() plus stat() for every thumbnail that is shown. Instead,
+// the thumbnails are appended to one pack file, which is mapped into
+// memory. An index from the hash of the picture filename to the position
+// of the thumbnail in the pack is kept in memory. It is built by walking
+// the record headers when the pack is opened.
+//
+// Replacing a thumbnail appends a new record and leaves the old one as
+// garbage. The pack is compacted when the garbage grows too large.
+//
+// The payload of a record is the serialized thumbnail in the format of
+// the old single thumbnail files. The media type and the duration of
+// videos are copied into the record header, so that they are known
+// without decoding the payload.
+#ifndef THUMBNAILPACK_H
+#define THUMBNAILPACK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+class ThumbnailPack {
+public:
+	struct Entry {
+		qint64 offset;		// position of the payload in the file
+		quint32 size;		// size of the payload
+		qint64 created;		// time the thumbnail was written in ms since the epoch
+		quint32 type;		// mediatype_t
+		qint32 duration;	// length of videos in seconds
+	};
+
+	// The pack in the subsurface directory
+	static ThumbnailPack *instance();
+
+	explicit ThumbnailPack(const QString &filename);
+	~ThumbnailPack();
+
+	// Look up the thumbnail of a picture. If found, fill out the entry,
+	// copy the payload into data and return true.
+	bool get(const QString &pictureFilename, Entry &entry, QByteArray &data);
+
+	// Add or replace the thumbnail of a picture.
+	void put(const QString &pictureFilename, quint32 type, qint32 duration, const QByteArray &data);
+
+	// Rewrite the pack, keeping only the current thumbnails.
+	void compact();
+
+	int count() const;
+	qint64 garbageSize() const;
+	qint64 fileSize() const;
+
+private:
+	static QByteArray hash(const QString &pictureFilename);
+	void open();
+	void close();
+	void readIndex();
+	bool map(qint64 size);
+	void compactIfNeeded();
+	void compactLocked();
+
+	mutable QMutex lock;
+	QString filename;
+	QFile file;
+	uchar *mapped;			// null if not mapped
+	qint64 mappedSize;
+	qint64 size;			// size of the valid part of the file
+	qint64 garbage;			// size of the superseded records
+	QHash<QByteArray, Entry> index;
+};
+
+#endif
@@ -5,7 +5,9 @@
 #include "core/dive.h"		// for report_error()!
 
 #include <QtConcurrent>
+#include <QFile>
 #include <QProcess>
+#include <QTemporaryDir>
 
 // Note: this is a global instead of a function-local variable on purpose.
 // We don't want this to be generated in a different thread context if
@@ -16,11 +18,16 @@ VideoFrameExtractor *VideoFrameExtractor::instance()
 	return &frameExtractor;
 }
 
-VideoFrameExtractor::VideoFrameExtractor()
+// Number of ffmpeg processes that run at the same time
+static const int maxProcesses = 2;
+// Number of videos that are passed to a single ffmpeg process
+static const int batchSize = 16;
+// Time that ffmpeg may take per video or, in batches, without writing a frame, in ms
+static const int perVideoTimeout = 30000;
+
+VideoFrameExtractor::VideoFrameExtractor() : runningBatches(0), extractedFrames(0)
 {
-	// Currently, we only process one video at a time.
-	// Eventually, we might want to increase this value.
-	pool.setMaxThreadCount(1);
+	pool.setMaxThreadCount(maxProcesses);
 }
 
 void VideoFrameExtractor::extract(QString originalFilename, QString filename, duration_t duration)
@@ -28,26 +35,52 @@ void VideoFrameExtractor::extract(QString originalFilename, QString filename, du
 	QMutexLocker l(&lock);
 	if (!workingOn.contains(originalFilename)) {
 		// We are not currently extracting this video - add it to the list.
-		workingOn.insert(originalFilename, QtConcurrent::run(&pool, [this, originalFilename, filename, duration]()
-				 { processItem(originalFilename, filename, duration); }));
+		workingOn.insert(originalFilename);
+		pending.enqueue({ originalFilename, filename, duration });
+		startBatches();
 	}
 }
 
-void VideoFrameExtractor::fail(const QString &originalFilename, duration_t duration, bool isInvalid)
+// Start ffmpeg processes for the pending videos, as long as there are free slots.
+// To fill all slots, the pending videos are distributed evenly over the free slots.
+// Call with the lock held.
+void VideoFrameExtractor::startBatches()
+{
+	if (runningBatches == 0 && extractedFrames == 0)
+		timer.start();
+	while (runningBatches < maxProcesses && !pending.isEmpty()) {
+		int freeSlots = maxProcesses - runningBatches;
+		int num = std::min((pending.size() + freeSlots - 1) / freeSlots, batchSize);
+		QVector<Item> items;
+		items.reserve(num);
+		for (int i = 0; i < num; ++i)
+			items.push_back(pending.dequeue());
+		++runningBatches;
+		QtConcurrent::run(&pool, [this, items]() { processBatch(items); });
+	}
+}
+
+void VideoFrameExtractor::finish(const Item &item)
+{
+	QMutexLocker l(&lock);
+	workingOn.remove(item.originalFilename);
+}
+
+void VideoFrameExtractor::fail(const Item &item, bool isInvalid)
 {
 	if (isInvalid)
-		emit invalid(originalFilename, duration);
+		emit invalid(item.originalFilename, item.duration);
 	else
-		emit failed(originalFilename, duration);
-	QMutexLocker l(&lock);
-	workingOn.remove(originalFilename);
+		emit failed(item.originalFilename, item.duration);
+	finish(item);
 }
 
 void VideoFrameExtractor::clearWorkQueue()
 {
+	// Running ffmpeg processes are not interrupted, but their results
+	// are sent anyway. That's not a problem, since they are cached.
 	QMutexLocker l(&lock);
-	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
-		it->cancel();
+	pending.clear();
 	workingOn.clear();
 }
 
@@ -58,17 +91,9 @@ T clamp(T v, T lo, T hi)
 	return v < lo ? lo : v > hi ? hi : v;
 }
 
-void VideoFrameExtractor::processItem(QString originalFilename, QString filename, duration_t duration)
+// Determine the time where we want to extract the image.
+static duration_t thumbnailPosition(duration_t duration)
 {
-	// If video frame extraction is turned off (e.g. because we failed to start ffmpeg),
-	// abort immediately.
-	if (!prefs.extract_video_thumbnails) {
-		QMutexLocker l(&lock);
-		workingOn.remove(originalFilename);
-		return;
-	}
-
-	// Determine the time where we want to extract the image.
 	// If the duration is < 10 sec, just snap the first frame
 	duration_t position = { 0 };
 	if (duration.seconds > 10) {
@@ -78,24 +103,142 @@ void VideoFrameExtractor::processItem(QString originalFilename, QString filename
 		position.seconds = clamp(duration.seconds * prefs.extract_video_thumbnails_position / 100,
 					 0, duration.seconds);
 	}
-	QString posString = QString("%1:%2:%3").arg(position.seconds / 3600, 2, 10, QChar('0'))
-					       .arg((position.seconds % 3600) / 60, 2, 10, QChar('0'))
-					       .arg(position.seconds % 60, 2, 10, QChar('0'));
+	return position;
+}
+
+static QString positionString(duration_t position)
+{
+	return QString("%1:%2:%3").arg(position.seconds / 3600, 2, 10, QChar('0'))
+				  .arg((position.seconds % 3600) / 60, 2, 10, QChar('0'))
+				  .arg(position.seconds % 60, 2, 10, QChar('0'));
+}
+
+// Returns false if ffmpeg could not be started. In that case, video
+// thumbnailing is turned off.
+bool VideoFrameExtractor::startFfmpeg(QProcess &ffmpeg, const QStringList &args)
+{
+	ffmpeg.start(prefs.ffmpeg_executable, args);
+	if (ffmpeg.waitForStarted())
+		return true;
+	// Since we couldn't sart ffmpeg, turn off thumbnailing
+	// TODO: call the proper preferences-functions
+	prefs.extract_video_thumbnails = false;
+	report_error(qPrintable(tr("ffmpeg failed to start - video thumbnail creation suspended. To enable video thumbnailing, set working executable in preferences.")));
+	return false;
+}
+
+void VideoFrameExtractor::processBatch(QVector<Item> items)
+{
+	// A batch may fail as a whole, e.g. because ffmpeg couldn't parse one of the
+	// videos. In that case, the videos without frame are retried one by one.
+	QVector<Item> remaining = items.size() > 1 ? extractBatch(items) : items;
+	for (const Item &item: remaining)
+		processItem(item);
+
+	QMutexLocker l(&lock);
+	--runningBatches;
+	startBatches();
+	if (runningBatches == 0 && extractedFrames > 0) {
+		if (verbose) {
+			double secs = timer.elapsed() / 1000.0;
+			qDebug() << "Extracted" << extractedFrames << "video frames in" << secs << "s:"
+				 << (secs > 0.0 ? extractedFrames / secs : 0.0) << "frames/s";
+		}
+		extractedFrames = 0;
+	}
+}
+
+// Extract the frames of multiple videos with a single ffmpeg process. Starting
+// ffmpeg takes much longer than extracting a single frame, so this is
+// considerably faster than running ffmpeg for every video.
+// Returns the videos for which no frame was extracted.
+QVector<VideoFrameExtractor::Item> VideoFrameExtractor::extractBatch(const QVector<Item> &items)
+{
+	if (!prefs.extract_video_thumbnails)
+		return items;
+
+	// ffmpeg can't write multiple images to stdout in a way that we could
+	// separate them. Therefore, write them into a temporary directory.
+	QTemporaryDir dir;
+	if (!dir.isValid())
+		return items;
+
+	QVector<duration_t> positions;
+	QStringList args { "-nostdin" };
+	for (const Item &item: items) {
+		positions.push_back(thumbnailPosition(item.duration));
+		args << "-ss" << positionString(positions.back()) << "-i" << item.filename;
+	}
+	for (int i = 0; i < items.size(); ++i) {
+		args << "-map" << QString("%1:v:0").arg(i) << "-frames:v" << "1" << "-q:v" << "2"
+		     << "-f" << "image2" << dir.filePath(QString("%1.jpg").arg(i));
+	}
+
+	QProcess ffmpeg;
+	if (!startFfmpeg(ffmpeg, args)) {
+		for (const Item &item: items)
+			fail(item, false);
+		return {};
+	}
+	// Kill ffmpeg if it doesn't write any frame within the timeout, so that a video
+	// that ffmpeg chokes on doesn't hold up the whole batch. The videos without
+	// frame are then retried one by one, each with its own timeout.
+	int written = 0;
+	while (!ffmpeg.waitForFinished(perVideoTimeout) && ffmpeg.state() != QProcess::NotRunning) {
+		int nowWritten = 0;
+		for (int i = 0; i < items.size(); ++i) {
+			if (QFile::exists(dir.filePath(QString("%1.jpg").arg(i))))
+				++nowWritten;
+		}
+		if (nowWritten == written) {
+			ffmpeg.kill();
+			ffmpeg.waitForFinished();
+			break;
+		}
+		written = nowWritten;
+	}
+
+	QVector<Item> remaining;
+	int extracted = 0;
+	for (int i = 0; i < items.size(); ++i) {
+		QImage img(dir.filePath(QString("%1.jpg").arg(i)));
+		if (img.isNull()) {
+			remaining.push_back(items[i]);
+			continue;
+		}
+		emit extracted(items[i].originalFilename, img, items[i].duration, positions[i]);
+		finish(items[i]);
+		++extracted;
+	}
+
+	QMutexLocker l(&lock);
+	extractedFrames += extracted;
+	return remaining;
+}
+
+void VideoFrameExtractor::processItem(const Item &item)
+{
+	// If video frame extraction is turned off (e.g. because we failed to start ffmpeg),
+	// abort immediately.
+	if (!prefs.extract_video_thumbnails) {
+		finish(item);
+		return;
+	}
 
+	duration_t position = thumbnailPosition(item.duration);
 	QProcess ffmpeg;
-	ffmpeg.start(prefs.ffmpeg_executable, QStringList {
-		"-ss", posString, "-i", filename, "-vframes", "1", "-q:v", "2", "-f", "image2", "-"
-	});
-	if (!ffmpeg.waitForStarted()) {
-		// Since we couldn't sart ffmpeg, turn off thumbnailing
-		// TODO: call the proper preferences-functions
-		prefs.extract_video_thumbnails = false;
-		report_error(qPrintable(tr("ffmpeg failed to start - video thumbnail creation suspended. To enable video thumbnailing, set working executable in preferences.")));
-		return fail(originalFilename, duration, false);
+	if (!startFfmpeg(ffmpeg, QStringList {
+		"-nostdin", "-ss", positionString(position), "-i", item.filename, "-vframes", "1", "-q:v", "2", "-f", "image2", "-"
+	})) {
+		return fail(item, false);
 	}
-	if (!ffmpeg.waitForFinished()) {
-		report_error(qPrintable(tr("Failed waiting for ffmpeg - video thumbnail creation suspended. To enable video thumbnailing, set working executable in preferences.")));
-		return fail(originalFilename, duration, false);
+	if (!ffmpeg.waitForFinished(perVideoTimeout)) {
+		// Don't hold up the other videos because of a video that ffmpeg chokes on.
+		ffmpeg.kill();
+		ffmpeg.waitForFinished();
+		// Don't mark the video as invalid, the machine may just be busy.
+		qInfo() << "Timeout waiting for ffmpeg on" << item.filename;
+		return fail(item, false);
 	}
 
 	QByteArray data = ffmpeg.readAll();
@@ -109,10 +252,11 @@ void VideoFrameExtractor::processItem(QString originalFilename, QString filename
 		// For debugging:
 		//QByteArray stderr_output = ffmpeg.readAll();
 		//qInfo() << "stderr: " << QString::fromUtf8(stderr_output);
-		return fail(originalFilename, duration, true);
+		return fail(item, true);
 	}
 
-	emit extracted(originalFilename, img, duration, position);
+	emit extracted(item.originalFilename, img, item.duration, position);
+	finish(item);
 	QMutexLocker l(&lock);
-	workingOn.remove(originalFilename);
+	++extractedFrames;
 }
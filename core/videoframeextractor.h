@@ -10,6 +10,9 @@
 #include <QQueue>
 #include <QString>
 #include <QPair>
+#include <QProcess>
+#include <QSet>
+#include <QElapsedTimer>
 
 class VideoFrameExtractor : public QObject {
 	Q_OBJECT
@@ -27,11 +30,25 @@ public slots:
 	void extract(QString originalFilename, QString filename, duration_t duration);
 	void clearWorkQueue();
 private:
-	void processItem(QString originalFilename, QString filename, duration_t duration);
-	void fail(const QString &originalFilename, duration_t duration, bool isInvalid);
+	struct Item {
+		QString originalFilename;
+		QString filename;
+		duration_t duration;
+	};
+	void startBatches();
+	void processBatch(QVector<Item> items);
+	QVector<Item> extractBatch(const QVector<Item> &items);
+	void processItem(const Item &item);
+	bool startFfmpeg(QProcess &ffmpeg, const QStringList &args);
+	void finish(const Item &item);
+	void fail(const Item &item, bool isInvalid);
 	mutable QMutex lock;
 	QThreadPool pool;
-	QMap<QString, QFuture<void>> workingOn;
+	QQueue<Item> pending;		// videos waiting for a free ffmpeg process
+	QSet<QString> workingOn;	// videos that are pending or being extracted
+	int runningBatches;
+	int extractedFrames;		// for reporting the throughput
+	QElapsedTimer timer;
 };
 
 #endif
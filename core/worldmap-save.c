@@ -94,7 +94,7 @@ void insert_javascript(struct membuffer *b, const bool selected_only)
 	put_string(b, "google.maps.event.addDomListener(window, 'load', initialize);</script>\n");
 }
 
-void export(struct membuffer *b, const bool selected_only)
+void export_worldmap_buffer(struct membuffer *b, const bool selected_only)
 {
 	insert_html_header(b);
 	insert_css(b);
@@ -107,7 +107,7 @@ void export_worldmap_HTML(const char *file_name, const bool selected_only)
 	FILE *f;
 
 	struct membuffer buf = { 0 };
-	export(&buf, selected_only);
+	export_worldmap_buffer(&buf, selected_only);
 
 	f = subsurface_fopen(file_name, "w+");
 	if (!f) {
@@ -6,7 +6,10 @@
 extern "C" {
 #endif
 
+struct membuffer;
+
 extern void export_worldmap_HTML(const char *file_name, const bool selected_only);
+extern void export_worldmap_buffer(struct membuffer *b, const bool selected_only);
 
 
 #ifdef __cplusplus
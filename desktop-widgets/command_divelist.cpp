@@ -143,7 +143,8 @@ DivesAndTripsToAdd DiveListBase::removeDives(DivesAndSitesToRemove &divesAndSite
 	for (const DiveToAdd &entry: divesToAdd)
 		dives.push_back({ entry.trip, entry.dive.get() });
 
-	// Send signals.
+	// Send signals. If many dives are removed, let the models reload once.
+	auto batch = diveListNotifier.startBatch((int)dives.size());
 	processByTrip(dives, [&](dive_trip *trip, const QVector<dive *> &divesInTrip) {
 		// Check if this trip is supposed to be deleted, by checking if it was marked as "add it".
 		bool deleteTrip = trip &&
@@ -202,7 +203,8 @@ DivesAndSitesToRemove DiveListBase::addDives(DivesAndTripsToAdd &toAdd)
 	}
 	toAdd.sites.clear();
 
-	// Send signals by trip.
+	// Send signals by trip. If many dives are added, let the models reload once.
+	auto batch = diveListNotifier.startBatch((int)dives.size());
 	processByTrip(dives, [&](dive_trip *trip, const QVector<dive *> &divesInTrip) {
 		// Now, let's check if this trip is supposed to be created, by checking if it was marked as "add it".
 		bool createTrip = trip && std::find(addedTrips.begin(), addedTrips.end(), trip) != addedTrips.end();
@@ -228,6 +230,7 @@ static void renumberDives(QVector<QPair<dive *, int>> &divesToRenumber)
 	}
 
 	// Send signals.
+	auto batch = diveListNotifier.startBatch(dives.size());
 	emit diveListNotifier.divesChanged(dives, DiveField::NR);
 }
 
@@ -303,6 +306,9 @@ static void moveDivesBetweenTrips(DivesToTrip &dives)
 	std::sort(divesMoved.begin(), divesMoved.end(), [] ( const DiveMoved &d1, const DiveMoved &d2)
 		  { return std::tie(d1.from, d1.to, d1.d->when) < std::tie(d2.from, d2.to, d2.d->when); });
 
+	// If many dives are moved, let the models reload once.
+	auto batch = diveListNotifier.startBatch((int)divesMoved.size());
+
 	// Now, process the dives in batches by trip
 	// TODO: this is a bit different from the cases above, so we don't use the processByTrip template,
 	// but repeat the loop here. We might think about generalizing the template, if more of such
@@ -587,8 +593,11 @@ void ShiftTime::redoit()
 		sort_dive_table(&trip->dives); // Keep the trip-table in order
 
 	// Send signals
-	emit diveListNotifier.divesTimeChanged(timeChanged, diveList);
-	emit diveListNotifier.divesChanged(diveList, DiveField::DATETIME);
+	{
+		auto batch = diveListNotifier.startBatch(diveList.size());
+		emit diveListNotifier.divesTimeChanged(timeChanged, diveList);
+		emit diveListNotifier.divesChanged(diveList, DiveField::DATETIME);
+	}
 
 	// Select the changed dives
 	setSelection(diveList.toStdVector(), diveList[0]);
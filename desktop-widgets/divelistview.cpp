@@ -1005,8 +1005,22 @@ void DiveListView::matchImagesToDives(QStringList fileNames)
 		return;
 	updateLastImageTimeOffset(shiftDialog.amount());
 
-	for (const QString &fileName: fileNames)
-		create_picture(qPrintable(fileName), shiftDialog.amount(), shiftDialog.matchAll());
+	// Use the metadata that was read for the dialog, unless the user canceled reading it.
+	QVector<media_metadata> metadata = shiftDialog.metadata();
+	if (metadata.size() != fileNames.size())
+		metadata = scan_metadata(fileNames.toVector());
+
+	// Match all pictures to the dives in one go
+	std::vector<QByteArray> names;
+	std::vector<const char *> namePointers;
+	std::vector<struct metadata> data;
+	names.reserve(fileNames.size());
+	for (int i = 0; i < fileNames.size(); ++i) {
+		names.push_back(fileNames[i].toLocal8Bit());
+		namePointers.push_back(names.back().constData());
+		data.push_back(metadata[i].data);
+	}
+	create_pictures(fileNames.size(), namePointers.data(), data.data(), shiftDialog.amount(), shiftDialog.matchAll());
 
 	mark_divelist_changed(true);
 	copy_dive(current_dive, &displayed_dive);
@@ -16,6 +16,7 @@
 #include "desktop-widgets/mainwindow.h"
 #include "profile-widget/profilewidget2.h"
 #include "core/save-profiledata.h"
+#include "core/profilerenderer.h"
 #include "core/divesite.h"
 #include "core/tag.h"
 
@@ -119,6 +120,7 @@ void DiveLogExportDialog::exportHtmlInit(const QString &filename)
 	hes.themeSelection = ui->themeSelection->currentIndex();
 	hes.subsurfaceNumbers = ui->exportSubsurfaceNumber->isChecked();
 	hes.yearlyStatistics = ui->exportStatistics->isChecked();
+	hes.splitSamples = ui->exportSplitSamples->isChecked();
 
 	exportHtmlInitLogic(filename, hes);
 }
@@ -262,26 +264,26 @@ void DiveLogExportDialog::exportProfile(QString filename, const bool selected_on
 	if (!filename.endsWith(".png", Qt::CaseInsensitive))
 		filename = filename.append(".png");
 	QFileInfo fi(filename);
+	QVector<struct dive *> dives;
+	QVector<QString> filenames;
 
 	for_each_dive (i, dive) {
 		if (selected_only && !dive->selected)
 			continue;
+		dives.append(dive);
 		if (count)
-			saveProfile(dive, fi.path() + QDir::separator() + fi.completeBaseName().append(QString("-%1.").arg(count)) + fi.suffix());
+			filenames.append(fi.path() + QDir::separator() + fi.completeBaseName().append(QString("-%1.").arg(count)) + fi.suffix());
 		else
-			saveProfile(dive, filename);
+			filenames.append(filename);
 		++count;
 	}
+	saveProfiles(dives, filenames);
 }
 
-void DiveLogExportDialog::saveProfile(const struct dive *dive, const QString filename)
+// Render the profiles headless, with the size of the profile widget
+void DiveLogExportDialog::saveProfiles(const QVector<struct dive *> &dives, const QVector<QString> &filenames)
 {
-	ProfileWidget2 *profile = MainWindow::instance()->graphics;
-	profile->plotDive(dive, true, false, true);
-	profile->setToolTipVisibile(false);
-	QPixmap pix = profile->grab();
-	profile->setToolTipVisibile(true);
-	pix.save(filename);
+	exportProfileImages(dives, filenames, MainWindow::instance()->graphics->size());
 }
 
 void DiveLogExportDialog::export_TeX(const char *filename, const bool selected_only, bool plain)
@@ -337,11 +339,14 @@ void DiveLogExportDialog::export_TeX(const char *filename, const bool selected_o
 
 	put_format(&buf, "\n%%%%%%%%%% Begin Dive Data: %%%%%%%%%%\n");
 
+	QVector<struct dive *> profileDives;
+	QVector<QString> profileFiles;
 	for_each_dive (i, dive) {
 		if (selected_only && !dive->selected)
 			continue;
 
-		saveProfile(dive, texdir.filePath(QString("profile%1.png").arg(dive->number)));
+		profileDives.append(dive);
+		profileFiles.append(texdir.filePath(QString("profile%1.png").arg(dive->number)));
 		struct tm tm;
 		utc_mkdate(dive->when, &tm);
 
@@ -467,6 +472,7 @@ void DiveLogExportDialog::export_TeX(const char *filename, const bool selected_o
 		put_format(&buf, "\\%spage\n", ssrf);
 
 	}
+	saveProfiles(profileDives, profileFiles);
 
 	if (plain)
 		put_format(&buf, "\\bye\n");
@@ -35,7 +35,7 @@ private:
 	void export_depths(const char *filename, const bool selected_only);
 	void export_TeX(const char *filename, const bool selected_only, bool plain);
 	void exportProfile(QString filename, const bool selected_only);
-	void saveProfile(const struct dive *dive, const QString filename);
+	void saveProfiles(const QVector<struct dive *> &dives, const QVector<QString> &filenames);
 
 };
 
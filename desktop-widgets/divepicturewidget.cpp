@@ -72,3 +72,63 @@ void DivePictureWidget::wheelEvent(QWheelEvent *event)
 	} else
 		QListView::wheelEvent(event);
 }
+
+void DivePictureWidget::doItemsLayout()
+{
+	QListView::doItemsLayout();
+	updateVisibleRows();
+}
+
+void DivePictureWidget::scrollContentsBy(int dx, int dy)
+{
+	QListView::scrollContentsBy(dx, dy);
+	updateVisibleRows();
+}
+
+void DivePictureWidget::resizeEvent(QResizeEvent *event)
+{
+	QListView::resizeEvent(event);
+	updateVisibleRows();
+}
+
+// Tell the model which rows are shown, so that these thumbnails are calculated first.
+// The items are laid out in lines from left to right, therefore the shown rows form a
+// contiguous range. The items have different sizes, so that a given point may lie in a
+// gap between items. Therefore, find one shown item by probing a grid of points and
+// extend the range from there to all items that intersect the viewport.
+void DivePictureWidget::updateVisibleRows()
+{
+	DivePictureModel *pictureModel = qobject_cast<DivePictureModel *>(model());
+	if (!pictureModel)
+		return;
+	QRect area = viewport()->rect();
+	int rows = pictureModel->rowCount();
+	auto isShown = [&](int row) { return visualRect(pictureModel->index(row, 0)).intersects(area); };
+
+	const int probes = 8;
+	int anchor = -1;
+	for (int i = 0; i <= probes && anchor < 0; ++i) {
+		for (int j = 0; j <= probes && anchor < 0; ++j) {
+			QPoint p(area.left() + (area.width() - 1) * j / probes, area.top() + (area.height() - 1) * i / probes);
+			QModelIndex index = indexAt(p);
+			if (index.isValid())
+				anchor = index.row();
+		}
+	}
+	// All probes missed, e.g. for tiny items. Search the rows.
+	for (int row = 0; row < rows && anchor < 0; ++row) {
+		if (isShown(row))
+			anchor = row;
+	}
+	if (anchor < 0) {
+		pictureModel->setVisibleRows(0, -1);
+		return;
+	}
+
+	int first = anchor, last = anchor;
+	while (first > 0 && isShown(first - 1))
+		--first;
+	while (last + 1 < rows && isShown(last + 1))
+		++last;
+	pictureModel->setVisibleRows(first, last);
+}
@@ -11,14 +11,19 @@ class DivePictureWidget : public QListView {
 	Q_OBJECT
 public:
 	DivePictureWidget(QWidget *parent);
+	void doItemsLayout() override;
 protected:
 	void mouseDoubleClickEvent(QMouseEvent *event) override;
 	void mousePressEvent(QMouseEvent *event) override;
 	void wheelEvent(QWheelEvent *event) override;
+	void scrollContentsBy(int dx, int dy) override;
+	void resizeEvent(QResizeEvent *event) override;
 
 signals:
 	void photoDoubleClicked(const QString filePath);
 	void zoomLevelChanged(int delta);
+private:
+	void updateVisibleRows();
 };
 
 class DivePictureThumbnailThread : public QThread {
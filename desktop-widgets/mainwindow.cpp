@@ -193,6 +193,9 @@ MainWindow::MainWindow() : QMainWindow(),
 	}
 	connect(diveList, &DiveListView::divesSelected, this, &MainWindow::selectionChanged);
 	connect(PreferencesDialog::instance(), SIGNAL(settingsChanged()), this, SLOT(readSettings()));
+	// The dive list caches its formatted strings, which depend on the units.
+	// This must be connected before the dive list is updated.
+	connect(PreferencesDialog::instance(), &PreferencesDialog::settingsChanged, [] { DiveTripModelBase::instance()->clearCache(); });
 	connect(PreferencesDialog::instance(), SIGNAL(settingsChanged()), diveList, SLOT(update()));
 	connect(PreferencesDialog::instance(), SIGNAL(settingsChanged()), diveList, SLOT(reloadHeaderActions()));
 	connect(PreferencesDialog::instance(), SIGNAL(settingsChanged()), mainTab.get(), SLOT(updateDiveInfo()));
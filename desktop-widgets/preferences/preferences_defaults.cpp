@@ -116,6 +116,7 @@ void PreferencesDefaults::refreshSettings()
 			ui->default_cylinder->setCurrentIndex(i);
 	}
 	ui->displayinvalid->setChecked(qPrefDisplay::display_invalid_dives());
+	ui->openglProfile->setChecked(qPrefDisplay::opengl_profile());
 	ui->velocitySlider->setValue(qPrefDisplay::animation_speed());
 	ui->btnUseDefaultFile->setChecked(qPrefGeneral::use_default_file());
 
@@ -159,5 +160,6 @@ void PreferencesDefaults::syncSettings()
 	qPrefDisplay::set_divelist_font(ui->font->currentFont().toString());
 	qPrefDisplay::set_font_size(ui->fontsize->value());
 	qPrefDisplay::set_display_invalid_dives(ui->displayinvalid->isChecked());
+	qPrefDisplay::set_opengl_profile(ui->openglProfile->isChecked());
 	qPrefDisplay::set_animation_speed(ui->velocitySlider->value());
 }
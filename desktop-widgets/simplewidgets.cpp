@@ -11,6 +11,7 @@
 #include <QDesktopServices>
 #include <QToolTip>
 #include <QClipboard>
+#include <QProgressDialog>
 
 #include "core/file.h"
 #include "core/divesite.h"
@@ -334,13 +335,24 @@ ShiftImageTimesDialog::ShiftImageTimesDialog(QWidget *parent, QStringList fileNa
 	dcImageEpoch = (time_t)0;
 
 	// Get times of all files. 0 means that the time couldn't be determined.
+	// For many files this takes a while, therefore show a progress dialog.
 	int numFiles = fileNames.size();
-	timestamps.resize(numFiles);
-	for (int i = 0; i < numFiles; ++i)
-		timestamps[i] = picture_get_timestamp(qPrintable(fileNames[i]));
+	QProgressDialog progress(tr("Reading metadata of media files..."), tr("Cancel"), 0, numFiles, parent);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(500);
+	fileMetadata = scan_metadata(fileNames.toVector(), [&progress](int done)
+				     { progress.setValue(done); return !progress.wasCanceled(); });
+	timestamps.fill(0, numFiles);
+	for (int i = 0; i < fileMetadata.size(); ++i)
+		timestamps[i] = fileMetadata[i].data.timestamp;
 	updateInvalid();
 }
 
+const QVector<media_metadata> &ShiftImageTimesDialog::metadata() const
+{
+	return fileMetadata;
+}
+
 time_t ShiftImageTimesDialog::amount() const
 {
 	return m_amount;
@@ -373,8 +385,10 @@ void ShiftImageTimesDialog::updateInvalid()
 	ui.invalidFilesText->append(tr("\nFiles with inappropriate date/time") + ":");
 
 	int numFiles = fileNames.size();
+	std::vector<struct dive *> dives(numFiles);
+	match_pictures_to_dives(numFiles, timestamps.constData(), m_amount, false, dives.data());
 	for (int i = 0; i < numFiles; ++i) {
-		if (picture_check_valid_time(timestamps[i], m_amount))
+		if (dives[i])
 			continue;
 
 		// We've found an invalid image
@@ -22,6 +22,7 @@ class FilterModelBase;
 #include "ui_listfilter.h"
 #include "core/exif.h"
 #include "core/dive.h"
+#include "core/metadata.h"
 
 
 class MinMaxAvgWidget : public QWidget {
@@ -98,6 +99,8 @@ class ShiftImageTimesDialog : public QDialog {
 	Q_OBJECT
 public:
 	explicit ShiftImageTimesDialog(QWidget *parent, QStringList fileNames);
+	// Metadata of the files in the order of the filenames. Empty if the user canceled reading.
+	const QVector<media_metadata> &metadata() const;
 	time_t amount() const;
 	void setOffset(time_t offset);
 	bool matchAll();
@@ -113,6 +116,7 @@ slots:
 
 private:
 	QStringList fileNames;
+	QVector<media_metadata> fileMetadata;
 	QVector<timestamp_t> timestamps;
 	Ui::ShiftImageTimesDialog ui;
 	time_t m_amount;
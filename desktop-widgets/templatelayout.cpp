@@ -5,6 +5,7 @@
 
 #include "templatelayout.h"
 #include "core/display.h"
+#include "core/statisticscache.h"
 
 QList<QString> grantlee_templates, grantlee_statistics_templates;
 
@@ -194,6 +195,7 @@ QString TemplateLayout::generateStatistics()
 	engine.addTemplateLoader(m_templateLoader);
 
 	Grantlee::registerMetaType<YearInfo>();
+	Grantlee::registerMetaType<GroupInfo>();
 	Grantlee::registerMetaType<template_options>();
 	Grantlee::registerMetaType<print_options>();
 
@@ -201,25 +203,46 @@ QString TemplateLayout::generateStatistics()
 
 	int i = 0;
 	stats_summary_auto_free stats;
-	calculate_stats_summary(&stats, false);
+	StatisticsCache::instance()->calculateSummary(&stats, false);
 	while (stats.stats_yearly != NULL && stats.stats_yearly[i].period) {
 		YearInfo year{ &stats.stats_yearly[i] };
 		years.append(QVariant::fromValue(year));
 		i++;
 	}
 
+	// All groupings are calculated in a single pass over the dives
+	const stats_group_by groupBy[] = {
+		STATS_BY_SITE, STATS_BY_BUDDY, STATS_BY_TAG, STATS_BY_SUIT,
+		STATS_BY_CYLINDER_TYPE, STATS_BY_GASMIX, STATS_BY_DIVE_COMPUTER, STATS_BY_HOUR
+	};
+	const char *groupNames[] = {
+		"sites", "buddies", "tags", "suits",
+		"cylinders", "gases", "divecomputers", "hours"
+	};
+	const int numGroupings = sizeof(groupBy) / sizeof(groupBy[0]);
+	stats_grouping groupings[numGroupings];
+	calculate_stats_groups(groupings, groupBy, numGroupings, false);
+
 	Grantlee::Context c;
 	c.insert("years", years);
+	for (int g = 0; g < numGroupings; ++g) {
+		QVariantList groups;
+		for (int j = 0; j < groupings[g].nr; ++j)
+			groups.append(QVariant::fromValue(GroupInfo{ &groupings[g].groups[j] }));
+		c.insert(groupNames[g], groups);
+	}
 	c.insert("template_options", QVariant::fromValue(*templateOptions));
 	c.insert("print_options", QVariant::fromValue(*printOptions));
 
 	Grantlee::Template t = engine.loadByName(printOptions->p_template);
 	if (!t || t->error()) {
 		qDebug() << "Can't load template";
+		free_stats_groups(groupings, numGroupings);
 		return htmlContent;
 	}
 
 	htmlContent = t->render(&c);
+	free_stats_groups(groupings, numGroupings);
 
 	if (t->error()) {
 		qDebug() << "Can't render template";
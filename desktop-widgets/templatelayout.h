@@ -38,9 +38,14 @@ struct YearInfo {
 	stats_t *year;
 };
 
+struct GroupInfo {
+	const stats_group *group;
+};
+
 Q_DECLARE_METATYPE(template_options)
 Q_DECLARE_METATYPE(print_options)
 Q_DECLARE_METATYPE(YearInfo)
+Q_DECLARE_METATYPE(GroupInfo)
 
 GRANTLEE_BEGIN_LOOKUP(template_options)
 if (property == "font") {
@@ -120,4 +125,40 @@ if (property == "year") {
 }
 GRANTLEE_END_LOOKUP
 
+GRANTLEE_BEGIN_LOOKUP(GroupInfo)
+const stats_aggregate *duration = &object.group->var[STATS_VAR_DURATION];
+const stats_aggregate *depth = &object.group->var[STATS_VAR_MAX_DEPTH];
+const stats_aggregate *sac = &object.group->var[STATS_VAR_SAC];
+const stats_aggregate *temp = &object.group->var[STATS_VAR_WATER_TEMP];
+temperature_t min_temp, max_temp;
+min_temp.mkelvin = temp->min;
+max_temp.mkelvin = temp->max;
+if (property == "name") {
+	return QString(object.group->name);
+} else if (property == "dives") {
+	return object.group->dive_count;
+} else if (property == "total_time") {
+	return get_dive_duration_string(duration->sum, gettextFromC::tr("h"),
+									gettextFromC::tr("min"), gettextFromC::tr("sec"), " ");
+} else if (property == "avg_time") {
+	return get_minutes(stats_aggregate_avg(duration));
+} else if (property == "median_time") {
+	return get_minutes(stats_aggregate_percentile(duration, 50));
+} else if (property == "longest_time") {
+	return get_minutes(duration->max);
+} else if (property == "avg_depth") {
+	return get_depth_string(stats_aggregate_avg(depth));
+} else if (property == "max_depth") {
+	return get_depth_string(depth->max);
+} else if (property == "avg_sac") {
+	return get_volume_string(stats_aggregate_avg(sac));
+} else if (property == "median_sac") {
+	return get_volume_string(stats_aggregate_percentile(sac, 50));
+} else if (property == "min_temp") {
+	return temp->count ? get_temperature_string(min_temp, true) : "0";
+} else if (property == "max_temp") {
+	return temp->count ? get_temperature_string(max_temp, true) : "0";
+}
+GRANTLEE_END_LOOKUP
+
 #endif
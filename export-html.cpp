@@ -1,68 +1,352 @@
 // SPDX-License-Identifier: GPL-2.0
 /* Dirk Hohndel, 2015 */
 
+// Headless export and conversion of dive logs.
+//
+// Reads one or more dive logs (git repositories or XML files) and writes
+// them as HTML, XML, git, CSV profile data or world map. No widgets are
+// created; the Qt GUI module is only used for painting profile images and
+// runs on the offscreen platform unless told otherwise.
+//
+// The core keeps the dive log in global tables, therefore one process
+// converts one log. If multiple sources are given, the tool runs itself
+// once per source, with a limited number of processes at the same time.
+
 #include <QString>
+#include <QStringList>
 #include <QCommandLineParser>
-#include <QApplication>
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QThread>
 #include <QDebug>
+#include <QDir>
 
 #include "core/qt-gui.h"
 #include "core/qthelper.h"
 #include "core/file.h"
+#include "core/divelist.h"
 #include "core/divesite.h"
 #include "core/trip.h"
+#include "core/membuffer.h"
 #include "core/save-html.h"
+#include "core/save-profiledata.h"
+#include "core/worldmap-save.h"
+#include "core/git-access.h"
 #include <stdio.h>
+#include <algorithm>
 #include "git2.h"
 #include "core/subsurfacestartup.h"
 #include "core/divelogexportlogic.h"
 #include "core/statistics.h"
+#include "core/profilerenderer.h"
+
+enum class Format {
+	HTML,
+	XML,
+	Git,
+	CSV,
+	Worldmap
+};
+
+struct ConvertOptions {
+	Format format;
+	QString profiles;
+	bool splitSamples;
+	bool timings;
+};
+
+static bool parseFormat(const QString &name, Format &format)
+{
+	static const struct {
+		const char *name;
+		Format format;
+	} formats[] = {
+		{ "html", Format::HTML },
+		{ "xml", Format::XML },
+		{ "git", Format::Git },
+		{ "csv", Format::CSV },
+		{ "worldmap", Format::Worldmap }
+	};
+	for (const auto &f: formats) {
+		if (name == f.name) {
+			format = f.format;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Set when the core reports an error, e.g. from the HTML export, which has no return value
+static bool hadError = false;
+
+static void printError(char *error)
+{
+	fprintf(stderr, "%s\n", error);
+	free(error);
+	hadError = true;
+}
+
+// Only dive logs in git repositories store the preferences, such as the units
+static bool isGitRepository(const QString &source)
+{
+	QByteArray filename = source.toUtf8();
+	const char *branch = NULL, *remote = NULL;
+	if (!is_git_repository(filename.constData(), &branch, &remote, true))
+		return false;
+	free((void *)branch);
+	free((void *)remote);
+	return true;
+}
+
+// Prints the time spent in each stage of a conversion, if requested.
+class StageTimer {
+public:
+	StageTimer(const QString &source, bool enabled) : source(source), enabled(enabled)
+	{
+		timer.start();
+	}
+	void stage(const char *name)
+	{
+		if (enabled)
+			fprintf(stderr, "%s: %s %lld ms\n", qPrintable(source), name, (long long)timer.restart());
+	}
+private:
+	QString source;
+	bool enabled;
+	QElapsedTimer timer;
+};
+
+static bool writeBuffer(struct membuffer *b, const QString &filename)
+{
+	FILE *f = subsurface_fopen(qPrintable(filename), "w");
+	if (!f) {
+		fprintf(stderr, "Can't open file %s\n", qPrintable(filename));
+		return false;
+	}
+	flush_buffer(b, f);
+	bool ok = !ferror(f);
+	if (fclose(f))
+		ok = false;
+	if (!ok)
+		fprintf(stderr, "Can't write file %s\n", qPrintable(filename));
+	return ok;
+}
+
+// For the formats that are built in memory, formatting and writing are timed separately.
+static bool writeFormatted(void (*format)(struct membuffer *, bool), const QString &output, StageTimer &timer)
+{
+	struct membuffer buf = { 0 };
+	format(&buf, false);
+	timer.stage("format");
+	bool ok = writeBuffer(&buf, output);
+	free_buffer(&buf);
+	timer.stage("write");
+	return ok;
+}
+
+static void saveDivesBuffer(struct membuffer *b, bool selected_only)
+{
+	save_dives_buffer(b, selected_only, false);
+}
+
+static void exportProfiles(const QString &profiles)
+{
+	QDir profileDir(profiles);
+	QVector<struct dive *> dives;
+	QVector<QString> filenames;
+	struct dive *dive;
+	int i;
+
+	profileDir.mkpath(".");
+	for_each_dive (i, dive) {
+		dives.append(dive);
+		filenames.append(profileDir.filePath(QString("profile%1.png").arg(dive->number)));
+	}
+	int written = exportProfileImages(dives, filenames, QSize(800, 450));
+	if (written != dives.size())
+		fprintf(stderr, "wrote %d of %d profile images\n", written, dives.size());
+}
+
+// Convert one dive log in this process
+static int convert(const QString &source, const QString &output, const ConvertOptions &options)
+{
+	StageTimer timer(source, options.timings);
+	int ret = parse_file(qPrintable(source), &dive_table, &trip_table, &dive_site_table);
+	if (ret) {
+		fprintf(stderr, "%s: parse_file returned %d\n", qPrintable(source), ret);
+		return 1;
+	}
+	timer.stage("parse");
+
+	process_loaded_dives();
+	// for git repositories this should have set up the informational
+	// preferences - let's grab the units from there
+	if (isGitRepository(source)) {
+		prefs.unit_system = git_prefs.unit_system;
+		prefs.units = git_prefs.units;
+	}
+	timer.stage("fixup");
+
+	bool ok = true;
+	hadError = false;
+	switch (options.format) {
+	case Format::HTML: {
+		// now set up the export settings to create the HTML export
+		struct htmlExportSetting hes;
+		hes.themeFile = "sand.css";
+		hes.exportPhotos = true;
+		hes.selectedOnly = false;
+		hes.listOnly = false;
+		hes.yearlyStatistics = true;
+		hes.subsurfaceNumbers = true;
+		hes.splitSamples = options.splitSamples;
+		exportHtmlInitLogic(output, hes);
+		// The HTML export streams the dives to disk while formatting them
+		timer.stage("format+write");
+		break;
+	}
+	case Format::XML:
+		ok = writeFormatted(&saveDivesBuffer, output, timer);
+		break;
+	case Format::Git: {
+		// The target is given as <directory>[<branch>]. Create the repository if needed.
+		QString target = output.endsWith(']') ? output : output + "[master]";
+		QString directory = target.left(target.lastIndexOf('['));
+		if (!QDir(directory).exists(".git")) {
+			QDir().mkpath(directory);
+			if (git_create_local_repo(qPrintable(target)) != 0) {
+				ok = false;
+				break;
+			}
+		}
+		ok = save_dives_logic(qPrintable(target), false, false) == 0;
+		timer.stage("format+write");
+		break;
+	}
+	case Format::CSV:
+		ok = writeFormatted(&save_profiles_buffer, output, timer);
+		break;
+	case Format::Worldmap:
+		ok = writeFormatted(&export_worldmap_buffer, output, timer);
+		break;
+	}
+	if (hadError)
+		ok = false;
+
+	if (!options.profiles.isEmpty()) {
+		exportProfiles(options.profiles);
+		timer.stage("profiles");
+	}
+	return ok ? 0 : 1;
+}
+
+// Convert multiple dive logs by running one process per log, at most jobs at the same time.
+static int convertInChildren(const QStringList &sources, const QStringList &outputs, const QStringList &childArguments, int jobs)
+{
+	QList<QProcess *> running;
+	int next = 0;
+	int failed = 0;
+	while (next < sources.size() || !running.isEmpty()) {
+		while (next < sources.size() && running.size() < jobs) {
+			QProcess *process = new QProcess;
+			process->setObjectName(sources[next]);
+			process->setProcessChannelMode(QProcess::ForwardedChannels);
+			process->start(QCoreApplication::applicationFilePath(),
+				       QStringList(childArguments) << "--source" << sources[next] << "--output" << outputs[next]);
+			running.append(process);
+			++next;
+		}
+		for (auto it = running.begin(); it != running.end();) {
+			QProcess *process = *it;
+			if (process->state() != QProcess::NotRunning && !process->waitForFinished(50)) {
+				++it;
+				continue;
+			}
+			if (process->error() == QProcess::FailedToStart || process->exitStatus() != QProcess::NormalExit ||
+			    process->exitCode() != 0) {
+				fprintf(stderr, "converting %s failed\n", qPrintable(process->objectName()));
+				++failed;
+			}
+			delete process;
+			it = running.erase(it);
+		}
+	}
+	return failed ? 1 : 0;
+}
 
 int main(int argc, char **argv)
 {
-	QApplication *application = new QApplication(argc, argv);
+	// Painting the profiles doesn't need a display
+	if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QGuiApplication *application = new QGuiApplication(argc, argv);
 	git_libgit2_init();
 	copy_prefs(&default_prefs, &prefs);
 	init_qt_late();
+	set_error_cb(&printError);
 
 	QCommandLineParser parser;
 	QCommandLineOption sourceDirectoryOption(QStringList() << "s" << "source",
-						 "Read git repository from <directory>",
-						 "directory");
+						 "Read dives from <file>, which is a git repository or an XML file. "
+						 "Can be given multiple times",
+						 "file");
 	parser.addOption(sourceDirectoryOption);
 	QCommandLineOption outputDirectoryOption(QStringList() << "u" << "output",
-						 "Write HTML files into <directory>",
-						 "directory");
+						 "Write the result of the corresponding source to <file>. "
+						 "For HTML this is the main page, for git a directory with an optional [branch]",
+						 "file");
 	parser.addOption(outputDirectoryOption);
+	QCommandLineOption formatOption(QStringList() << "f" << "format",
+					"Output format: html (default), xml, git, csv (profile data) or worldmap",
+					"format", "html");
+	parser.addOption(formatOption);
+	QCommandLineOption profileDirectoryOption(QStringList() << "p" << "profiles",
+						  "Also write the dive profiles as PNG images into <directory>",
+						  "directory");
+	parser.addOption(profileDirectoryOption);
+	QCommandLineOption splitSamplesOption("split-samples",
+					      "HTML: write the samples of each dive into a file that is loaded on demand");
+	parser.addOption(splitSamplesOption);
+	QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+				      "Convert up to <n> sources at the same time",
+				      "n", QString::number(QThread::idealThreadCount()));
+	parser.addOption(jobsOption);
+	QCommandLineOption timingsOption(QStringList() << "t" << "timings",
+					 "Print the time spent parsing, fixing up, formatting and writing");
+	parser.addOption(timingsOption);
 
 	parser.process(*application);
 
-	QString source = parser.value(sourceDirectoryOption);
-	QString output = parser.value(outputDirectoryOption);
+	QStringList sources = parser.values(sourceDirectoryOption);
+	QStringList outputs = parser.values(outputDirectoryOption);
+	ConvertOptions options;
+	options.profiles = parser.value(profileDirectoryOption);
+	options.splitSamples = parser.isSet(splitSamplesOption);
+	options.timings = parser.isSet(timingsOption);
+	int jobs = std::max(parser.value(jobsOption).toInt(), 1);
 
-	if (source.isEmpty() || output.isEmpty()) {
-		qDebug() << "need --source and --output";
+	if (sources.isEmpty() || sources.size() != outputs.size()) {
+		qDebug() << "need --source and --output for each input";
 		exit(1);
 	}
-	int ret = parse_file(qPrintable(source), &dive_table, &trip_table, &dive_site_table);
-	if (ret) {
-		fprintf(stderr, "parse_file returned %d\n", ret);
+	if (!parseFormat(parser.value(formatOption), options.format)) {
+		qDebug() << "unknown format" << parser.value(formatOption);
 		exit(1);
 	}
+	if (sources.size() > 1 && !options.profiles.isEmpty()) {
+		qDebug() << "--profiles can only be used with a single source";
+		exit(1);
+	}
+
+	if (sources.size() == 1)
+		exit(convert(sources[0], outputs[0], options));
 
-	// this should have set up the informational preferences - let's grab
-	// the units from there
-	prefs.unit_system = git_prefs.unit_system;
-	prefs.units = git_prefs.units;
-
-	// now set up the export settings to create the HTML export
-	struct htmlExportSetting hes;
-	hes.themeFile = "sand.css";
-	hes.exportPhotos = true;
-	hes.selectedOnly = false;
-	hes.listOnly = false;
-	hes.yearlyStatistics = true;
-	hes.subsurfaceNumbers = true;
-	exportHtmlInitLogic(output, hes);
-	exit(0);
+	QStringList childArguments;
+	childArguments << "--format" << parser.value(formatOption);
+	if (options.splitSamples)
+		childArguments << "--split-samples";
+	if (options.timings)
+		childArguments << "--timings";
+	exit(convertInChildren(sources, outputs, childArguments, jobs));
 }
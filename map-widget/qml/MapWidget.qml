@@ -42,10 +42,30 @@ Item {
 		property var clickCoord: QtPositioning.coordinate(0, 0)
 		property bool isReady: false
 
-		Component.onCompleted: isReady = true
+		Component.onCompleted: {
+			isReady = true
+			viewportTimer.restart()
+		}
 		onZoomLevelChanged: {
 			if (isReady)
 				mapHelper.calculateSmallCircleRadius(map.center)
+			viewportTimer.restart()
+		}
+		onCenterChanged: viewportTimer.restart()
+		onWidthChanged: viewportTimer.restart()
+		onHeightChanged: viewportTimer.restart()
+
+		// The model only contains the markers in the viewport. Don't update
+		// it on every step of an animation, but once the map comes to rest.
+		Timer {
+			id: viewportTimer
+			interval: 50
+			onTriggered: map.updateViewport()
+		}
+
+		function updateViewport() {
+			if (isReady)
+				mapHelper.model.setViewport(center, zoomLevel, width, height)
 		}
 
 		MapItemView {
@@ -65,11 +85,32 @@ Item {
 						PropertyAnimation { target: mapItemImage; property: "scale"; from: 1.0; to: 0.7; duration: 120 }
 						PropertyAnimation { target: mapItemImage; property: "scale"; from: 0.7; to: 1.0; duration: 80 }
 					}
+					Rectangle {
+						// A cluster of dive sites: show the number of sites on the marker
+						visible: model.sitecount > 1
+						anchors.horizontalCenter: parent.horizontalCenter
+						y: -height * 0.5
+						width: Math.max(clusterText.width + 8, height)
+						height: clusterText.height + 4
+						radius: height * 0.5
+						color: "#b08000"
+						border.color: "white"
+						Text {
+							id: clusterText
+							anchors.centerIn: parent
+							text: model.sitecount
+							font.pointSize: 9.0
+							color: "white"
+						}
+					}
 					MouseArea {
 						drag.target: (mapHelper.editMode && mapHelper.model.isSelected(model.divesite)) ? mapItem : undefined
 						anchors.fill: parent
 						onClicked: {
-							if (!mapHelper.editMode)
+							// Clicking on a cluster zooms in, so that the sites are shown individually
+							if (model.sitecount > 1)
+								map.doubleClickHandler(mapItem.coordinate)
+							else if (!mapHelper.editMode)
 								mapHelper.model.setSelected(model.divesite, true)
 						}
 						onDoubleClicked: map.doubleClickHandler(mapItem.coordinate)
@@ -368,6 +409,7 @@ Item {
 				mapHelper.copyToClipboardCoordinates(map.center, true)
 				break
 			case contextMenu.actions.SELECT_VISIBLE_LOCATIONS:
+				map.updateViewport()
 				mapHelper.selectVisibleLocations()
 				break
 			}
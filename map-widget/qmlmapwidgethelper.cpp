@@ -149,13 +149,9 @@ void MapWidgetHelper::selectVisibleLocations()
 		struct dive_site *ds = get_dive_site_for_dive(dive);
 		if (!dive_site_has_gps_location(ds))
 			continue;
-		const qreal latitude = ds->location.lat.udeg * 0.000001;
-		const qreal longitude = ds->location.lon.udeg * 0.000001;
-		QGeoCoordinate dsCoord(latitude, longitude);
-		QPointF point;
-		QMetaObject::invokeMethod(m_map, "fromCoordinate", Q_RETURN_ARG(QPointF, point),
-		                          Q_ARG(QGeoCoordinate, dsCoord));
-		if (!qIsNaN(point.x()))
+		// Use the viewport known to the model instead of asking
+		// the map for the screen position of every single dive.
+		if (m_mapLocationModel->isInViewport(ds->location))
 #ifndef SUBSURFACE_MOBILE // indexes on desktop
 			selectedDiveIds.append(idx);
 	}
@@ -221,6 +221,9 @@ void ToolTipItem::readPos()
 void ToolTipItem::setPlotInfo(const plot_info &plot)
 {
 	pInfo = plot;
+	// The descriptions are formatted lazily on first hover
+	entryDescriptions.clear();
+	entryDescriptions.resize(pInfo.nr);
 }
 
 void ToolTipItem::setTimeAxis(DiveCartesianAxis *axis)
@@ -244,8 +247,7 @@ void ToolTipItem::refresh(const QPointF &pos)
 	lastTime = time;
 	clear();
 
-	mb.len = 0;
-	entry = get_plot_details_new(&pInfo, time, &mb);
+	entry = get_plot_details_new(&pInfo, time, NULL);
 
 	tissues.fill();
 	painter.setPen(QColor(0, 0, 0, 0));
@@ -268,7 +270,13 @@ void ToolTipItem::refresh(const QPointF &pos)
 		for (int i=0; i<16; i++) {
 			painter.drawLine(i, 60, i, 60 - entry->percentages[i] / 2);
 		}
-		entryToolTip.second->setText(QString::fromUtf8(mb.buffer, mb.len));
+		QString &description = entryDescriptions[entry - pInfo.entry];
+		if (description.isEmpty()) {
+			mb.len = 0;
+			plot_string(&pInfo, entry, &mb);
+			description = QString::fromUtf8(mb.buffer, mb.len);
+		}
+		entryToolTip.second->setText(description);
 	}
 	entryToolTip.first->setPixmap(tissues);
 
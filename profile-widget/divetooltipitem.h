@@ -59,6 +59,7 @@ private:
 	QRectF nextRectangle;
 	DiveCartesianAxis *timeAxis;
 	plot_info pInfo;
+	QVector<QString> entryDescriptions; // cache of the formatted plot entries, indexed like pInfo.entry
 	int lastTime;
 	QTime refreshTime;
 	QList<QGraphicsItem*> oldSelection;
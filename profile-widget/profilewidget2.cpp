@@ -39,6 +39,9 @@
 #include <QWheelEvent>
 #include <QMenu>
 #include <QElapsedTimer>
+#ifndef SUBSURFACE_MOBILE
+#include <QOpenGLWidget>
+#endif
 
 #ifndef QT_NO_DEBUG
 #include <QTableView>
@@ -536,7 +539,32 @@ void ProfileWidget2::setupSceneAndFlags()
 	setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
 	setMouseTracking(true);
 	background->setFlag(QGraphicsItem::ItemIgnoresTransformations);
+#ifndef SUBSURFACE_MOBILE
+	setupViewport();
+	connect(qPrefDisplay::instance(), &qPrefDisplay::opengl_profileChanged, this, &ProfileWidget2::setupViewport);
+#endif
+}
+
+#ifndef SUBSURFACE_MOBILE
+// With an OpenGL viewport the polygons, lines and text of the scene are
+// batched and rasterized by the GPU instead of being painted in software
+// on every animation frame, zoom step and planner handle move.
+void ProfileWidget2::setupViewport()
+{
+	if (qPrefDisplay::opengl_profile()) {
+		QOpenGLWidget *glViewport = new QOpenGLWidget;
+		QSurfaceFormat format = glViewport->format();
+		format.setSamples(4); // antialiasing is done by multisampling
+		glViewport->setFormat(format);
+		setViewport(glViewport);
+		// OpenGL viewports can't do partial updates
+		setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+	} else if (qobject_cast<QOpenGLWidget *>(viewport())) {
+		setViewport(new QWidget);
+		setViewportUpdateMode(QGraphicsView::BoundingRectViewportUpdate);
+	}
 }
+#endif
 
 void ProfileWidget2::resetZoom()
 {
@@ -1000,6 +1028,7 @@ void ProfileWidget2::scale(qreal sx, qreal sy)
 
 	// Since we created new duration lines, we have to update the order in which the thumbnails is painted.
 	updateThumbnailPaintOrder();
+	updateThumbnailPriorities();
 #endif
 }
 
@@ -1059,6 +1088,9 @@ void ProfileWidget2::scrollViewTo(const QPoint &pos)
 	const qreal xRat = (qreal)pos.x() / viewport()->width();
 	vs->setValue(lrint(yRat * vs->maximum()));
 	hs->setValue(lrint(xRat * hs->maximum()));
+#ifndef SUBSURFACE_MOBILE
+	updateThumbnailPriorities();
+#endif
 }
 
 void ProfileWidget2::mouseMoveEvent(QMouseEvent *event)
@@ -2119,8 +2151,12 @@ void ProfileWidget2::updateDurationLine(PictureEntry &e)
 
 // This function is called asynchronously by the thumbnailer if a thumbnail
 // was fetched from disk or freshly calculated.
-void ProfileWidget2::updateThumbnail(QString filename, QImage thumbnail, duration_t duration)
+void ProfileWidget2::updateThumbnail(QString filename, QImage thumbnail, duration_t duration, int level)
 {
+	// The profile only shows thumbnails of the default size.
+	if (level != Thumbnailer::thumbnailLevel(Thumbnailer::defaultThumbnailSize()))
+		return;
+
 	// Find the picture with the given filename
 	auto it = std::find_if(pictures.begin(), pictures.end(), [&filename](const PictureEntry &e)
 			       { return e.filename == filename; });
@@ -2151,7 +2187,8 @@ ProfileWidget2::PictureEntry::PictureEntry(offset_t offsetIn, const QString &fil
 	int size = Thumbnailer::defaultThumbnailSize();
 	scene->addItem(thumbnail.get());
 	thumbnail->setVisible(prefs.show_pictures_in_profile);
-	QImage img = Thumbnailer::instance()->fetchThumbnail(filename, synchronous).scaled(size, size, Qt::KeepAspectRatio);
+	Thumbnailer::Priority priority = prefs.show_pictures_in_profile ? Thumbnailer::PriorityVisible : Thumbnailer::PriorityPrefetch;
+	QImage img = Thumbnailer::instance()->fetchThumbnail(filename, synchronous, size, priority).scaled(size, size, Qt::KeepAspectRatio);
 	thumbnail->setPixmap(QPixmap::fromImage(img));
 	thumbnail->setFileUrl(filename);
 }
@@ -2245,6 +2282,25 @@ void ProfileWidget2::plotPicturesInternal(const struct dive *d, bool synchronous
 	for (PictureEntry &e: pictures)
 		updateThumbnailXPos(e);
 	calculatePictureYPositions();
+	updateThumbnailPriorities();
+}
+
+// When zoomed in, calculate the thumbnails in the shown part of the profile first.
+void ProfileWidget2::updateThumbnailPriorities()
+{
+	if (!prefs.show_pictures_in_profile || pictures.empty())
+		return;
+	QRectF area = mapToScene(viewport()->rect()).boundingRect();
+	QVector<QString> visible, hidden;
+	for (const PictureEntry &e: pictures) {
+		if (e.thumbnail->sceneBoundingRect().intersects(area))
+			visible.push_back(e.filename);
+		else
+			hidden.push_back(e.filename);
+	}
+	int size = Thumbnailer::defaultThumbnailSize();
+	Thumbnailer::instance()->setPriority(hidden, size, Thumbnailer::PriorityAdjacent);
+	Thumbnailer::instance()->setPriority(visible, size, Thumbnailer::PriorityVisible);
 }
 
 // Remove the pictures with the given filenames from the profile plot.
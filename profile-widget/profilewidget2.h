@@ -130,7 +130,7 @@ slots: // Necessary to call from QAction's signals.
 	void splitCurrentDC();
 	void pointInserted(const QModelIndex &parent, int start, int end);
 	void pointsRemoved(const QModelIndex &, int start, int end);
-	void updateThumbnail(QString filename, QImage thumbnail, duration_t duration);
+	void updateThumbnail(QString filename, QImage thumbnail, duration_t duration, int level);
 
 	/* this is called for every move on the handlers. maybe we can speed up this a bit? */
 	void recreatePlannedDive();
@@ -166,6 +166,9 @@ private: /*methods*/
 	void fixBackgroundPos();
 	void scrollViewTo(const QPoint &pos);
 	void setupSceneAndFlags();
+#ifndef SUBSURFACE_MOBILE
+	void setupViewport();
+#endif
 	void setupItemSizes();
 	void addItemsToScene();
 	void setupItemOnScene();
@@ -251,6 +254,7 @@ private:
 	void calculatePictureYPositions();
 	void updateDurationLine(PictureEntry &e);
 	void updateThumbnailPaintOrder();
+	void updateThumbnailPriorities();
 
 	QList<DiveHandler *> handles;
 	void repositionDiveHandlers();
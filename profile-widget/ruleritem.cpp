@@ -40,18 +40,22 @@ void RulerNodeItem2::setRuler(RulerItem2 *r)
 void RulerNodeItem2::recalculate()
 {
 	struct plot_data *data = pInfo.entry + (pInfo.nr - 1);
-	uint16_t count = 0;
 	if (x() < 0) {
 		setPos(0, y());
 	} else if (x() > timeAxis->posAtValue(data->sec)) {
 		setPos(timeAxis->posAtValue(data->sec), depthAxis->posAtValue(data->depth));
 	} else {
-		data = pInfo.entry;
-		count = 0;
-		while (timeAxis->posAtValue(data->sec) < x() && count < pInfo.nr) {
-			data = pInfo.entry + count;
-			count++;
+		// The plot entries are sorted by time, therefore we can
+		// bisect for the first entry at or right of the node.
+		int low = 0, high = pInfo.nr - 1;
+		while (low < high) {
+			int mid = low + (high - low) / 2;
+			if (timeAxis->posAtValue(pInfo.entry[mid].sec) < x())
+				low = mid + 1;
+			else
+				high = mid;
 		}
+		data = pInfo.entry + low;
 		setPos(timeAxis->posAtValue(data->sec), depthAxis->posAtValue(data->depth));
 		entry = data;
 	}
@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "qt-models/divelistmodel.h"
+#include "core/fulltext.h"
 #include "core/qthelper.h"
 #include "core/trip.h"
 #include "core/settings/qPrefGeneral.h"
 #include <QDateTime>
+#include <algorithm>
 
 DiveListSortModel::DiveListSortModel(QObject *parent) : QSortFilterProxyModel(parent)
 {
@@ -20,10 +22,21 @@ void DiveListSortModel::updateFilterState()
 	bool includeNotes = qPrefGeneral::filterFullTextNotes();
 	Qt::CaseSensitivity cs = qPrefGeneral::filterCaseSensitive() ? Qt::CaseSensitive : Qt::CaseInsensitive;
 
+	// use the full text index to find the dives that can possibly match
+	int fields = FullTextIndex::PEOPLE | FullTextIndex::SUIT | FullTextIndex::LOCATION | FullTextIndex::TAGS;
+	if (includeNotes)
+		fields |= FullTextIndex::NOTES;
+	std::vector<dive *> candidates;
+	bool useIndex = FullTextIndex::instance()->findDives(fields, filterString, candidates);
+
 	// get the underlying model and re-calculate the filter value for each dive
 	DiveListModel *mySourceModel = qobject_cast<DiveListModel *>(sourceModel());
 	for (int i = 0; i < mySourceModel->rowCount(); i++) {
 		DiveObjectHelper *d = mySourceModel->at(i);
+		if (useIndex && !std::binary_search(candidates.begin(), candidates.end(), d->getDive())) {
+			d->getDive()->hidden_by_filter = true;
+			continue;
+		}
 		QString fullText = includeNotes? d->fullText() : d->fullTextNoNotes();
 		d->getDive()->hidden_by_filter = !fullText.contains(filterString, cs);
 	}
@@ -152,6 +165,7 @@ void DiveListModel::addDive(const QList<dive *> &listOfDives)
 	beginInsertRows(QModelIndex(), rowCount(), rowCount() + listOfDives.count() - 1);
 	for (dive *d: listOfDives) {
 		m_dives.append(new DiveObjectHelper(d));
+		FullTextIndex::instance()->addDive(d);
 	}
 	endInsertRows();
 }
@@ -171,12 +185,14 @@ void DiveListModel::insertDive(int i, DiveObjectHelper *newDive)
 {
 	beginInsertRows(QModelIndex(), i, i);
 	m_dives.insert(i, newDive);
+	FullTextIndex::instance()->addDive(newDive->getDive());
 	endInsertRows();
 }
 
 void DiveListModel::removeDive(int i)
 {
 	beginRemoveRows(QModelIndex(), i, i);
+	FullTextIndex::instance()->removeDive(m_dives.at(i)->getDive());
 	delete m_dives.at(i);
 	m_dives.removeAt(i);
 	endRemoveRows();
@@ -184,12 +200,9 @@ void DiveListModel::removeDive(int i)
 
 void DiveListModel::removeDiveById(int id)
 {
-	for (int i = 0; i < rowCount(); i++) {
-		if (m_dives.at(i)->id() == id) {
-			removeDive(i);
-			return;
-		}
-	}
+	int i = getDiveIdx(id);
+	if (i >= 0)
+		removeDive(i);
 }
 
 void DiveListModel::updateDive(int i, dive *d)
@@ -209,6 +222,7 @@ void DiveListModel::clear()
 		m_dives.clear();
 		endRemoveRows();
 	}
+	FullTextIndex::instance()->clear();
 }
 
 void DiveListModel::resetInternalData()
@@ -228,12 +242,16 @@ int DiveListModel::rowCount(const QModelIndex &) const
 
 int DiveListModel::getDiveIdx(int id) const
 {
-	int i;
-	for (i = 0; i < m_dives.count(); i++) {
-		if (m_dives.at(i)->id() == id)
-			return i;
-	}
-	return -1;
+	// The id index is not updated when dives are inserted or removed.
+	// Therefore, verify the hit and rebuild the index if it is outdated.
+	auto it = m_idIndex.constFind(id);
+	if (it != m_idIndex.cend() && *it < m_dives.count() && m_dives.at(*it)->id() == id)
+		return *it;
+	m_idIndex.clear();
+	m_idIndex.reserve(m_dives.count());
+	for (int i = m_dives.count() - 1; i >= 0; i--)	// in reverse, so that the first dive wins
+		m_idIndex.insert(m_dives.at(i)->id(), i);
+	return m_idIndex.value(id, -1);
 }
 
 QVariant DiveListModel::data(const QModelIndex &index, int role) const
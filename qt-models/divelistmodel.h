@@ -60,6 +60,7 @@ public:
 	Q_INVOKABLE DiveObjectHelper* at(int i);
 private:
 	QList<DiveObjectHelper*> m_dives;
+	mutable QHash<int, int> m_idIndex;	// dive id -> row, see getDiveIdx()
 	static DiveListModel *m_instance;
 };
 
@@ -15,7 +15,11 @@ DivePictureModel *DivePictureModel::instance()
 	return self;
 }
 
-DivePictureModel::DivePictureModel() : zoomLevel(0.0)
+DivePictureModel::DivePictureModel() : zoomLevel(0.0),
+	size(0),
+	level(0),
+	firstVisible(0),
+	lastVisible(-1)
 {
 	connect(Thumbnailer::instance(), &Thumbnailer::thumbnailChanged,
 		this, &DivePictureModel::updateThumbnail, Qt::QueuedConnection);
@@ -29,28 +33,109 @@ void DivePictureModel::setZoomLevel(int level)
 		zoomLevel = -1.0;
 	if (zoomLevel > 1.0)
 		zoomLevel = 1.0;
+	int oldSize = size;
+	int oldLevel = this->level;
 	updateZoom();
+
+	// If we need thumbnails of a different resolution, request them.
+	// In the meantime, the old thumbnails are scaled to the new size.
+	// Only cancel our own requests, the profile may want the same pictures.
+	if (this->level != oldLevel) {
+		cancelThumbnails(oldSize);
+		for (const PictureEntry &entry: pictures)
+			Thumbnailer::instance()->fetchThumbnail(entry.filename, false, size, Thumbnailer::PriorityPrefetch);
+		updatePriorities(0, -1);
+	}
 	layoutChanged();
 }
 
 void DivePictureModel::updateZoom()
 {
 	size = Thumbnailer::thumbnailSize(zoomLevel);
+	level = Thumbnailer::thumbnailLevel(size);
 }
 
 void DivePictureModel::updateThumbnails()
 {
 	updateZoom();
-	for (PictureEntry &entry: pictures)
-		entry.image = Thumbnailer::instance()->fetchThumbnail(entry.filename, false);
+	for (PictureEntry &entry: pictures) {
+		entry.image = Thumbnailer::instance()->fetchThumbnail(entry.filename, false, size, Thumbnailer::PriorityPrefetch);
+		entry.scaledSize = 0;
+	}
+	updatePriorities(0, -1);
+}
+
+void DivePictureModel::setVisibleRows(int first, int last)
+{
+	if (first == firstVisible && last == lastVisible)
+		return;
+	int oldFirst = firstVisible;
+	int oldLast = lastVisible;
+	firstVisible = first;
+	lastVisible = last;
+	updatePriorities(oldFirst, oldLast);
+}
+
+// Fetch the thumbnails of the shown rows first, then the thumbnails of
+// one screen before and after, then the rest.
+static Thumbnailer::Priority rowPriority(int row, int first, int last)
+{
+	int count = last - first + 1;
+	if (count <= 0)
+		return Thumbnailer::PriorityPrefetch;
+	if (row >= first && row <= last)
+		return Thumbnailer::PriorityVisible;
+	if (row >= first - count && row <= last + count)
+		return Thumbnailer::PriorityAdjacent;
+	return Thumbnailer::PriorityPrefetch;
+}
+
+// Change the priority of the rows whose priority differs from when the rows
+// oldFirst to oldLast were shown. Only rows that are shown or adjacent before
+// or after the change are concerned, the others stay at prefetching.
+void DivePictureModel::updatePriorities(int oldFirst, int oldLast)
+{
+	QVector<QString> byPriority[Thumbnailer::PriorityBackground];
+	auto update = [&](int from, int to, int skipFrom, int skipTo) {
+		from = std::max(from, 0);
+		to = std::min(to, pictures.size() - 1);
+		for (int i = from; i <= to; ++i) {
+			if (i >= skipFrom && i <= skipTo)
+				continue;
+			Thumbnailer::Priority priority = rowPriority(i, firstVisible, lastVisible);
+			if (priority != rowPriority(i, oldFirst, oldLast))
+				byPriority[priority].push_back(pictures[i].filename);
+		}
+	};
+	int count = lastVisible - firstVisible + 1;
+	int oldCount = oldLast - oldFirst + 1;
+	int from = count > 0 ? firstVisible - count : 0;
+	int to = count > 0 ? lastVisible + count : -1;
+	update(from, to, 0, -1);
+	if (oldCount > 0)
+		update(oldFirst - oldCount, oldLast + oldCount, from, to);
+
+	Thumbnailer *thumbnailer = Thumbnailer::instance();
+	thumbnailer->setPriority(byPriority[Thumbnailer::PriorityPrefetch], size, Thumbnailer::PriorityPrefetch);
+	thumbnailer->setPriority(byPriority[Thumbnailer::PriorityAdjacent], size, Thumbnailer::PriorityAdjacent);
+	thumbnailer->setPriority(byPriority[Thumbnailer::PriorityVisible], size, Thumbnailer::PriorityVisible);
+}
+
+void DivePictureModel::cancelThumbnails(int size)
+{
+	QVector<QString> filenames;
+	filenames.reserve(pictures.size());
+	for (const PictureEntry &entry: pictures)
+		filenames.push_back(entry.filename);
+	Thumbnailer::instance()->cancelThumbnails(filenames, size);
 }
 
 void DivePictureModel::updateDivePictures()
 {
 	beginResetModel();
 	if (!pictures.isEmpty()) {
+		cancelThumbnails(size);
 		pictures.clear();
-		Thumbnailer::instance()->clearWorkQueue();
 	}
 
 	int i;
@@ -90,7 +175,13 @@ QVariant DivePictureModel::data(const QModelIndex &index, int role) const
 			ret = entry.filename;
 			break;
 		case Qt::DecorationRole:
-			ret = entry.image.scaled(size, size, Qt::KeepAspectRatio);
+			// Scaling is only done when the image or the size changed,
+			// not every time the view is painted.
+			if (entry.scaledSize != size) {
+				entry.scaledImage = entry.image.scaled(size, size, Qt::KeepAspectRatio);
+				entry.scaledSize = size;
+			}
+			ret = entry.scaledImage;
 			break;
 		case Qt::DisplayRole:
 			ret = QFileInfo(entry.filename).fileName();
@@ -183,10 +274,13 @@ static void addDurationToThumbnail(QImage &img, duration_t duration)
 		QStringLiteral("%1:%2").arg(seconds / 60, 2, 10, QChar('0'))
 				       .arg(seconds % 60, 2, 10, QChar('0'));
 
-	QFont font(system_divelist_default_font, 30);
+	// The font size is relative to the maximum thumbnail size,
+	// so that it looks the same for all thumbnail levels.
+	QSize imgSize = img.size();
+	int fontSize = std::max(30 * std::max(imgSize.width(), imgSize.height()) / Thumbnailer::maxThumbnailSize(), 6);
+	QFont font(system_divelist_default_font, fontSize);
 	QFontMetrics metrics(font);
 	QSize size = metrics.size(Qt::TextSingleLine, s);
-	QSize imgSize = img.size();
 	int x = imgSize.width() - size.width();
 	int y = imgSize.height() - size.height() + metrics.descent();
 	QPainter painter(&img);
@@ -198,8 +292,10 @@ static void addDurationToThumbnail(QImage &img, duration_t duration)
 	painter.drawText(x, imgSize.height(), s);
 }
 
-void DivePictureModel::updateThumbnail(QString filename, QImage thumbnail, duration_t duration)
+void DivePictureModel::updateThumbnail(QString filename, QImage thumbnail, duration_t duration, int levelIn)
 {
+	if (levelIn != level)
+		return;
 	int i = findPictureId(filename);
 	if (i >= 0) {
 		if (duration.seconds > 0) {
@@ -207,6 +303,7 @@ void DivePictureModel::updateThumbnail(QString filename, QImage thumbnail, durat
 			pictures[i].length = duration;
 		}
 		pictures[i].image = thumbnail;
+		pictures[i].scaledSize = 0;
 		emit dataChanged(createIndex(i, 0), createIndex(i, 1));
 	}
 }
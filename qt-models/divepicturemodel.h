@@ -15,6 +15,8 @@ struct PictureEntry {
 	QImage image;
 	int offsetSeconds;
 	duration_t length;
+	mutable QImage scaledImage;	// image scaled to the display size, calculated on demand
+	mutable int scaledSize;		// display size of scaledImage, 0 if not calculated
 };
 
 class DivePictureModel : public QAbstractTableModel {
@@ -27,19 +29,25 @@ public:
 	void updateDivePictures();
 	void removePictures(const QVector<QString> &fileUrls);
 	void updateDivePictureOffset(int diveId, const QString &filename, int offsetSeconds);
+	// Called by the view to get the thumbnails of the shown rows first.
+	void setVisibleRows(int first, int last);
 signals:
 	void picturesRemoved(const QVector<QString> &fileUrls);
 public slots:
 	void setZoomLevel(int level);
-	void updateThumbnail(QString filename, QImage thumbnail, duration_t duration);
+	void updateThumbnail(QString filename, QImage thumbnail, duration_t duration, int level);
 private:
 	DivePictureModel();
 	QVector<PictureEntry> pictures;
 	int findPictureId(const QString &filename);	// Return -1 if not found
 	double zoomLevel;	// -1.0: minimum, 0.0: standard, 1.0: maximum
 	int size;
+	int level;		// thumbnail level that is requested from the Thumbnailer
+	int firstVisible, lastVisible;	// rows shown by the view
 	void updateThumbnails();
+	void updatePriorities(int oldFirst, int oldLast);	// pass 0, -1 if all rows are at prefetch priority
 	void updateZoom();
+	void cancelThumbnails(int size);
 };
 
 #endif
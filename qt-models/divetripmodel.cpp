@@ -2,6 +2,7 @@
 #include "qt-models/divetripmodel.h"
 #include "qt-models/filtermodels.h"
 #include "core/gettextfromc.h"
+#include "core/divesite.h"
 #include "core/metrics.h"
 #include "core/trip.h"
 #include "core/qthelper.h"
@@ -133,55 +134,69 @@ static QString displayWeight(const struct dive *d, bool units)
 		return s + gettextFromC::tr("lbs");
 }
 
-QVariant DiveTripModelBase::diveData(const struct dive *d, int column, int role)
+static QVariant displayData(const struct dive *d, int column)
+{
+	switch (column) {
+	case DiveTripModelBase::NR:
+		return d->number;
+	case DiveTripModelBase::DATE:
+		return get_dive_date_string(d->when);
+	case DiveTripModelBase::DEPTH:
+		return get_depth_string(d->maxdepth, prefs.units.show_units_table);
+	case DiveTripModelBase::DURATION:
+		return displayDuration(d);
+	case DiveTripModelBase::TEMPERATURE:
+		return displayTemperature(d, prefs.units.show_units_table);
+	case DiveTripModelBase::TOTALWEIGHT:
+		return displayWeight(d, prefs.units.show_units_table);
+	case DiveTripModelBase::SUIT:
+		return QString(d->suit);
+	case DiveTripModelBase::CYLINDER:
+		return QString(d->cylinder[0].type.description);
+	case DiveTripModelBase::SAC:
+		return displaySac(d, prefs.units.show_units_table);
+	case DiveTripModelBase::OTU:
+		return d->otu;
+	case DiveTripModelBase::MAXCNS:
+		if (prefs.units.show_units_table)
+			return QString("%1%").arg(d->maxcns);
+		else
+			return d->maxcns;
+	case DiveTripModelBase::TAGS:
+		return get_taglist_string(d->tag_list);
+	case DiveTripModelBase::PHOTOS:
+		break;
+	case DiveTripModelBase::COUNTRY:
+		return QString(get_dive_country(d));
+	case DiveTripModelBase::BUDDIES:
+		return QString(d->buddy);
+	case DiveTripModelBase::LOCATION:
+		return QString(get_dive_location(d));
+	case DiveTripModelBase::GAS:
+		char *gas_string = get_dive_gas_string(d);
+		QString ret(gas_string);
+		free(gas_string);
+		return ret;
+	}
+	return QVariant();
+}
+
+QVariant DiveTripModelBase::diveData(const struct dive *d, int column, int role) const
 {
 	switch (role) {
 	case Qt::TextAlignmentRole:
 		return dive_table_alignment(column);
-	case Qt::DisplayRole:
-		switch (column) {
-		case NR:
-			return d->number;
-		case DATE:
-			return get_dive_date_string(d->when);
-		case DEPTH:
-			return get_depth_string(d->maxdepth, prefs.units.show_units_table);
-		case DURATION:
-			return displayDuration(d);
-		case TEMPERATURE:
-			return displayTemperature(d, prefs.units.show_units_table);
-		case TOTALWEIGHT:
-			return displayWeight(d, prefs.units.show_units_table);
-		case SUIT:
-			return QString(d->suit);
-		case CYLINDER:
-			return QString(d->cylinder[0].type.description);
-		case SAC:
-			return displaySac(d, prefs.units.show_units_table);
-		case OTU:
-			return d->otu;
-		case MAXCNS:
-			if (prefs.units.show_units_table)
-				return QString("%1%").arg(d->maxcns);
-			else
-				return d->maxcns;
-		case TAGS:
-			return get_taglist_string(d->tag_list);
-		case PHOTOS:
-			break;
-		case COUNTRY:
-			return QString(get_dive_country(d));
-		case BUDDIES:
-			return QString(d->buddy);
-		case LOCATION:
-			return QString(get_dive_location(d));
-		case GAS:
-			char *gas_string = get_dive_gas_string(d);
-			QString ret(gas_string);
-			free(gas_string);
-			return ret;
+	case Qt::DisplayRole: {
+		if (column < 0 || column >= COLUMNS)
+			return QVariant();
+		CachedRow &row = cache[d];
+		uint32_t bit = 1u << column;
+		if (!(row.displayValid & bit)) {
+			row.display[column] = displayData(d, column);
+			row.displayValid |= bit;
 		}
-		break;
+		return row.display[column];
+	}
 	case Qt::DecorationRole:
 		switch (column) {
 		//TODO: ADD A FLAG
@@ -370,8 +385,196 @@ void DiveTripModelBase::resetModel(DiveTripModelBase::Layout layout)
 		currentModel.reset(new DiveTripModelList);
 }
 
-DiveTripModelBase::DiveTripModelBase(QObject *parent) : QAbstractItemModel(parent)
+DiveTripModelBase::DiveTripModelBase(QObject *parent) : QAbstractItemModel(parent),
+	resetPending(false)
+{
+	// These are connected before the slots of the derived classes, so that
+	// the cache is up to date when they send their change notifications.
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &DiveTripModelBase::cacheDivesDeleted);
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &DiveTripModelBase::cacheDivesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &DiveTripModelBase::cacheDivesTimeChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveTripModelBase::cacheCylindersReset);
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &DiveTripModelBase::cacheWeightsystemsReset);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &DiveTripModelBase::cacheDiveSiteChanged);
+	connect(&diveListNotifier, &DiveListNotifier::batchFinished, this, &DiveTripModelBase::batchFinished);
+}
+
+bool DiveTripModelBase::deferToBatch()
+{
+	if (!diveListNotifier.inBatch())
+		return false;
+	resetPending = true;
+	return true;
+}
+
+void DiveTripModelBase::batchFinished()
+{
+	if (!resetPending)
+		return;
+	resetPending = false;
+	beginResetModel();
+	populate();
+	endResetModel();
+}
+
+static uint32_t columnBit(int column)
+{
+	return 1u << column;
+}
+
+void DiveTripModelBase::clearCache()
+{
+	cache.clear();
+}
+
+void DiveTripModelBase::invalidateColumns(const QVector<dive *> &dives, uint32_t columns)
+{
+	for (dive *d: dives) {
+		auto it = cache.find(d);
+		if (it == cache.end())
+			continue;
+		it->second.displayValid &= ~columns;
+		it->second.sortValid &= ~columns;
+	}
+}
+
+void DiveTripModelBase::cacheDivesDeleted(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	// The dives might be freed, so that the pointers could be reused
+	for (dive *d: dives)
+		cache.erase(d);
+}
+
+// Columns that are calculated from the profile and the gases, i.e. that
+// change with the depth, the duration and the cylinders of a dive.
+static const uint32_t derivedColumns = columnBit(DiveTripModelBase::SAC) | columnBit(DiveTripModelBase::OTU) |
+				       columnBit(DiveTripModelBase::MAXCNS);
+
+void DiveTripModelBase::cacheDivesChanged(const QVector<dive *> &dives, DiveField field)
+{
+	switch (field) {
+	case DiveField::NR:
+		invalidateColumns(dives, columnBit(NR));
+		break;
+	case DiveField::DATETIME:
+		invalidateColumns(dives, columnBit(DATE));
+		break;
+	case DiveField::DEPTH:
+		invalidateColumns(dives, columnBit(DEPTH) | derivedColumns);
+		break;
+	case DiveField::DURATION:
+		invalidateColumns(dives, columnBit(DURATION) | derivedColumns);
+		break;
+	case DiveField::WATER_TEMP:
+		invalidateColumns(dives, columnBit(TEMPERATURE));
+		break;
+	case DiveField::DIVESITE:
+		invalidateColumns(dives, columnBit(COUNTRY) | columnBit(LOCATION));
+		break;
+	case DiveField::BUDDY:
+		invalidateColumns(dives, columnBit(BUDDIES));
+		break;
+	case DiveField::RATING:
+		invalidateColumns(dives, columnBit(RATING));
+		break;
+	case DiveField::SUIT:
+		invalidateColumns(dives, columnBit(SUIT));
+		break;
+	case DiveField::TAGS:
+		invalidateColumns(dives, columnBit(TAGS));
+		break;
+	case DiveField::ATM_PRESS:
+		// The SAC is calculated from the surface pressure
+		invalidateColumns(dives, columnBit(SAC));
+		break;
+	case DiveField::AIR_TEMP:
+	case DiveField::DIVEMASTER:
+	case DiveField::VISIBILITY:
+	case DiveField::NOTES:
+		// Not shown in the dive list
+		break;
+	default:
+		// E.g. the dive mode changes the duration display. Be conservative.
+		invalidateColumns(dives, ~0u);
+		break;
+	}
+}
+
+void DiveTripModelBase::cacheDivesTimeChanged(timestamp_t, const QVector<dive *> &dives)
+{
+	invalidateColumns(dives, columnBit(DATE));
+}
+
+void DiveTripModelBase::cacheCylindersReset(const QVector<dive *> &dives)
+{
+	invalidateColumns(dives, columnBit(CYLINDER) | columnBit(GAS) | derivedColumns);
+}
+
+void DiveTripModelBase::cacheWeightsystemsReset(const QVector<dive *> &dives)
+{
+	invalidateColumns(dives, columnBit(TOTALWEIGHT));
+}
+
+void DiveTripModelBase::cacheDiveSiteChanged(dive_site *ds, int)
+{
+	QVector<dive *> dives;
+	for (int i = 0; i < ds->dives.nr; ++i)
+		dives.push_back(ds->dives.dives[i]);
+	invalidateColumns(dives, columnBit(COUNTRY) | columnBit(LOCATION));
+}
+
+int DiveTripModelBase::diveSortNumber(const struct dive *d, int column) const
 {
+	CachedRow &row = cache[d];
+	uint32_t bit = columnBit(column);
+	if (!(row.sortValid & bit)) {
+		switch (column) {
+		case TOTALWEIGHT:
+			row.sortNumber[column] = total_weight(d);
+			break;
+		case GAS:
+			row.sortNumber[column] = nitrox_sort_value(d);
+			break;
+		default:
+			row.sortNumber[column] = 0;
+			break;
+		}
+		row.sortValid |= bit;
+	}
+	return row.sortNumber[column];
+}
+
+const QString &DiveTripModelBase::diveSortString(const struct dive *d, int column) const
+{
+	CachedRow &row = cache[d];
+	uint32_t bit = columnBit(column);
+	if (!(row.sortValid & bit)) {
+		switch (column) {
+		case SUIT:
+			row.sortString[column] = QString(d->suit);
+			break;
+		case CYLINDER:
+			row.sortString[column] = QString(d->cylinder[0].type.description);
+			break;
+		case TAGS:
+			row.sortString[column] = get_taglist_string(d->tag_list);
+			break;
+		case COUNTRY:
+			row.sortString[column] = QString(get_dive_country(d));
+			break;
+		case BUDDIES:
+			row.sortString[column] = QString(d->buddy);
+			break;
+		case LOCATION:
+			row.sortString[column] = QString(get_dive_location(d));
+			break;
+		default:
+			row.sortString[column].clear();
+			break;
+		}
+		row.sortValid |= bit;
+	}
+	return row.sortString[column];
 }
 
 int DiveTripModelBase::columnCount(const QModelIndex&) const
@@ -553,7 +756,12 @@ DiveTripModelTree::DiveTripModelTree(QObject *parent) : DiveTripModelBase(parent
 	connect(&diveListNotifier, &DiveListNotifier::divesSelected, this, &DiveTripModelTree::divesSelected);
 	connect(&diveListNotifier, &DiveListNotifier::tripChanged, this, &DiveTripModelTree::tripChanged);
 
-	// Fill model
+	populate();
+}
+
+void DiveTripModelTree::populate()
+{
+	items.clear();
 	for (int i = 0; i < dive_table.nr ; ++i) {
 		dive *d = get_dive(i);
 		update_cylinder_related_info(d);
@@ -575,6 +783,7 @@ DiveTripModelTree::DiveTripModelTree(QObject *parent) : DiveTripModelBase(parent
 		} else {
 			// We found the trip -> simply add the dive
 			it->dives.push_back(d);
+			it->shown |= !d->hidden_by_filter;
 		}
 	}
 }
@@ -824,6 +1033,8 @@ bool DiveTripModelTree::dive_before_entry(const dive *d, const Item &entry)
 
 void DiveTripModelTree::divesAdded(dive_trip *trip, bool addTrip, const QVector<dive *> &dives)
 {
+	if (deferToBatch())
+		return;
 	if (!trip) {
 		// This is outside of a trip. Add dives at the top-level in batches.
 		addInBatches(items, dives,
@@ -857,6 +1068,8 @@ void DiveTripModelTree::divesAdded(dive_trip *trip, bool addTrip, const QVector<
 
 void DiveTripModelTree::divesDeleted(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives)
 {
+	if (deferToBatch())
+		return;
 	if (!trip) {
 		// This is outside of a trip. Delete top-level dives in batches.
 		processRangesZip(items, dives,
@@ -930,6 +1143,12 @@ void processByTrip(QVector<dive *> dives, Function action)
 
 void DiveTripModelTree::divesChanged(const QVector<dive *> &dives)
 {
+	if (deferToBatch()) {
+		// The filter flags are still updated, since the reload doesn't do that.
+		for (dive *d: dives)
+			MultiFilterSortModel::instance()->updateDive(d);
+		return;
+	}
 	processByTrip(dives, [this] (dive_trip *trip, const QVector<dive *> &divesInTrip)
 		      { divesChangedTrip(trip, divesInTrip); });
 }
@@ -985,6 +1204,8 @@ void DiveTripModelTree::divesChangedTrip(dive_trip *trip, const QVector<dive *>
 
 void DiveTripModelTree::tripChanged(dive_trip *trip, TripField)
 {
+	if (deferToBatch())
+		return;
 	int idx = findTripIdx(trip);
 	if (idx < 0) {
 		// We don't know the trip - this shouldn't happen. We seem to have
@@ -1008,6 +1229,8 @@ static QVector<dive *> filterSelectedDives(const QVector<dive *> &dives)
 
 void DiveTripModelTree::divesMovedBetweenTrips(dive_trip *from, dive_trip *to, bool deleteFrom, bool createTo, const QVector<dive *> &dives)
 {
+	if (deferToBatch())
+		return;
 	// Move dives between trips. This is an "interesting" problem, as we might
 	// move from trip to trip, from trip to top-level or from top-level to trip.
 	// Moreover, we might have to add a trip first or delete an old trip.
@@ -1029,6 +1252,8 @@ void DiveTripModelTree::divesMovedBetweenTrips(dive_trip *from, dive_trip *to, b
 
 void DiveTripModelTree::divesTimeChanged(timestamp_t delta, const QVector<dive *> &dives)
 {
+	if (deferToBatch())
+		return;
 	processByTrip(dives, [this, delta] (dive_trip *trip, const QVector<dive *> &divesInTrip)
 		      { divesTimeChangedTrip(trip, delta, divesInTrip); });
 }
@@ -1136,14 +1361,36 @@ void DiveTripModelTree::divesSelectedTrip(dive_trip *trip, const QVector<dive *>
 	}
 }
 
-void DiveTripModelTree::filterFinished()
+void DiveTripModelTree::filterFinished(const std::vector<dive *> &changedIn)
 {
-	// If the filter finished, update all trip items to show the correct number of displayed dives
-	// in each trip. Without doing this, only trip headers of expanded trips were updated.
+	// If the filter finished, update the cached shown flags of the top-level items.
+	// Trips containing changed dives have to be updated to show the correct number
+	// of displayed dives. Without doing this, only trip headers of expanded trips
+	// were updated. Consecutive changed items are sent in one signal.
+	std::vector<dive *> changed = changedIn;
+	std::sort(changed.begin(), changed.end());
+	auto isChanged = [&changed](dive *d) { return std::binary_search(changed.begin(), changed.end(), d); };
+
+	int from = -1;
 	for (int idx = 0; idx < (int)items.size(); ++idx) {
-		QModelIndex tripIndex = createIndex(idx, 0, noParent);
-		dataChanged(tripIndex, tripIndex);
+		Item &item = items[idx];
+		bool itemChanged;
+		if (dive *d = item.getDive()) {
+			item.shown = !d->hidden_by_filter;
+			itemChanged = isChanged(d);
+		} else {
+			item.shown = std::any_of(item.dives.begin(), item.dives.end(), [](dive *d) { return !d->hidden_by_filter; });
+			itemChanged = std::any_of(item.dives.begin(), item.dives.end(), isChanged);
+		}
+		if (itemChanged && from < 0) {
+			from = idx;
+		} else if (!itemChanged && from >= 0) {
+			dataChanged(createIndex(from, 0, noParent), createIndex(idx - 1, 0, noParent));
+			from = -1;
+		}
 	}
+	if (from >= 0)
+		dataChanged(createIndex(from, 0, noParent), createIndex((int)items.size() - 1, 0, noParent));
 }
 
 bool DiveTripModelTree::lessThan(const QModelIndex &i1, const QModelIndex &i2) const
@@ -1166,7 +1413,12 @@ DiveTripModelList::DiveTripModelList(QObject *parent) : DiveTripModelBase(parent
 	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &DiveTripModelList::divesTimeChanged);
 	connect(&diveListNotifier, &DiveListNotifier::divesSelected, this, &DiveTripModelList::divesSelected);
 
-	// Fill model
+	populate();
+}
+
+void DiveTripModelList::populate()
+{
+	items.clear();
 	items.reserve(dive_table.nr);
 	for (int i = 0; i < dive_table.nr ; ++i)
 		items.push_back(get_dive(i));
@@ -1224,6 +1476,8 @@ QVariant DiveTripModelList::data(const QModelIndex &index, int role) const
 
 void DiveTripModelList::divesAdded(dive_trip *, bool, const QVector<dive *> &divesIn)
 {
+	if (deferToBatch())
+		return;
 	QVector<dive *> dives = divesIn;
 	std::sort(dives.begin(), dives.end(), dive_less_than);
 	addInBatches(items, dives,
@@ -1237,6 +1491,8 @@ void DiveTripModelList::divesAdded(dive_trip *, bool, const QVector<dive *> &div
 
 void DiveTripModelList::divesDeleted(dive_trip *, bool, const QVector<dive *> &divesIn)
 {
+	if (deferToBatch())
+		return;
 	QVector<dive *> dives = divesIn;
 	std::sort(dives.begin(), dives.end(), dive_less_than);
 	processRangesZip(items, dives,
@@ -1258,6 +1514,8 @@ void DiveTripModelList::divesChanged(const QVector<dive *> &divesIn)
 	// recieving the signals below.
 	for (dive *d: dives)
 		MultiFilterSortModel::instance()->updateDive(d);
+	if (deferToBatch())
+		return;
 
 	// Since we know that the dive list is sorted, we will only ever search for the first element
 	// in dives as this must be the first that we encounter. Once we find a range, increase the
@@ -1273,6 +1531,8 @@ void DiveTripModelList::divesChanged(const QVector<dive *> &divesIn)
 
 void DiveTripModelList::divesTimeChanged(timestamp_t delta, const QVector<dive *> &divesIn)
 {
+	if (deferToBatch())
+		return;
 	QVector<dive *> dives = divesIn;
 	std::sort(dives.begin(), dives.end(), dive_less_than);
 
@@ -1318,7 +1578,7 @@ void DiveTripModelList::divesSelected(const QVector<dive *> &dives, dive *curren
 	emit newCurrentDive(createIndex(it - items.begin(), 0));
 }
 
-void DiveTripModelList::filterFinished()
+void DiveTripModelList::filterFinished(const std::vector<dive *> &)
 {
 	// In list mode, we don't have to change anything after filter finished.
 }
@@ -1333,13 +1593,13 @@ static bool lessThanHelper(int diff1, int diff2)
 	return diff1 < 0 || (diff1 == 0 && diff2 < 0);
 }
 
-static int strCmp(const char *s1, const char *s2)
+static int strCmp(const QString &s1, const QString &s2)
 {
-	if (!s1)
-		return !s2 ? 0 : -1;
-	if (!s2)
+	if (s1.isEmpty())
+		return s2.isEmpty() ? 0 : -1;
+	if (s2.isEmpty())
 		return 1;
-	return QString::localeAwareCompare(QString(s1), QString(s2)); // TODO: avoid copy
+	return QString::localeAwareCompare(s1, s2);
 }
 
 bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) const
@@ -1353,7 +1613,8 @@ bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) c
 	const dive *d2 = items[row2];
 	// This is used as a second sort criterion: For equal values, sorting is chronologically *descending*.
 	int row_diff = row2 - row1;
-	switch (i1.column()) {
+	int column = i1.column();
+	switch (column) {
 	case NR:
 	case DATE:
 	default:
@@ -1367,34 +1628,23 @@ bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) c
 	case TEMPERATURE:
 		return lessThanHelper(d1->watertemp.mkelvin - d2->watertemp.mkelvin, row_diff);
 	case TOTALWEIGHT:
-		return lessThanHelper(total_weight(d1) - total_weight(d2), row_diff);
+	case GAS:
+		return lessThanHelper(diveSortNumber(d1, column) - diveSortNumber(d2, column), row_diff);
+	case PHOTOS:
+		// There are no notifications for changed pictures, so this is not cached
+		return lessThanHelper(countPhotos(d1) - countPhotos(d2), row_diff);
 	case SUIT:
-		return lessThanHelper(strCmp(d1->suit, d2->suit), row_diff);
 	case CYLINDER:
-		return lessThanHelper(strCmp(d1->cylinder[0].type.description, d2->cylinder[0].type.description), row_diff);
-	case GAS:
-		return lessThanHelper(nitrox_sort_value(d1) - nitrox_sort_value(d2), row_diff);
+	case TAGS:
+	case COUNTRY:
+	case BUDDIES:
+	case LOCATION:
+		return lessThanHelper(strCmp(diveSortString(d1, column), diveSortString(d2, column)), row_diff);
 	case SAC:
 		return lessThanHelper(d1->sac - d2->sac, row_diff);
 	case OTU:
 		return lessThanHelper(d1->otu - d2->otu, row_diff);
 	case MAXCNS:
 		return lessThanHelper(d1->maxcns - d2->maxcns, row_diff);
-	case TAGS: {
-		char *s1 = taglist_get_tagstring(d1->tag_list);
-		char *s2 = taglist_get_tagstring(d2->tag_list);
-		int diff = strCmp(s1, s2);
-		free(s1);
-		free(s2);
-		return lessThanHelper(diff, row_diff);
-	}
-	case PHOTOS:
-		return lessThanHelper(countPhotos(d1) - countPhotos(d2), row_diff);
-	case COUNTRY:
-		return lessThanHelper(strCmp(get_dive_country(d1), get_dive_country(d2)), row_diff);
-	case BUDDIES:
-		return lessThanHelper(strCmp(d1->buddy, d2->buddy), row_diff);
-	case LOCATION:
-		return lessThanHelper(strCmp(get_dive_location(d1), get_dive_location(d2)), row_diff);
 	}
 }
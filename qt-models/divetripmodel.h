@@ -5,6 +5,7 @@
 #include "core/dive.h"
 #include "core/subsurface-qt/DiveListNotifier.h"
 #include <QAbstractItemModel>
+#include <unordered_map>
 
 // There are two different representations of the dive list:
 // 1) Tree view: two-level model where dives are grouped by trips
@@ -74,13 +75,18 @@ public:
 	bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
 	DiveTripModelBase(QObject *parent = 0);
 	int columnCount(const QModelIndex&) const;
-	virtual void filterFinished() = 0;
+	// Called by the filter after it wrote the shown flags of all dives to the core.
+	// The argument contains the dives whose flag changed, in dive table order.
+	virtual void filterFinished(const std::vector<dive *> &changed) = 0;
 	virtual bool setShown(const QModelIndex &idx, bool shown) = 0;
 
 	// Used for sorting. This is a bit of a layering violation, as sorting should be performed
 	// by the higher-up QSortFilterProxyModel, but it makes things so much easier!
 	virtual bool lessThan(const QModelIndex &i1, const QModelIndex &i2) const = 0;
 
+	// Drop the cached display strings and sort keys, e.g. because the units changed.
+	void clearCache();
+
 signals:
 	// The propagation of selection changes is complex.
 	// The control flow of dive-selection goes:
@@ -93,10 +99,46 @@ signals:
 	void newCurrentDive(QModelIndex index);
 protected:
 	// Access trip and dive data
-	static QVariant diveData(const struct dive *d, int column, int role);
+	QVariant diveData(const struct dive *d, int column, int role) const;
 	static QVariant tripData(const dive_trip *trip, int column, int role);
 
+	// Sort keys of the columns that are not simple numeric fields of the dive
+	int diveSortNumber(const struct dive *d, int column) const;
+	const QString &diveSortString(const struct dive *d, int column) const;
+
 	virtual dive *diveOrNull(const QModelIndex &index) const = 0;	// Returns a dive if this index represents a dive, null otherwise
+
+	// Fill the model from the dive table. Called when a batch of changes is finished.
+	virtual void populate() = 0;
+
+	// Called by the slots that change the layout of the model. If a batch is
+	// in progress, the change is not applied, but the model is reloaded
+	// once the batch is finished. Returns true if the change was deferred.
+	bool deferToBatch();
+private slots:
+	void batchFinished();
+	void cacheDivesDeleted(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
+	void cacheDivesChanged(const QVector<dive *> &dives, DiveField field);
+	void cacheDivesTimeChanged(timestamp_t delta, const QVector<dive *> &dives);
+	void cacheCylindersReset(const QVector<dive *> &dives);
+	void cacheWeightsystemsReset(const QVector<dive *> &dives);
+	void cacheDiveSiteChanged(dive_site *ds, int field);
+private:
+	// Formatting the columns is expensive, therefore the display strings and
+	// the sort keys of a dive are calculated when first accessed. Since only
+	// the visible rows are ever displayed, only these are formatted. The
+	// entries are invalidated per column when the DiveListNotifier reports
+	// a change. Columns are represented by bits in the valid-masks.
+	struct CachedRow {
+		uint32_t displayValid = 0;
+		uint32_t sortValid = 0;
+		QVariant display[COLUMNS];
+		int sortNumber[COLUMNS];
+		QString sortString[COLUMNS];
+	};
+	void invalidateColumns(const QVector<dive *> &dives, uint32_t columns);
+	mutable std::unordered_map<const dive *, CachedRow> cache;
+	bool resetPending;
 };
 
 class DiveTripModelTree : public DiveTripModelBase
@@ -118,12 +160,13 @@ private:
 	QModelIndex index(int row, int column, const QModelIndex &parent) const override;
 	QModelIndex parent(const QModelIndex &index) const override;
 	QVariant data(const QModelIndex &index, int role) const override;
-	void filterFinished() override;
+	void filterFinished(const std::vector<dive *> &changed) override;
 	bool lessThan(const QModelIndex &i1, const QModelIndex &i2) const override;
 	void divesSelectedTrip(dive_trip *trip, const QVector<dive *> &dives, QVector<QModelIndex> &);
 	dive *diveOrNull(const QModelIndex &index) const override;
 	bool setShown(const QModelIndex &idx, bool shown);
 	void divesChangedTrip(dive_trip *trip, const QVector<dive *> &dives);
+	void populate() override;
 	void divesTimeChangedTrip(dive_trip *trip, timestamp_t delta, const QVector<dive *> &dives);
 
 	// The tree model has two levels. At the top level, we have either trips or dives
@@ -183,10 +226,11 @@ private:
 	QModelIndex index(int row, int column, const QModelIndex &parent) const override;
 	QModelIndex parent(const QModelIndex &index) const override;
 	QVariant data(const QModelIndex &index, int role) const override;
-	void filterFinished() override;
+	void filterFinished(const std::vector<dive *> &changed) override;
 	bool lessThan(const QModelIndex &i1, const QModelIndex &i2) const override;
 	dive *diveOrNull(const QModelIndex &index) const override;
 	bool setShown(const QModelIndex &idx, bool shown);
+	void populate() override;
 
 	std::vector<dive *> items;				// TODO: access core data directly
 };
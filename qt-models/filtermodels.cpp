@@ -2,7 +2,10 @@
 #include "qt-models/filtermodels.h"
 #include "qt-models/models.h"
 #include "core/display.h"
+#include "core/divesummary.h"
+#include "core/fulltext.h"
 #include "core/qthelper.h"
+#include "core/statisticscache.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/subsurface-string.h"
@@ -15,90 +18,9 @@
 #endif
 
 #include <QDebug>
+#include <QtConcurrent>
 #include <algorithm>
 
-namespace {
-	// Check if a string-list contains at least one string containing the second argument.
-	// Comparison is non case sensitive and removes white space.
-	bool listContainsSuperstring(const QStringList &list, const QString &s)
-	{
-		return std::any_of(list.begin(), list.end(), [&s](const QString &s2)
-				   { return s2.trimmed().contains(s.trimmed(), Qt::CaseInsensitive); } );
-	}
-
-	// Check whether either all, any or none of the items of the first list is
-	// in the second list as a super string.
-	// The mode is controlled by the second argument
-	bool check(const QStringList &items, const QStringList &list, FilterData::Mode mode)
-	{
-		bool negate = mode == FilterData::Mode::NONE_OF;
-		bool any_of = mode == FilterData::Mode::ANY_OF;
-		auto fun = [&list, negate](const QString &item)
-			   { return listContainsSuperstring(list, item) != negate; };
-		return any_of ? std::any_of(items.begin(), items.end(), fun)
-			      : std::all_of(items.begin(), items.end(), fun);
-	}
-
-	bool hasTags(const QStringList &tags, const struct dive *d, FilterData::Mode mode)
-	{
-		if (tags.isEmpty())
-			return true;
-		QStringList dive_tags = get_taglist_string(d->tag_list).split(",");
-		dive_tags.append(gettextFromC::tr(divemode_text_ui[d->dc.divemode]));
-		return check(tags, dive_tags, mode);
-	}
-
-	bool hasPersons(const QStringList &people, const struct dive *d, FilterData::Mode mode)
-	{
-		if (people.isEmpty())
-			return true;
-		QStringList dive_people = QString(d->buddy).split(",", QString::SkipEmptyParts)
-			+ QString(d->divemaster).split(",", QString::SkipEmptyParts);
-		return check(people, dive_people, mode);
-	}
-
-	bool hasLocations(const QStringList &locations, const struct dive *d, FilterData::Mode mode)
-	{
-		if (locations.isEmpty())
-			return true;
-		QStringList diveLocations;
-		if (d->divetrip)
-			diveLocations.push_back(QString(d->divetrip->location));
-
-		if (d->dive_site)
-			diveLocations.push_back(QString(d->dive_site->name));
-
-		return check(locations, diveLocations, mode);
-	}
-
-	// TODO: Finish this implementation.
-	bool hasEquipment(const QStringList &, const struct dive *, FilterData::Mode)
-	{
-		return true;
-	}
-
-	bool hasSuits(const QStringList &suits, const struct dive *d, FilterData::Mode mode)
-	{
-		if (suits.isEmpty())
-			return true;
-		QStringList diveSuits;
-		if (d->suit)
-			diveSuits.push_back(QString(d->suit));
-		return check(suits, diveSuits, mode);
-	}
-
-	bool hasNotes(const QStringList &dnotes, const struct dive *d, FilterData::Mode mode)
-	{
-		if (dnotes.isEmpty())
-			return true;
-		QStringList diveNotes;
-		if (d->notes)
-			diveNotes.push_back(QString(d->notes));
-		return check(dnotes, diveNotes, mode);
-	}
-
-}
-
 MultiFilterSortModel *MultiFilterSortModel::instance()
 {
 	static MultiFilterSortModel self;
@@ -119,6 +41,11 @@ MultiFilterSortModel::MultiFilterSortModel(QObject *parent) : QSortFilterProxyMo
 void MultiFilterSortModel::resetModel(DiveTripModelBase::Layout layout)
 {
 	DiveTripModelBase::resetModel(layout);
+	// The dive list was recreated, so rebuild the full text index as well
+	// and recalculate the statistics on next use.
+	FullTextIndex::instance()->reload();
+	DiveSummaryTable::instance()->invalidate();
+	StatisticsCache::instance()->invalidate();
 	// DiveTripModelBase::resetModel() generates a new instance.
 	// Thus, the source model must be reset.
 	setSourceModel(DiveTripModelBase::instance());
@@ -130,66 +57,7 @@ bool MultiFilterSortModel::showDive(const struct dive *d) const
 	if (!dive_sites.isEmpty())
 		return dive_sites.contains(d->dive_site);
 
-	if (!filterData.validFilter)
-		return true;
-
-	if (d->visibility < filterData.minVisibility || d->visibility > filterData.maxVisibility)
-		return false;
-
-	if (d->rating < filterData.minRating || d->rating > filterData.maxRating)
-		return false;
-
-	auto temp_comp = prefs.units.temperature == units::CELSIUS ? C_to_mkelvin : F_to_mkelvin;
-	if (d->watertemp.mkelvin &&
-	    (d->watertemp.mkelvin < (*temp_comp)(filterData.minWaterTemp) || d->watertemp.mkelvin > (*temp_comp)(filterData.maxWaterTemp)))
-		return false;
-
-	if (d->airtemp.mkelvin &&
-	    (d->airtemp.mkelvin < (*temp_comp)(filterData.minAirTemp) || d->airtemp.mkelvin > (*temp_comp)(filterData.maxAirTemp)))
-		return false;
-
-	QDateTime t = filterData.fromDate;
-	t.setTime(filterData.fromTime);
-	if (filterData.fromDate.isValid() && filterData.fromTime.isValid() &&
-	    d->when < t.toMSecsSinceEpoch()/1000 + t.offsetFromUtc())
-		return false;
-
-	t = filterData.toDate;
-	t.setTime(filterData.toTime);
-	if (filterData.toDate.isValid() && filterData.toTime.isValid() &&
-	    d->when > t.toMSecsSinceEpoch()/1000 + t.offsetFromUtc())
-		return false;
-
-	// tags.
-	if (!hasTags(filterData.tags, d, filterData.tagsMode))
-		return false;
-
-	// people
-	if (!hasPersons(filterData.people, d, filterData.peopleMode))
-		return false;
-
-	// Location
-	if (!hasLocations(filterData.location, d, filterData.locationMode))
-		return false;
-
-	// Suit
-	if (!hasSuits(filterData.suit, d, filterData.suitMode))
-		return false;
-
-	// Notes
-	if (!hasNotes(filterData.dnotes, d, filterData.dnotesMode))
-		return false;
-
-	if (!hasEquipment(filterData.equipment, d, filterData.equipmentMode))
-		return false;
-
-	// Planned/Logged
-	if (!filterData.logged && !has_planned(d, true))
-		return false;
-	if (!filterData.planned && !has_planned(d, false))
-		return false;
-
-	return true;
+	return filter.showDive(d);
 }
 
 bool MultiFilterSortModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
@@ -209,8 +77,7 @@ void MultiFilterSortModel::filterChanged(const QModelIndex &from, const QModelIn
 
 void MultiFilterSortModel::myInvalidate()
 {
-	QAbstractItemModel *m = sourceModel();
-	if (!m)
+	if (!sourceModel())
 		return;
 
 	{
@@ -225,42 +92,54 @@ void MultiFilterSortModel::myInvalidate()
 
 		divesDisplayed = 0;
 
-		for (int i = 0; i < m->rowCount(QModelIndex()); ++i) {
-			QModelIndex idx = m->index(i, 0, QModelIndex());
-
-			dive_trip *trip = m->data(idx, DiveTripModelBase::TRIP_ROLE).value<dive_trip *>();
-			if (trip) {
-				// This is a trip -> loop over all dives and see if any is selected
-
-				bool showTrip = false;
-				for (int j = 0; j < m->rowCount(idx); ++j) {
-					QModelIndex idx2 = m->index(j, 0, idx);
-					dive *d = m->data(idx2, DiveTripModelBase::DIVE_ROLE).value<dive *>();
-					if (!d) {
-						qWarning("MultiFilterSortModel::myInvalidate(): subitem not a dive!?");
-						continue;
-					}
-					bool show = showDive(d);
-					if (show) {
-						divesDisplayed++;
-						showTrip = true;
-					}
-					m->setData(idx2, show, DiveTripModelBase::SHOWN_ROLE);
-				}
-				m->setData(idx, showTrip, DiveTripModelBase::SHOWN_ROLE);
-			} else {
-				dive *d = m->data(idx, DiveTripModelBase::DIVE_ROLE).value<dive *>();
-				bool show = showDive(d);
-				if (show)
-					divesDisplayed++;
-				m->setData(idx, show, DiveTripModelBase::SHOWN_ROLE);
+		// Recalculate the bounds, since the units might have changed.
+		// Then, evaluate the text filters on the full text index in one go.
+		// The results are only valid for the duration of this function,
+		// later changes of individual dives are filtered directly.
+		filter.compile();
+		if (dive_sites.isEmpty())
+			filter.prepareFullText();
+
+		// Evaluate the filter for all dives in parallel. This only reads the
+		// dives, the shown flags are written back on the main thread below.
+		// The dives are processed in chunks to keep the overhead of the
+		// thread pool low. Outside of the dive-site mode, the numerical
+		// criteria are evaluated on the columns of the dive summary table.
+		const int chunkSize = 256;
+		std::vector<char> shown(dive_table.nr);
+		QVector<int> chunks;
+		for (int i = 0; i < dive_table.nr; i += chunkSize)
+			chunks.push_back(i);
+		const DiveSummaryTable *table = DiveSummaryTable::instance();
+		DiveSummaryTable::instance()->update();
+		QtConcurrent::blockingMap(chunks, [this, table, &shown, chunkSize](int from) {
+			int to = std::min(from + chunkSize, dive_table.nr);
+			if (dive_sites.isEmpty()) {
+				filter.showRows(*table, from, to, shown.data());
+				return;
 			}
+			for (int i = from; i < to; ++i)
+				shown[i] = showDive(dive_table.dives[i]);
+		});
+		filter.clearFullText();
+
+		// Write the flags to the core and collect the changed dives, so
+		// that the dive trip model can send its signals in batches.
+		std::vector<dive *> changed;
+		for (int i = 0; i < dive_table.nr; ++i) {
+			dive *d = dive_table.dives[i];
+			if (shown[i])
+				divesDisplayed++;
+			if (d->hidden_by_filter == !shown[i])
+				continue;
+			filter_dive(d, shown[i]);
+			changed.push_back(d);
 		}
 
-		invalidateFilter();
+		// Tell the dive trip model to update the shown flags and the displayed-counts
+		DiveTripModelBase::instance()->filterFinished(changed);
 
-		// Tell the dive trip model to update the displayed-counts
-		DiveTripModelBase::instance()->filterFinished();
+		invalidateFilter();
 		countsChanged();
 	}
 
@@ -338,7 +217,7 @@ bool MultiFilterSortModel::lessThan(const QModelIndex &i1, const QModelIndex &i2
 
 void MultiFilterSortModel::filterDataChanged(const FilterData &data)
 {
-	filterData = data;
+	filter.setFilter(data);
 	myInvalidate();
 }
 
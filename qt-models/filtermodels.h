@@ -3,6 +3,7 @@
 #define FILTERMODELS_H
 
 #include "divetripmodel.h"
+#include "core/divefilter.h"
 
 #include <QStringListModel>
 #include <QSortFilterProxyModel>
@@ -14,46 +15,6 @@
 struct dive;
 struct dive_trip;
 
-struct FilterData {
-	// The mode ids are chosen such that they can be directly converted from / to combobox indices.
-	enum class Mode {
-		ALL_OF = 0,
-		ANY_OF = 1,
-		NONE_OF = 2
-	};
-
-	bool validFilter = false;
-	int minVisibility = 0;
-	int maxVisibility = 5;
-	int minRating = 0;
-	int maxRating = 5;
-	// The default minimum and maximum temperatures are set such that all
-	// physically reasonable dives are shown. Note that these values should
-	// work for both Celcius and Fahrenheit scales.
-	double minWaterTemp = -10;
-	double maxWaterTemp = 200;
-	double minAirTemp = -50;
-	double maxAirTemp = 200;
-	QDateTime fromDate = QDateTime(QDate(1980,1,1));
-	QTime fromTime = QTime(0,0);
-	QDateTime toDate = QDateTime::currentDateTime();
-	QTime toTime = QTime::currentTime();
-	QStringList tags;
-	QStringList people;
-	QStringList location;
-	QStringList suit;
-	QStringList dnotes;
-	QStringList equipment;
-	Mode tagsMode = Mode::ALL_OF;
-	Mode peopleMode = Mode::ALL_OF;
-	Mode locationMode = Mode::ANY_OF;
-	Mode dnotesMode = Mode::ALL_OF;
-	Mode suitMode = Mode::ANY_OF;
-	Mode equipmentMode = Mode::ALL_OF;
-	bool logged = true;
-	bool planned = true;
-};
-
 class MultiFilterSortModel : public QSortFilterProxyModel {
 	Q_OBJECT
 public:
@@ -86,7 +47,7 @@ private:
 	// Dive site filtering has priority over other filters
 	QVector<dive_site *> dive_sites;
 	void countsChanged();
-	FilterData filterData;
+	DiveFilter filter;
 
 	// We use ref-counting for the dive site mode. The reason is that when switching
 	// between two tabs that both need dive site mode, the following course of
@@ -7,20 +7,38 @@
 #endif
 
 #include <QDebug>
+#include <QSet>
 #include <algorithm>
+#include <cmath>
 
 const char *MapLocation::PROPERTY_NAME_COORDINATE = "coordinate";
 const char *MapLocation::PROPERTY_NAME_DIVESITE   = "divesite";
 const char *MapLocation::PROPERTY_NAME_NAME       = "name";
+const char *MapLocation::PROPERTY_NAME_SITECOUNT  = "sitecount";
 
 #define MIN_DISTANCE_BETWEEN_DIVE_SITES_M 50.0
 
-MapLocation::MapLocation() : m_ds(nullptr)
+// Dive sites whose markers are closer than this are combined into a cluster
+#define CLUSTER_CELL_SIZE_PX 64.0
+// From this zoom level on, dive sites are not combined into clusters
+#define MAX_CLUSTER_ZOOM_LEVEL 16
+// Markers are also created for this fraction of the viewport beyond each edge,
+// so that they don't pop up when panning slowly
+#define VIEWPORT_MARGIN 0.25
+// Size of the world at zoom level 0 in pixels, as used by the map tiles
+#define TILE_SIZE_PX 256.0
+
+MapLocation::MapLocation() : m_ds(nullptr), m_siteCount(1), m_cell(0)
 {
 }
 
 MapLocation::MapLocation(struct dive_site *ds, QGeoCoordinate coord, QString name) :
-    m_ds(ds), m_coordinate(coord), m_name(name)
+    m_ds(ds), m_coordinate(coord), m_name(name), m_siteCount(1), m_cell(0)
+{
+}
+
+MapLocation::MapLocation(QGeoCoordinate coord, int siteCount, quint64 cell) :
+    m_ds(nullptr), m_coordinate(coord), m_siteCount(siteCount), m_cell(cell)
 {
 }
 
@@ -33,6 +51,8 @@ QVariant MapLocation::getRole(int role) const
 		return QVariant::fromValue(m_coordinate);
 	case Roles::RoleName:
 		return QVariant::fromValue(m_name);
+	case Roles::RoleSiteCount:
+		return QVariant::fromValue(m_siteCount);
 	default:
 		return QVariant();
 	}
@@ -64,12 +84,43 @@ QVariant MapLocation::divesiteVariant()
 	return QVariant::fromValue(m_ds);
 }
 
-MapLocationModel::MapLocationModel(QObject *parent) : QAbstractListModel(parent)
+int MapLocation::siteCount() const
+{
+	return m_siteCount;
+}
+
+quint64 MapLocation::cell() const
+{
+	return m_cell;
+}
+
+MapLocationModel::MapLocationModel(QObject *parent) : QAbstractListModel(parent),
+	m_diveSiteMode(false),
+	m_hasViewport(false),
+	m_centerX(0.0),
+	m_centerY(0.0),
+	m_zoomLevel(0.0),
+	m_halfWidth(0.0),
+	m_halfHeight(0.0)
 {
 	m_roles[MapLocation::Roles::RoleDivesite] = MapLocation::PROPERTY_NAME_DIVESITE;
 	m_roles[MapLocation::Roles::RoleCoordinate] = MapLocation::PROPERTY_NAME_COORDINATE;
 	m_roles[MapLocation::Roles::RoleName] = MapLocation::PROPERTY_NAME_NAME;
+	m_roles[MapLocation::Roles::RoleSiteCount] = MapLocation::PROPERTY_NAME_SITECOUNT;
 	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &MapLocationModel::diveSiteChanged);
+
+	// Commands send these signals once per dive site. Don't recalculate
+	// the sites for every single signal, but once control returns to the event loop.
+	m_updateTimer.setSingleShot(true);
+	m_updateTimer.setInterval(0);
+	connect(&m_updateTimer, &QTimer::timeout, this, &MapLocationModel::updateSites);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteAdded, this, &MapLocationModel::scheduleUpdate);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteDeleted, this, &MapLocationModel::diveSiteDeleted);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteDivesChanged, this, &MapLocationModel::scheduleUpdate);
+	connect(&diveListNotifier, &DiveListNotifier::batchFinished, this, &MapLocationModel::scheduleUpdate);
+#ifndef SUBSURFACE_MOBILE
+	connect(MultiFilterSortModel::instance(), &MultiFilterSortModel::filterFinished, this, &MapLocationModel::scheduleUpdate);
+#endif
 }
 
 MapLocationModel::~MapLocationModel()
@@ -131,39 +182,100 @@ static bool hasSelectedDive(const dive_site *ds)
 			   [] (const dive *d) { return d->selected; });
 }
 
+// Convert a coordinate into web-mercator coordinates, normalized to [0,1).
+// This is the projection of the map tiles, so that distances in these
+// coordinates correspond to distances on screen.
+static void toMercator(const QGeoCoordinate &coord, double &x, double &y)
+{
+	double latitude = std::max(-85.05112878, std::min(85.05112878, coord.latitude()));
+	double sinLatitude = sin(latitude * M_PI / 180.0);
+	x = (coord.longitude() + 180.0) / 360.0;
+	x -= floor(x);
+	y = 0.5 - log((1.0 + sinLatitude) / (1.0 - sinLatitude)) / (4.0 * M_PI);
+}
+
+void MapLocationModel::setSiteCoordinate(Site &site, QGeoCoordinate coord)
+{
+	site.coord = coord;
+	toMercator(coord, site.x, site.y);
+}
+
 void MapLocationModel::reload(QObject *map)
 {
-	beginResetModel();
+	m_map = map;
+	updateSites();
+}
 
-	qDeleteAll(m_mapLocations);
-	m_mapLocations.clear();
-	m_selectedDs.clear();
+void MapLocationModel::scheduleUpdate()
+{
+	if (!diveListNotifier.inBatch())
+		m_updateTimer.start();
+}
+
+void MapLocationModel::diveSiteDeleted(struct dive_site *ds, int)
+{
+	// Remove the site and its marker right away, since the dive site may be
+	// freed before the timer fires. Clusters that contained the site are
+	// updated with the other changes.
+	m_selectedDs.removeAll(ds);
+	auto it = std::find_if(m_sites.begin(), m_sites.end(), [ds](const Site &site) { return site.ds == ds; });
+	if (it != m_sites.end()) {
+		m_sites.erase(it);
+		// The clusters refer to the sites by index
+		m_clusters.clear();
+	}
+	auto row = std::find_if(m_mapLocations.begin(), m_mapLocations.end(),
+				[ds](const MapLocation *location) { return location->m_ds == ds; });
+	if (row != m_mapLocations.end()) {
+		int idx = row - m_mapLocations.begin();
+		beginRemoveRows(QModelIndex(), idx, idx);
+		delete *row;
+		m_mapLocations.erase(row);
+		endRemoveRows();
+		emit countChanged(m_mapLocations.size());
+	}
+	scheduleUpdate();
+}
+
+// Recalculate the set of shown dive sites and apply the difference to the
+// rows. The clusters are only recalculated if the sites or their positions changed.
+void MapLocationModel::updateSites()
+{
+	m_updateTimer.stop();
+	QVector<Site> oldSites;
+	QVector<dive_site *> oldSelectedDs;
+	std::swap(oldSites, m_sites);
+	std::swap(oldSelectedDs, m_selectedDs);
+	QObject *map = m_map;
 
-	QMap<QString, MapLocation *> locationNameMap;
+	QMap<QString, int> locationNameMap;
 
 #ifdef SUBSURFACE_MOBILE
-	bool diveSiteMode = false;
+	m_diveSiteMode = false;
 #else
 	// In dive site mode (that is when either editing a dive site or on
 	// the dive site tab), we want to show all dive sites, not only those
 	// of the non-hidden dives. Moreover, the selected dive sites are those
 	// that we filter for.
-	bool diveSiteMode = MultiFilterSortModel::instance()->diveSiteMode();
-	if (diveSiteMode)
+	m_diveSiteMode = MultiFilterSortModel::instance()->diveSiteMode();
+	if (m_diveSiteMode)
 		m_selectedDs = MultiFilterSortModel::instance()->filteredDiveSites();
 #endif
+	QSet<const dive_site *> selectedSet;
+	for (const dive_site *ds: m_selectedDs)
+		selectedSet.insert(ds);
 	for (int i = 0; i < dive_site_table.nr; ++i) {
 		struct dive_site *ds = dive_site_table.dive_sites[i];
 		QGeoCoordinate dsCoord;
 
 		// Don't show dive sites of hidden dives, unless we're in dive site edit mode.
-		if (!diveSiteMode && !hasVisibleDive(ds))
+		if (!m_diveSiteMode && !hasVisibleDive(ds))
 			continue;
 		if (!dive_site_has_gps_location(ds)) {
 			// Dive sites that do not have a gps location are not shown in normal mode.
 			// In dive-edit mode, selected sites are placed at the center of the map,
 			// so that the user can drag them somewhere without having to enter coordinates.
-			if (!diveSiteMode || !m_selectedDs.contains(ds) || !map)
+			if (!m_diveSiteMode || !selectedSet.contains(ds) || !map)
 				continue;
 			dsCoord = map->property("center").value<QGeoCoordinate>();
 		} else {
@@ -171,32 +283,203 @@ void MapLocationModel::reload(QObject *map)
 			qreal longitude = ds->location.lon.udeg * 0.000001;
 			dsCoord = QGeoCoordinate(latitude, longitude);
 		}
-		if (!diveSiteMode && hasSelectedDive(ds) && !m_selectedDs.contains(ds))
+		if (!m_diveSiteMode && hasSelectedDive(ds)) {
 			m_selectedDs.append(ds);
+			selectedSet.insert(ds);
+		}
 		QString name(ds->name);
-		if (!diveSiteMode) {
+		if (!m_diveSiteMode) {
 			// don't add dive locations with the same name, unless they are
 			// at least MIN_DISTANCE_BETWEEN_DIVE_SITES_M apart
 			if (locationNameMap.contains(name)) {
-				MapLocation *existingLocation = locationNameMap[name];
-				QGeoCoordinate coord = existingLocation->coordinate();
+				QGeoCoordinate coord = m_sites[locationNameMap[name]].coord;
 				if (dsCoord.distanceTo(coord) < MIN_DISTANCE_BETWEEN_DIVE_SITES_M)
 					continue;
 			}
 		}
-		MapLocation *location = new MapLocation(ds, dsCoord, name);
-		m_mapLocations.append(location);
-		if (!diveSiteMode)
-			locationNameMap[name] = location;
+		Site site { ds, QGeoCoordinate(), name, 0.0, 0.0, selectedSet.contains(ds) };
+		setSiteCoordinate(site, dsCoord);
+		m_sites.append(site);
+		if (!m_diveSiteMode)
+			locationNameMap[name] = m_sites.size() - 1;
 	}
 
-	endResetModel();
+	bool sitesMoved = oldSelectedDs != m_selectedDs || oldSites.size() != m_sites.size() ||
+			  !std::equal(oldSites.begin(), oldSites.end(), m_sites.begin(),
+				      [](const Site &s1, const Site &s2) { return s1.ds == s2.ds && s1.coord == s2.coord; });
+	if (sitesMoved)
+		m_clusters.clear();
+	updateRows();
+}
+
+// Combine the dive sites into clusters on a grid of cells of CLUSTER_CELL_SIZE_PX
+// at the given zoom level. This is done once per zoom level and set of dive sites.
+// Selected dive sites are not part of clusters, since they are always shown.
+const MapLocationModel::ClusterLevel &MapLocationModel::clusters(int level) const
+{
+	if (m_clusters.size() <= level)
+		m_clusters.resize(level + 1);
+	ClusterLevel &res = m_clusters[level];
+	if (!res.isEmpty() || m_sites.isEmpty())
+		return res;
+
+	double cells = TILE_SIZE_PX * pow(2.0, level) / CLUSTER_CELL_SIZE_PX;
+	quint64 n = static_cast<quint64>(cells);
+	for (int i = 0; i < m_sites.size(); ++i) {
+		const Site &site = m_sites[i];
+		if (site.selected)
+			continue;
+		quint64 cellX = std::min(static_cast<quint64>(site.x * cells), n - 1);
+		quint64 cellY = std::min(static_cast<quint64>(site.y * cells), n - 1);
+		// Make the key unique over all levels, so that clusters can be identified by it
+		quint64 key = (static_cast<quint64>(level) << 56) | (cellY * n + cellX);
+		auto it = res.find(key);
+		if (it == res.end()) {
+			res.insert(key, { site.coord.latitude(), site.coord.longitude(), 1, i });
+		} else {
+			it->sumLatitude += site.coord.latitude();
+			it->sumLongitude += site.coord.longitude();
+			++it->count;
+		}
+	}
+	return res;
+}
+
+void MapLocationModel::setViewport(QGeoCoordinate center, qreal zoomLevel, qreal width, qreal height)
+{
+	if (!center.isValid() || width <= 0.0 || height <= 0.0)
+		return;
+	toMercator(center, m_centerX, m_centerY);
+	double worldSize = TILE_SIZE_PX * pow(2.0, zoomLevel);
+	m_halfWidth = width / 2.0 / worldSize;
+	m_halfHeight = height / 2.0 / worldSize;
+	m_zoomLevel = zoomLevel;
+	m_hasViewport = true;
+	updateRows();
+}
+
+// Check whether a point in web-mercator coordinates is inside the viewport, extended
+// by the given fraction on each side. Take care of the wrap-around at 180° longitude.
+// As long as the map didn't report its viewport, no point is inside.
+bool MapLocationModel::inViewport(double x, double y, double margin) const
+{
+	if (!m_hasViewport)
+		return false;
+	double dx = fabs(x - m_centerX);
+	dx = std::min(dx, 1.0 - dx);
+	return dx <= m_halfWidth * (1.0 + 2.0 * margin) &&
+	       fabs(y - m_centerY) <= m_halfHeight * (1.0 + 2.0 * margin);
+}
+
+bool MapLocationModel::isInViewport(const location_t &location) const
+{
+	double x, y;
+	toMercator(QGeoCoordinate(location.lat.udeg * 0.000001, location.lon.udeg * 0.000001), x, y);
+	return inViewport(x, y, 0.0);
+}
+
+// Recalculate the markers in the viewport and apply the difference to the
+// current rows. Thus, when panning the map, only the markers that enter
+// or leave the viewport are created or destroyed.
+void MapLocationModel::updateRows()
+{
+	// The markers are identified by their dive site or, for clusters, by the grid cell.
+	typedef QPair<const dive_site *, quint64> Key;
+	QVector<MapLocation *> newLocations;
+	QHash<Key, int> newKeys;
+	auto addSite = [&](const Site &site) {
+		newKeys.insert(Key(site.ds, 0), newLocations.size());
+		newLocations.append(new MapLocation(site.ds, site.coord, site.name));
+	};
+
+	int level = static_cast<int>(floor(m_zoomLevel));
+	if (!m_hasViewport || m_diveSiteMode || level >= MAX_CLUSTER_ZOOM_LEVEL) {
+		// Without a viewport, show all dive sites
+		for (const Site &site: m_sites) {
+			if (site.selected || !m_hasViewport || inViewport(site.x, site.y, VIEWPORT_MARGIN))
+				addSite(site);
+		}
+	} else {
+		for (const Site &site: m_sites) {
+			if (site.selected)
+				addSite(site);
+		}
+		const ClusterLevel &clusterLevel = clusters(std::max(level, 0));
+		for (auto it = clusterLevel.begin(); it != clusterLevel.end(); ++it) {
+			const Cluster &cluster = it.value();
+			if (cluster.count == 1) {
+				const Site &site = m_sites[cluster.site];
+				if (inViewport(site.x, site.y, VIEWPORT_MARGIN))
+					addSite(site);
+				continue;
+			}
+			QGeoCoordinate coord(cluster.sumLatitude / cluster.count, cluster.sumLongitude / cluster.count);
+			double x, y;
+			toMercator(coord, x, y);
+			if (!inViewport(x, y, VIEWPORT_MARGIN))
+				continue;
+			newKeys.insert(Key(nullptr, it.key()), newLocations.size());
+			newLocations.append(new MapLocation(coord, cluster.count, it.key()));
+		}
+	}
+
+	// Remove the rows that are not needed anymore and update those that changed.
+	// Go backwards, so that the indexes of the rows to be removed stay valid.
+	// Remove consecutive rows in one go.
+	int oldCount = m_mapLocations.size();
+	QVector<bool> existing(newLocations.size(), false);
+	for (int i = m_mapLocations.size() - 1; i >= 0; --i) {
+		MapLocation *location = m_mapLocations[i];
+		int newIdx = newKeys.value(Key(location->m_ds, location->m_cell), -1);
+		if (newIdx >= 0) {
+			existing[newIdx] = true;
+			const MapLocation *newLocation = newLocations[newIdx];
+			if (location->m_coordinate != newLocation->m_coordinate ||
+			    location->m_name != newLocation->m_name ||
+			    location->m_siteCount != newLocation->m_siteCount) {
+				location->m_coordinate = newLocation->m_coordinate;
+				location->m_name = newLocation->m_name;
+				location->m_siteCount = newLocation->m_siteCount;
+				emit dataChanged(createIndex(i, 0), createIndex(i, 0));
+			}
+			continue;
+		}
+		int last = i;
+		while (i > 0 && newKeys.value(Key(m_mapLocations[i - 1]->m_ds, m_mapLocations[i - 1]->m_cell), -1) < 0)
+			--i;
+		beginRemoveRows(QModelIndex(), i, last);
+		for (int j = i; j <= last; ++j)
+			delete m_mapLocations[j];
+		m_mapLocations.erase(m_mapLocations.begin() + i, m_mapLocations.begin() + last + 1);
+		endRemoveRows();
+	}
+
+	// Append the new rows
+	QVector<MapLocation *> added;
+	for (int i = 0; i < newLocations.size(); ++i) {
+		if (existing[i])
+			delete newLocations[i];
+		else
+			added.append(newLocations[i]);
+	}
+	if (!added.isEmpty()) {
+		beginInsertRows(QModelIndex(), m_mapLocations.size(), m_mapLocations.size() + added.size() - 1);
+		m_mapLocations.append(added);
+		endInsertRows();
+	}
+	if (m_mapLocations.size() != oldCount)
+		emit countChanged(m_mapLocations.size());
 }
 
 void MapLocationModel::setSelected(struct dive_site *ds, bool fromClick)
 {
 	m_selectedDs.clear();
 	m_selectedDs.append(ds);
+	for (Site &site: m_sites)
+		site.selected = site.ds == ds;
+	// Selected dive sites are not part of clusters
+	m_clusters.clear();
+	updateRows();
 	if (fromClick)
 		emit selectedLocationChanged(getMapLocation(ds));
 }
@@ -220,12 +503,8 @@ MapLocation *MapLocationModel::getMapLocation(const struct dive_site *ds)
 void MapLocationModel::diveSiteChanged(struct dive_site *ds, int field)
 {
 	// Find dive site
-	int row;
-	for (row = 0; row < m_mapLocations.size(); ++row) {
-		if (m_mapLocations[row]->divesite() == ds)
-			break;
-	}
-	if (row ==  m_mapLocations.size())
+	auto it = std::find_if(m_sites.begin(), m_sites.end(), [ds](const Site &site) { return site.ds == ds; });
+	if (it == m_sites.end())
 		return;
 
 	switch (field) {
@@ -233,17 +512,16 @@ void MapLocationModel::diveSiteChanged(struct dive_site *ds, int field)
 		if (has_location(&ds->location)) {
 			const qreal latitude_r = ds->location.lat.udeg * 0.000001;
 			const qreal longitude_r = ds->location.lon.udeg * 0.000001;
-			QGeoCoordinate coord(latitude_r, longitude_r);
-			m_mapLocations[row]->setCoordinateNoEmit(coord);
+			setSiteCoordinate(*it, QGeoCoordinate(latitude_r, longitude_r));
+			// The site may have moved into a different cluster
+			m_clusters.clear();
 		}
 		break;
 	case LocationInformationModel::NAME:
-		m_mapLocations[row]->setProperty("name", ds->name);
+		it->name = ds->name;
 		break;
 	default:
-		break;
+		return;
 	}
-
-
-	emit dataChanged(createIndex(row, 0), createIndex(row, 0));
+	updateRows();
 }
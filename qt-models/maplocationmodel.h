@@ -3,12 +3,15 @@
 #define MAPLOCATIONMODEL_H
 
 #include "core/subsurface-qt/DiveListNotifier.h"
+#include "core/units.h"
 #include <QObject>
 #include <QVector>
 #include <QHash>
 #include <QByteArray>
 #include <QAbstractListModel>
 #include <QGeoCoordinate>
+#include <QPointer>
+#include <QTimer>
 
 class MapLocation : public QObject
 {
@@ -16,14 +19,18 @@ class MapLocation : public QObject
 	Q_PROPERTY(QVariant divesite READ divesiteVariant)
 	Q_PROPERTY(QGeoCoordinate coordinate READ coordinate WRITE setCoordinate NOTIFY coordinateChanged)
 	Q_PROPERTY(QString name MEMBER m_name)
+	Q_PROPERTY(int sitecount MEMBER m_siteCount)
 
 public:
 	static const char *PROPERTY_NAME_COORDINATE;
 	static const char *PROPERTY_NAME_DIVESITE;
 	static const char *PROPERTY_NAME_NAME;
+	static const char *PROPERTY_NAME_SITECOUNT;
 
 	explicit MapLocation();
 	explicit MapLocation(struct dive_site *ds, QGeoCoordinate coord, QString name);
+	// A cluster of multiple dive sites. The dive site is null.
+	explicit MapLocation(QGeoCoordinate coord, int siteCount, quint64 cell);
 
 	QVariant getRole(int role) const;
 	QGeoCoordinate coordinate();
@@ -31,17 +38,23 @@ public:
 	void setCoordinateNoEmit(QGeoCoordinate coord);
 	QVariant divesiteVariant();
 	struct dive_site *divesite();
+	int siteCount() const;
+	quint64 cell() const;
 
 	enum Roles {
 		RoleDivesite = Qt::UserRole + 1,
 		RoleCoordinate,
-		RoleName
+		RoleName,
+		RoleSiteCount
 	};
 
 private:
+	friend class MapLocationModel;
 	struct dive_site *m_ds;
 	QGeoCoordinate m_coordinate;
 	QString m_name;
+	int m_siteCount;	// number of dive sites represented by this marker
+	quint64 m_cell;		// for clusters: zoom level and grid cell
 
 signals:
 	void coordinateChanged();
@@ -61,7 +74,9 @@ public:
 	int rowCount(const QModelIndex &parent) const override;
 	int count();
 	void add(MapLocation *);
-	// If map is not null, it will be used to place new dive sites without GPS location at the center of the map
+	// If map is not null, it will be used to place new dive sites without GPS location at the center of the map.
+	// The model updates itself when dive sites are added, deleted or the filter changes. Only the
+	// markers that actually changed are inserted, removed or updated, so that QML keeps the others.
 	void reload(QObject *map);
 	MapLocation *getMapLocation(const struct dive_site *ds);
 	const QVector<dive_site *> &selectedDs() const;
@@ -70,16 +85,55 @@ public:
 	// transformed into a null pointer and warning messages are spewed onto the console.
 	Q_INVOKABLE bool isSelected(const QVariant &ds) const;
 
+	// The map reports the shown area, so that only the markers in this area are
+	// added to the model. Nearby dive sites are combined into clusters, depending
+	// on the zoom level. Without a viewport, all dive sites are shown individually.
+	Q_INVOKABLE void setViewport(QGeoCoordinate center, qreal zoomLevel, qreal width, qreal height);
+	// Returns false as long as no viewport is known.
+	bool isInViewport(const location_t &location) const;
+
 protected:
 	QHash<int, QByteArray> roleNames() const override;
 
 private slots:
 	void diveSiteChanged(struct dive_site *ds, int field);
+	void diveSiteDeleted(struct dive_site *ds, int idx);
+	void scheduleUpdate();
+	void updateSites();
 
 private:
-	QVector<MapLocation *> m_mapLocations;
+	// The dive sites that are shown on the map, whether inside the viewport or not.
+	struct Site {
+		struct dive_site *ds;
+		QGeoCoordinate coord;
+		QString name;
+		double x, y;	// web-mercator coordinates, normalized to [0,1)
+		bool selected;	// in m_selectedDs
+	};
+	struct Cluster {
+		double sumLatitude, sumLongitude;
+		int count;
+		int site;	// index of the first site in the cluster
+	};
+	typedef QHash<quint64, Cluster> ClusterLevel;	// grid cell -> cluster
+
+	void setSiteCoordinate(Site &site, QGeoCoordinate coord);
+	const ClusterLevel &clusters(int level) const;
+	bool inViewport(double x, double y, double margin) const;
+	void updateRows();
+
+	QVector<MapLocation *> m_mapLocations;	// the rows of the model
 	QHash<int, QByteArray> m_roles;
 	QVector<dive_site *> m_selectedDs;
+	QVector<Site> m_sites;
+	QPointer<QObject> m_map;
+	QTimer m_updateTimer;	// collects multiple changes into one update of the sites
+	mutable QVector<ClusterLevel> m_clusters;	// per zoom level, calculated on demand
+	bool m_diveSiteMode;
+	bool m_hasViewport;
+	double m_centerX, m_centerY;
+	double m_zoomLevel;
+	double m_halfWidth, m_halfHeight;	// in normalized web-mercator coordinates
 
 signals:
 	void countChanged(int c);
@@ -3,6 +3,7 @@
 #include "core/qthelper.h"
 #include "core/metrics.h"
 #include "core/statistics.h"
+#include "core/statisticscache.h"
 
 class YearStatisticsItem : public TreeItem {
 	Q_DECLARE_TR_FUNCTIONS(YearStatisticsItem)
@@ -187,7 +188,7 @@ void YearlyStatisticsModel::update_yearly_stats()
 	stats_summary_auto_free stats;
 	QString label;
 	temperature_t t_range_min,t_range_max;
-	calculate_stats_summary(&stats, false);
+	StatisticsCache::instance()->calculateSummary(&stats, false);
 
 	for (i = 0; stats.stats_yearly != NULL && stats.stats_yearly[i].period; ++i) {
 		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_yearly[i]);
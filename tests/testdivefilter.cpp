@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivefilter.h"
+#include "core/dive.h"
+#include "core/divefilter.h"
+#include "core/divelist.h"
+#include "core/divesummary.h"
+#include "core/fulltext.h"
+#include "core/tag.h"
+
+#include <algorithm>
+
+// Generate a large log in which the properties of the dives
+// follow simple patterns of the dive index.
+static const int numDives = 50000;
+static const char *buddies[] = { "Alice", "Bob Smith", "Carol", "Dave O'Neill" };
+static const char *notes[] = { "Turtle near the reef", "Wreck penetration", "Night dive with octopus", "Drift along the wall" };
+static const char *tags[] = { "boat", "shore", "wreck", "night" };
+
+static FilterData makeFilterData()
+{
+	FilterData data;
+	data.validFilter = true;
+	data.fromDate = QDateTime(QDate(1980, 1, 1));
+	data.toDate = QDateTime(QDate(2100, 1, 1));
+	return data;
+}
+
+static int countShown(const DiveFilter &filter)
+{
+	int i, res = 0;
+	struct dive *d;
+	for_each_dive (i, d)
+		res += filter.showDive(d);
+	return res;
+}
+
+// Count the dives with the filter, with the full text filters prepared
+// and on the dive summary table. All should give the same result.
+static int countShown(const FilterData &data)
+{
+	DiveFilter filter;
+	filter.setFilter(data);
+	int res = countShown(filter);
+	filter.prepareFullText();
+	int resFullText = countShown(filter);
+	filter.clearFullText();
+
+	DiveSummaryTable *table = DiveSummaryTable::instance();
+	table->update();
+	std::vector<char> shown(table->size());
+	filter.showRows(*table, 0, table->size(), shown.data());
+	int resRows = (int)std::count(shown.begin(), shown.end(), 1);
+
+	return res == resFullText && res == resRows ? res : -1;
+}
+
+void TestDiveFilter::initTestCase()
+{
+	taglist_init_global();
+	for (int i = 0; i < numDives; ++i) {
+		struct dive *d = alloc_dive();
+		d->when = 631152000 + i * 21600; // four dives a day since 1990
+		d->rating = i % 6;
+		d->visibility = (i / 6) % 6;
+		d->watertemp.mkelvin = C_to_mkelvin(5 + i % 25);
+		d->buddy = strdup(buddies[i % 4]);
+		d->notes = strdup(notes[(i / 4) % 4]);
+		taglist_add_tag(&d->tag_list, tags[(i / 16) % 4]);
+		record_dive(d);
+	}
+	FullTextIndex::instance()->reload();
+}
+
+void TestDiveFilter::cleanupTestCase()
+{
+	FullTextIndex::instance()->clear();
+	clear_dive_file_data();
+	DiveSummaryTable::instance()->invalidate();
+}
+
+void TestDiveFilter::testNumericFilter()
+{
+	FilterData data = makeFilterData();
+	QCOMPARE(countShown(data), numDives);
+
+	int expected = 0;
+	for (int i = 0; i < numDives; ++i)
+		expected += i % 6 >= 3 && 5 + i % 25 <= 20;
+	data.minRating = 3;
+	data.maxWaterTemp = 20.0;
+	QCOMPARE(countShown(data), expected);
+}
+
+void TestDiveFilter::testTextFilter()
+{
+	FilterData data = makeFilterData();
+	data.people = QStringList{ "bob" };
+	data.dnotes = QStringList{ "octo" };
+	data.tags = QStringList{ "wreck" };
+	int expected = 0;
+	for (int i = 0; i < numDives; ++i)
+		expected += i % 4 == 1 && (i / 4) % 4 == 2 && (i / 16) % 4 == 2;
+	QCOMPARE(countShown(data), expected);
+
+	data = makeFilterData();
+	data.people = QStringList{ "alice", "o'neill" };
+	data.peopleMode = FilterData::Mode::NONE_OF;
+	QCOMPARE(countShown(data), numDives / 2);
+
+	data.peopleMode = FilterData::Mode::ANY_OF;
+	QCOMPARE(countShown(data), numDives / 2);
+
+	data.peopleMode = FilterData::Mode::ALL_OF;
+	QCOMPARE(countShown(data), 0);
+
+	// Items without word characters can't be looked up in the full text index
+	data.people = QStringList{ "'" };
+	QCOMPARE(countShown(data), numDives / 4);
+}
+
+void TestDiveFilter::benchmarkFilter()
+{
+	FilterData data = makeFilterData();
+	data.minRating = 2;
+	data.people = QStringList{ "bob" };
+	data.dnotes = QStringList{ "reef" };
+	data.tags = QStringList{ "boat", "night" };
+	data.tagsMode = FilterData::Mode::ANY_OF;
+	DiveFilter filter;
+	filter.setFilter(data);
+	int shown = 0;
+	QBENCHMARK {
+		filter.compile();
+		filter.prepareFullText();
+		shown = countShown(filter);
+		filter.clearFullText();
+	}
+	QVERIFY(shown > 0);
+}
+
+QTEST_GUILESS_MAIN(TestDiveFilter)
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVEFILTER_H
+#define TESTDIVEFILTER_H
+
+#include <QtTest>
+
+class TestDiveFilter : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testNumericFilter();
+	void testTextFilter();
+	void benchmarkFilter();
+};
+
+#endif
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivelistbatch.h"
+#include "desktop-widgets/command.h"
+#include "qt-models/divetripmodel.h"
+#include "core/display.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/trip.h"
+#include "core/subsurface-qt/DiveListNotifier.h"
+
+// Defined by the desktop main program, but used by the profile widget.
+bool haveFilesOnCommandLine()
+{
+	return false;
+}
+
+void TestDiveListBatch::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	DiveTripModelBase::resetModel(DiveTripModelBase::TREE);
+}
+
+void TestDiveListBatch::cleanupTestCase()
+{
+	Command::clear();
+	clear_dive_file_data();
+}
+
+// Add nr half-hour dives, one per day, starting at the given time.
+static void createDives(struct dive_table *table, int nr, timestamp_t start)
+{
+	for (int i = 0; i < nr; ++i) {
+		struct dive *d = alloc_dive();
+		d->when = start + i * 24 * 3600;
+		d->duration.seconds = d->dc.duration.seconds = 30 * 60;
+		add_to_dive_table(table, table->nr, d);
+	}
+}
+
+// Import nr dives and check that the model sends the selection of all new dives.
+// resetsBeforeSelection is set to the number of model resets before the selection was sent.
+static void importAndCheckSelection(int nr, timestamp_t start, int &resetsBeforeSelection)
+{
+	DiveTripModelBase *model = DiveTripModelBase::instance();
+	int oldNr = dive_table.nr;
+	int resets = 0;
+	QVector<QModelIndex> selected;
+	QModelIndex current;
+	QObject context; // disconnects the lambdas below when going out of scope
+	QObject::connect(model, &QAbstractItemModel::modelReset, &context, [&]() {
+		++resets;
+	});
+	QObject::connect(model, &DiveTripModelBase::selectionChanged, &context, [&](const QVector<QModelIndex> &indexes) {
+		selected = indexes;
+		resetsBeforeSelection = resets;
+	});
+	QObject::connect(model, &DiveTripModelBase::newCurrentDive, &context, [&](QModelIndex index) {
+		current = index;
+	});
+
+	struct dive_table table = { 0 };
+	struct trip_table trips = { 0 };
+	struct dive_site_table sites = { 0 };
+	createDives(&table, nr, start);
+	Command::importDives(&table, &trips, &sites, IMPORT_MERGE_ALL_TRIPS, QStringLiteral("test"));
+
+	// The dives are tripless, so they are all shown at the top level
+	// and the indexes sent by the model must refer to the new dives.
+	QCOMPARE(dive_table.nr, oldNr + nr);
+	QCOMPARE(model->rowCount(QModelIndex()), dive_table.nr);
+	QCOMPARE(amount_selected, (unsigned int)nr);
+	QCOMPARE(selected.size(), nr);
+	for (const QModelIndex &index: selected) {
+		dive *d = model->data(index, DiveTripModelBase::DIVE_ROLE).value<dive *>();
+		QVERIFY(d != nullptr);
+		QVERIFY(d->selected);
+		QVERIFY(d->when >= start);
+	}
+	QVERIFY(current_dive != nullptr);
+	QCOMPARE(current_dive->when, start + (nr - 1) * 24 * 3600);
+	QCOMPARE(model->data(current, DiveTripModelBase::DIVE_ROLE).value<dive *>(), current_dive);
+}
+
+void TestDiveListBatch::testImport()
+{
+	// Many dives are imported at once: the model must not apply the
+	// changes one by one, but reload once after the batch is finished.
+	// The selection is sent after the reload, so that its indexes are valid.
+	DiveTripModelBase *model = DiveTripModelBase::instance();
+	QSignalSpy resetSpy(model, SIGNAL(modelReset()));
+	QSignalSpy insertSpy(model, SIGNAL(rowsInserted(QModelIndex, int, int)));
+	QSignalSpy batchSpy(&diveListNotifier, &DiveListNotifier::batchFinished);
+
+	int resetsBeforeSelection = -1;
+	importAndCheckSelection(DiveListNotifier::minBatchSize, 1546300800, resetsBeforeSelection);
+	if (QTest::currentTestFailed())
+		return;
+	QCOMPARE(batchSpy.count(), 1);
+	QCOMPARE(resetSpy.count(), 1);
+	QCOMPARE(insertSpy.count(), 0);
+	QCOMPARE(resetsBeforeSelection, 1);
+}
+
+void TestDiveListBatch::testSmallImport()
+{
+	// Few dives are inserted into the model without a reset.
+	DiveTripModelBase *model = DiveTripModelBase::instance();
+	QSignalSpy resetSpy(model, SIGNAL(modelReset()));
+	QSignalSpy insertSpy(model, SIGNAL(rowsInserted(QModelIndex, int, int)));
+	QSignalSpy batchSpy(&diveListNotifier, &DiveListNotifier::batchFinished);
+
+	int resetsBeforeSelection = -1;
+	importAndCheckSelection(DiveListNotifier::minBatchSize - 1, 1577836800, resetsBeforeSelection);
+	if (QTest::currentTestFailed())
+		return;
+	QCOMPARE(batchSpy.count(), 0);
+	QCOMPARE(resetSpy.count(), 0);
+	QVERIFY(insertSpy.count() > 0);
+	QCOMPARE(resetsBeforeSelection, 0);
+}
+
+QTEST_GUILESS_MAIN(TestDiveListBatch)
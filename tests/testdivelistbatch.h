@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVELISTBATCH_H
+#define TESTDIVELISTBATCH_H
+
+#include <QtTest>
+
+class TestDiveListBatch : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void testImport();
+	void testSmallImport();
+};
+
+#endif
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivelistnotifier.h"
+#include "core/subsurface-qt/DiveListNotifier.h"
+
+void TestDiveListNotifier::testSmallBatch()
+{
+	QSignalSpy spy(&diveListNotifier, &DiveListNotifier::batchFinished);
+	{
+		auto batch = diveListNotifier.startBatch(DiveListNotifier::minBatchSize - 1);
+		QVERIFY(!diveListNotifier.inBatch());
+	}
+	QCOMPARE(spy.count(), 0);
+}
+
+void TestDiveListNotifier::testNestedBatch()
+{
+	QSignalSpy spy(&diveListNotifier, &DiveListNotifier::batchFinished);
+	{
+		auto outer = diveListNotifier.startBatch(DiveListNotifier::minBatchSize);
+		QVERIFY(diveListNotifier.inBatch());
+		{
+			auto inner = diveListNotifier.startBatch(2 * DiveListNotifier::minBatchSize);
+			auto small = diveListNotifier.startBatch(1);
+		}
+		// Only the outermost batch sends the signal
+		QVERIFY(diveListNotifier.inBatch());
+		QCOMPARE(spy.count(), 0);
+	}
+	QVERIFY(!diveListNotifier.inBatch());
+	QCOMPARE(spy.count(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestDiveListNotifier)
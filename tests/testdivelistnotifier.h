@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVELISTNOTIFIER_H
+#define TESTDIVELISTNOTIFIER_H
+
+#include <QtTest>
+
+class TestDiveListNotifier : public QObject {
+	Q_OBJECT
+private slots:
+	void testSmallBatch();
+	void testNestedBatch();
+};
+
+#endif
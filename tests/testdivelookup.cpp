@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdivelookup.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/file.h"
+#include "core/trip.h"
+
+void TestDiveLookup::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	process_loaded_dives();
+	QVERIFY(dive_table.nr > 2);
+}
+
+void TestDiveLookup::cleanupTestCase()
+{
+	clear_dive_file_data();
+}
+
+void TestDiveLookup::testById()
+{
+	for (int i = 0; i < dive_table.nr; ++i) {
+		struct dive *d = dive_table.dives[i];
+		QCOMPARE(get_dive_by_uniq_id(d->id), d);
+		QCOMPARE(get_idx_by_uniq_id(d->id), i);
+		QCOMPARE(get_divenr(d), i);
+	}
+	QVERIFY(get_divenr(nullptr) == -1);
+}
+
+void TestDiveLookup::testByIdAfterDelete()
+{
+	// The removed dive must not be found and the others must still be found
+	// at their new positions.
+	int id = dive_table.dives[0]->id;
+	delete_single_dive(0);
+	QVERIFY(get_dive_by_uniq_id(id) == nullptr);
+	QCOMPARE(get_idx_by_uniq_id(id), dive_table.nr);
+	for (int i = 0; i < dive_table.nr; ++i)
+		QCOMPARE(get_dive_by_uniq_id(dive_table.dives[i]->id), dive_table.dives[i]);
+}
+
+void TestDiveLookup::testByIdAfterInsert()
+{
+	// Insert a copy of the second dive, which is sorted right after it
+	struct dive *d = alloc_dive();
+	int id = d->id;
+	copy_dive(dive_table.dives[1], d);
+	d->id = id;
+	d->when += 1;
+	d->divetrip = nullptr;
+	d->dive_site = nullptr;
+	d->selected = false;
+	insert_dive(&dive_table, d);
+	QCOMPARE(get_idx_by_uniq_id(id), 2);
+	QCOMPARE(get_dive_by_uniq_id(id), d);
+	for (int i = 0; i < dive_table.nr; ++i)
+		QCOMPARE(get_idx_by_uniq_id(dive_table.dives[i]->id), i);
+
+	delete_single_dive(2);
+	QCOMPARE(get_idx_by_uniq_id(id), dive_table.nr);
+}
+
+void TestDiveLookup::testClosestTo()
+{
+	struct dive *first = dive_table.dives[0];
+	struct dive *second = dive_table.dives[1];
+	struct dive *last = dive_table.dives[dive_table.nr - 1];
+
+	QCOMPARE(get_dive_id_closest_to(first->when - 3600), first->id);
+	QCOMPARE(get_dive_id_closest_to(last->when + 3600), last->id);
+	QCOMPARE(get_dive_id_closest_to(first->when + 1), first->id);
+	QCOMPARE(get_dive_id_closest_to(second->when - 1), second->id);
+	QCOMPARE(first_dive_after(first->when - 1), 0);
+	QCOMPARE(first_dive_after(last->when), dive_table.nr);
+}
+
+void TestDiveLookup::testNear()
+{
+	// Compare with a linear search over all dives
+	for (int i = 0; i < dive_table.nr; ++i) {
+		timestamp_t when = dive_table.dives[i]->when;
+		for (timestamp_t offset: { 0, 3600, 24 * 3600 }) {
+			for (int n = 1; n <= 3; ++n) {
+				struct dive *expected = nullptr;
+				for (int j = 0, found = 0; j < dive_table.nr; ++j) {
+					if (dive_within_time_range(dive_table.dives[j], when, offset) && ++found == n) {
+						expected = dive_table.dives[j];
+						break;
+					}
+				}
+				QCOMPARE(find_dive_n_near(when, n, offset), expected);
+			}
+		}
+	}
+}
+
+QTEST_GUILESS_MAIN(TestDiveLookup)
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDIVELOOKUP_H
+#define TESTDIVELOOKUP_H
+
+#include <QtTest>
+
+class TestDiveLookup : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testById();
+	void testByIdAfterDelete();
+	void testByIdAfterInsert();
+	void testClosestTo();
+	void testNear();
+};
+
+#endif
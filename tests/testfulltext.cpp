@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testfulltext.h"
+#include "core/dive.h"
+#include "core/fulltext.h"
+
+#include <algorithm>
+
+static std::vector<dive *> find(int fields, const QString &s)
+{
+	std::vector<dive *> res;
+	FullTextIndex::instance()->findDives(fields, s, res);
+	return res;
+}
+
+void TestFullText::testFindDives()
+{
+	struct dive *d1 = alloc_dive();
+	struct dive *d2 = alloc_dive();
+	d1->notes = strdup("Saw a big octopus near the wreck");
+	d1->buddy = strdup("Jim O'Brien");
+	d2->notes = strdup("Wreck penetration");
+	d2->suit = strdup("Drysuit");
+
+	FullTextIndex *index = FullTextIndex::instance();
+	index->clear();
+	index->addDive(d1);
+	index->addDive(d2);
+
+	std::vector<dive *> both { d1, d2 };
+	std::sort(both.begin(), both.end());
+	QCOMPARE(find(FullTextIndex::NOTES, "wreck"), both);
+	QCOMPARE(find(FullTextIndex::NOTES, "WRECK"), both);
+
+	// Words may be found in the middle of indexed words
+	QCOMPARE(find(FullTextIndex::NOTES, "topu"), std::vector<dive *>{ d1 });
+
+	// The first word of a query may be the end, the last word
+	// the beginning of an indexed word
+	QCOMPARE(find(FullTextIndex::NOTES, "ig octo"), std::vector<dive *>{ d1 });
+	QCOMPARE(find(FullTextIndex::NOTES, "wreck pen"), std::vector<dive *>{ d2 });
+	QCOMPARE(find(FullTextIndex::NOTES, "wreck pen "), std::vector<dive *>());
+
+	// Only the requested fields are searched
+	QCOMPARE(find(FullTextIndex::NOTES, "dry"), std::vector<dive *>());
+	QCOMPARE(find(FullTextIndex::SUIT, "dry"), std::vector<dive *>{ d2 });
+	QCOMPARE(find(FullTextIndex::PEOPLE | FullTextIndex::SUIT, "o'brien"), std::vector<dive *>{ d1 });
+
+	// Strings without word characters can't be looked up
+	std::vector<dive *> res;
+	QVERIFY(!index->findDives(FullTextIndex::NOTES, " - ", res));
+
+	index->clear();
+	free_dive(d1);
+	free_dive(d2);
+}
+
+void TestFullText::testUpdateDives()
+{
+	struct dive *d1 = alloc_dive();
+	struct dive *d2 = alloc_dive();
+	d1->notes = strdup("Reef");
+	d2->notes = strdup("Reef and wreck");
+
+	FullTextIndex *index = FullTextIndex::instance();
+	index->clear();
+	index->addDive(d1);
+	index->addDive(d2);
+	QCOMPARE(find(FullTextIndex::NOTES, "wreck"), std::vector<dive *>{ d2 });
+
+	free(d1->notes);
+	d1->notes = strdup("Wreck");
+	index->updateDive(d1);
+	free(d2->notes);
+	d2->notes = strdup("Reef");
+	index->updateDive(d2);
+	QCOMPARE(find(FullTextIndex::NOTES, "wreck"), std::vector<dive *>{ d1 });
+	QCOMPARE(find(FullTextIndex::NOTES, "reef"), std::vector<dive *>{ d2 });
+
+	index->removeDive(d1);
+	QCOMPARE(find(FullTextIndex::NOTES, "wreck"), std::vector<dive *>());
+
+	index->clear();
+	free_dive(d1);
+	free_dive(d2);
+}
+
+QTEST_GUILESS_MAIN(TestFullText)
@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTFULLTEXT_H
+#define TESTFULLTEXT_H
+
+#include <QtTest>
+
+class TestFullText : public QObject {
+	Q_OBJECT
+private slots:
+	void testFindDives();
+	void testUpdateDives();
+};
+
+#endif
@@ -68,4 +68,21 @@ void TestMerge::testMergeBackwards()
 	}
 }
 
+void TestMerge::testMergeReimport()
+{
+	/*
+	 * check that importing a log again merges every dive into its copy
+	 */
+	struct dive_table table = { 0 };
+	struct trip_table trips = { 0 };
+	struct dive_site_table sites = { 0 };
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &table, &trips, &sites), 0);
+	add_imported_dives(&table, &trips, &sites, IMPORT_MERGE_ALL_TRIPS);
+	int nr = dive_table.nr;
+	QVERIFY(nr > 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &table, &trips, &sites), 0);
+	add_imported_dives(&table, &trips, &sites, IMPORT_MERGE_ALL_TRIPS);
+	QCOMPARE(dive_table.nr, nr);
+}
+
 QTEST_GUILESS_MAIN(TestMerge)
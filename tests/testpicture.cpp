@@ -3,7 +3,10 @@
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
+#include "core/metadata.h"
+#include "core/divelist.h"
 #include <QString>
+#include <vector>
 #include <core/qthelper.h>
 
 void TestPicture::initTestCase()
@@ -17,6 +20,32 @@ void TestPicture::initTestCase()
 #define PIC1_HASH "929ad9499b7ae7a9e39ef63eb6c239604ac2adfa"
 #define PIC2_HASH "fa8bd48f8f24017a81e1204f52300bd98b43d4a7"
 
+void TestPicture::scanMetadata()
+{
+	QVector<QString> files {
+		SUBSURFACE_TEST_DATA "/dives/images/wreck.jpg",
+		SUBSURFACE_TEST_DATA "/dives/images/does_not_exist.jpg",
+		SUBSURFACE_TEST_DATA "/dives/images/data_after_EOI.jpg"
+	};
+	int done = 0;
+	QVector<media_metadata> res = scan_metadata(files, [&done](int n) { done = n; return true; });
+	QCOMPARE(res.size(), 3);
+	QCOMPARE(done, 3);
+	QCOMPARE(res[0].type, MEDIATYPE_PICTURE);
+	QCOMPARE(res[1].type, MEDIATYPE_IO_ERROR);
+	QCOMPARE(res[2].type, MEDIATYPE_PICTURE);
+	QCOMPARE(res[0].data.location.lat.udeg, 47934500);
+	QCOMPARE(res[2].data.timestamp - res[0].data.timestamp, (timestamp_t)60);
+
+	// The second read comes from the cache and gives the same result
+	struct metadata md;
+	QCOMPARE(get_metadata(qPrintable(files[0]), &md), MEDIATYPE_PICTURE);
+	QCOMPARE(md.timestamp, res[0].data.timestamp);
+
+	// Canceling returns no results
+	QVERIFY(scan_metadata(files, [](int) { return false; }).isEmpty());
+}
+
 void TestPicture::addPicture()
 {
 	struct dive *dive;
@@ -52,5 +81,69 @@ void TestPicture::addPicture()
 	QCOMPARE(localFilePath(pic2->filename), QString(PIC2_NAME));
 }
 
+// Replace the dive table by selected dives with the given start times and durations in minutes
+static void setupDives(const std::vector<std::pair<int, int>> &times)
+{
+	clear_dive_file_data();
+	for (auto t: times) {
+		struct dive *d = alloc_dive();
+		d->when = t.first * 60;
+		d->duration.seconds = t.second * 60;
+		d->selected = true;
+		record_dive(d);
+	}
+	sort_dive_table(&dive_table);
+}
+
+static std::vector<int> matchPictures(const std::vector<int> &minutes, int shift, bool matchAll)
+{
+	std::vector<timestamp_t> timestamps;
+	for (int m: minutes)
+		timestamps.push_back(m * 60);
+	std::vector<struct dive *> dives(minutes.size());
+	match_pictures_to_dives(timestamps.size(), timestamps.data(), shift * 60, matchAll, dives.data());
+
+	// Return the indexes of the matched dives, -1 for no match
+	std::vector<int> res;
+	for (struct dive *d: dives)
+		res.push_back(d ? get_divenr(d) : -1);
+	return res;
+}
+
+void TestPicture::matchOverlappingDives()
+{
+	// Dive 0 from 100 to 220, dive 1 from 120 to 130 within dive 0, dive 2 from 400 to 450
+	setupDives({ { 100, 120 }, { 120, 10 }, { 400, 50 } });
+
+	// A picture within both dives goes to the dive that started last,
+	// a picture after the short dive goes to the long dive, which it is part of.
+	// The pictures are passed in arbitrary order.
+	QCOMPARE(matchPictures({ 200, 125, 110, 300, 500 }, 0, true), std::vector<int>({ 0, 1, 0, 0, 2 }));
+	QCOMPARE(matchPictures({ 200, 125, 110, 300, 500 }, 0, false), std::vector<int>({ 0, 1, 0, -1, -1 }));
+
+	// The time shift is applied before matching
+	QCOMPARE(matchPictures({ 200, 240 }, 200, false), std::vector<int>({ 2, 2 }));
+
+	// Only selected dives are considered
+	get_dive(1)->selected = false;
+	QCOMPARE(matchPictures({ 125 }, 0, false), std::vector<int>({ 0 }));
+	clear_dive_file_data();
+}
+
+void TestPicture::matchAdjacentDives()
+{
+	// Dive 0 from 100 to 120, dive 1 from 120 to 140, dive 2 from 160 to 170
+	setupDives({ { 100, 20 }, { 120, 20 }, { 160, 10 } });
+
+	// A picture at the boundary of two dives goes to the dive that starts there.
+	// Between two dives, the closer one wins and on ties the earlier one.
+	QCOMPARE(matchPictures({ 120, 119, 150, 151, 149 }, 0, false), std::vector<int>({ 1, 0, 1, 2, 1 }));
+
+	// The single-picture check agrees with the bulk matching
+	QVERIFY(picture_check_valid_time(169 * 60, 0));
+	QVERIFY(!picture_check_valid_time(200 * 60, 0));
+	QVERIFY(picture_check_valid_time(200 * 60, -30 * 60));
+	clear_dive_file_data();
+}
 
 QTEST_GUILESS_MAIN(TestPicture)
@@ -8,7 +8,10 @@ class TestPicture : public QObject {
 	Q_OBJECT
 private slots:
 	void initTestCase();
+	void scanMetadata();
 	void addPicture();
+	void matchOverlappingDives();
+	void matchAdjacentDives();
 };
 
 #endif
@@ -3,10 +3,33 @@
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
+#include "core/display.h"
+#include "core/profile.h"
+#include "core/divelist.h"
 
 void TestProfile::testRedCeiling()
 {
 	parse_file("../dives/deep.xml", &dive_table, &trip_table, &dive_site_table);
 }
 
+void TestProfile::benchmarkPressureInterpolation()
+{
+	// The sample dives contain multi-cylinder dives with several pressure
+	// transmitters and gaps in the pressure data, which forces the pressure
+	// interpolation to track many segments per cylinder.
+	struct plot_info pi = { 0 };
+
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	QVERIFY(dive_table.nr > 0);
+	QBENCHMARK {
+		for (int i = 0; i < dive_table.nr; i++) {
+			struct dive *d = dive_table.dives[i];
+			create_plot_info_new(d, &d->dc, &pi, false, NULL);
+		}
+	}
+	free_plot_info_data(&pi);
+	clear_dive_file_data();
+}
+
 QTEST_GUILESS_MAIN(TestProfile)
@@ -57,6 +57,7 @@ void TestQPrefDisplay::test_set_struct()
 	display->set_geometry("geo1");
 	display->set_windowState("win1");
 	display->set_lastState(17);
+	display->set_opengl_profile(true);
 
 	QCOMPARE(prefs.animation_speed, 27);
 	QCOMPARE(prefs.display_invalid_dives, false);
@@ -74,6 +75,7 @@ void TestQPrefDisplay::test_set_struct()
 	QCOMPARE(display->geometry(), QByteArray("geo1"));
 	QCOMPARE(display->windowState(), QByteArray("win1"));
 	QCOMPARE(display->lastState(), 17);
+	QCOMPARE(display->opengl_profile(), true);
 }
 
 void TestQPrefDisplay::test_set_load_struct()
@@ -98,6 +100,7 @@ void TestQPrefDisplay::test_set_load_struct()
 	display->set_geometry("geo2");
 	display->set_windowState("win2");
 	display->set_lastState(27);
+	display->set_opengl_profile(false);
 
 	prefs.animation_speed = 17;
 	prefs.display_invalid_dives = false;
@@ -122,6 +125,7 @@ void TestQPrefDisplay::test_set_load_struct()
 	QCOMPARE(display->geometry(), QByteArray("geo2"));
 	QCOMPARE(display->windowState(), QByteArray("win2"));
 	QCOMPARE(display->lastState(), 27);
+	QCOMPARE(display->opengl_profile(), false);
 }
 
 void TestQPrefDisplay::test_struct_disk()
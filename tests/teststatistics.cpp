@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "teststatistics.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/statistics.h"
+#include "core/tag.h"
+
+static struct dive *addDive(timestamp_t when, int duration, int maxdepth, int sac)
+{
+	struct dive *d = alloc_dive();
+	d->when = d->dc.when = when;
+	d->duration.seconds = d->dc.duration.seconds = duration;
+	d->maxdepth.mm = d->dc.maxdepth.mm = maxdepth;
+	d->sac = sac;
+	record_dive(d);
+	return d;
+}
+
+// The cylinder counts as used because of the pressure drop
+static void addCylinder(struct dive *d, int idx, const char *type, int o2)
+{
+	cylinder_t *cyl = &d->cylinder[idx];
+	cyl->type.description = strdup(type);
+	cyl->gasmix.o2.permille = o2;
+	cyl->start.mbar = 200000;
+	cyl->end.mbar = 50000;
+}
+
+// Checks that the grouping has exactly the given groups with the given dive counts
+static void compareGroups(const stats_grouping &grouping, const QStringList &names, const QVector<int> &counts)
+{
+	QCOMPARE(grouping.nr, names.size());
+	for (int i = 0; i < grouping.nr; ++i) {
+		QCOMPARE(QString(grouping.groups[i].name), names[i]);
+		QCOMPARE(grouping.groups[i].dive_count, counts[i]);
+	}
+}
+
+void TestStatistics::init()
+{
+	struct dive_site *reef = create_dive_site("Reef", &dive_site_table);
+
+	// 2019-01-01 09:30 UTC
+	struct dive *d1 = addDive(1546335000, 3000, 20000, 15000);
+	d1->buddy = strdup("Alice, Bob");
+	d1->divemaster = strdup(" Alice ");
+	d1->suit = strdup("Drysuit");
+	d1->rating = 3;
+	d1->dc.model = strdup("Perdix");
+	taglist_add_tag(&d1->tag_list, "boat");
+	taglist_add_tag(&d1->tag_list, "wreck");
+	addCylinder(d1, 0, "AL80", 0);
+	addCylinder(d1, 1, "AL80", 320);
+	add_dive_to_dive_site(d1, reef);
+
+	// 2019-01-02 09:10 UTC, without SAC
+	struct dive *d2 = addDive(1546420200, 1800, 10000, 0);
+	d2->buddy = strdup("Bob");
+	d2->suit = strdup("Drysuit");
+	d2->dc.model = strdup("Perdix");
+	taglist_add_tag(&d2->tag_list, "boat");
+	addCylinder(d2, 0, "AL80", 0);
+	add_dive_to_dive_site(d2, reef);
+
+	// 2019-01-03 14:00 UTC, without dive site, buddy, tag or suit
+	struct dive *d3 = addDive(1546524000, 3600, 30000, 20000);
+	d3->dc.model = strdup("Petrel");
+	addCylinder(d3, 0, "D12", 320);
+}
+
+void TestStatistics::cleanup()
+{
+	clear_dive_file_data();
+}
+
+void TestStatistics::testGroupKeys()
+{
+	const stats_group_by by[] = {
+		STATS_BY_SITE, STATS_BY_TAG, STATS_BY_SUIT, STATS_BY_CYLINDER_TYPE,
+		STATS_BY_GASMIX, STATS_BY_DIVE_COMPUTER, STATS_BY_HOUR
+	};
+	const int nr = sizeof(by) / sizeof(by[0]);
+	stats_grouping groupings[nr];
+	calculate_stats_groups(groupings, by, nr, false);
+
+	for (int i = 0; i < nr; ++i)
+		QCOMPARE(groupings[i].by, by[i]);
+	compareGroups(groupings[0], { "Reef" }, { 2 });
+	compareGroups(groupings[1], { "boat", "wreck" }, { 2, 1 });
+	compareGroups(groupings[2], { "Drysuit" }, { 2 });
+	compareGroups(groupings[3], { "AL80", "D12" }, { 2, 1 });
+	compareGroups(groupings[4], { "EAN32", "air" }, { 2, 2 });
+	compareGroups(groupings[5], { "Perdix", "Petrel" }, { 2, 1 });
+	compareGroups(groupings[6], { "09", "14" }, { 2, 1 });
+
+	free_stats_groups(groupings, nr);
+	QCOMPARE(groupings[0].nr, 0);
+	QVERIFY(groupings[0].groups == nullptr);
+}
+
+void TestStatistics::testBuddies()
+{
+	// The buddy lists are split at commas and the names are trimmed.
+	// Divemasters are counted as buddies.
+	const stats_group_by by = STATS_BY_BUDDY;
+	stats_grouping grouping;
+	calculate_stats_groups(&grouping, &by, 1, false);
+	compareGroups(grouping, { "Alice", "Bob" }, { 1, 2 });
+	free_stats_groups(&grouping, 1);
+}
+
+void TestStatistics::testDuplicateKeys()
+{
+	// The first dive has Alice as buddy and divemaster and two AL80
+	// cylinders. It must enter the aggregates of these groups only once.
+	const stats_group_by by[] = { STATS_BY_BUDDY, STATS_BY_CYLINDER_TYPE };
+	stats_grouping groupings[2];
+	calculate_stats_groups(groupings, by, 2, false);
+
+	const stats_group &alice = groupings[0].groups[0];
+	QCOMPARE(alice.dive_count, 1);
+	QCOMPARE(alice.var[STATS_VAR_DURATION].count, 1);
+	QCOMPARE(alice.var[STATS_VAR_DURATION].sum, (int64_t)3000);
+
+	const stats_group &al80 = groupings[1].groups[0];
+	QCOMPARE(al80.dive_count, 2);
+	QCOMPARE(al80.var[STATS_VAR_DURATION].count, 2);
+	QCOMPARE(al80.var[STATS_VAR_DURATION].sum, (int64_t)4800);
+
+	free_stats_groups(groupings, 2);
+}
+
+void TestStatistics::testAggregates()
+{
+	const stats_group_by by = STATS_BY_HOUR;
+	stats_grouping grouping;
+	calculate_stats_groups(&grouping, &by, 1, false);
+
+	const stats_group &morning = grouping.groups[0];
+	const stats_aggregate &duration = morning.var[STATS_VAR_DURATION];
+	QCOMPARE(duration.count, 2);
+	QCOMPARE(duration.min, 1800);
+	QCOMPARE(duration.max, 3000);
+	QCOMPARE(duration.values[0], 1800);
+	QCOMPARE(duration.values[1], 3000);
+	QCOMPARE(stats_aggregate_avg(&duration), 2400);
+
+	// Unknown values, here the SAC of the second dive and the water
+	// temperatures, are not part of the aggregate
+	const stats_aggregate &sac = morning.var[STATS_VAR_SAC];
+	QCOMPARE(sac.count, 1);
+	QCOMPARE(sac.min, 15000);
+	QCOMPARE(sac.max, 15000);
+	QCOMPARE(stats_aggregate_avg(&sac), 15000);
+	QCOMPARE(morning.var[STATS_VAR_WATER_TEMP].count, 0);
+	QCOMPARE(stats_aggregate_avg(&morning.var[STATS_VAR_WATER_TEMP]), 0);
+	QCOMPARE(morning.var[STATS_VAR_RATING].count, 1);
+
+	free_stats_groups(&grouping, 1);
+}
+
+void TestStatistics::testSelectedOnly()
+{
+	dive_table.dives[0]->selected = true;
+	const stats_group_by by = STATS_BY_SITE;
+	stats_grouping grouping;
+	calculate_stats_groups(&grouping, &by, 1, true);
+	compareGroups(grouping, { "Reef" }, { 1 });
+	QCOMPARE(grouping.groups[0].var[STATS_VAR_MAX_DEPTH].max, 20000);
+	free_stats_groups(&grouping, 1);
+}
+
+void TestStatistics::testPercentile()
+{
+	int values[] = { 10, 20, 30, 40 };
+	stats_aggregate aggregate = { 4, 100, 10, 40, values };
+
+	// Nearest rank: the smallest value with at least percent of the values at or below it
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 0), 10);
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 25), 10);
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 26), 20);
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 50), 20);
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 75), 30);
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 100), 40);
+	QCOMPARE(stats_aggregate_avg(&aggregate), 25);
+
+	aggregate.count = 1;
+	QCOMPARE(stats_aggregate_percentile(&aggregate, 50), 10);
+
+	stats_aggregate empty = { 0, 0, 0, 0, nullptr };
+	QCOMPARE(stats_aggregate_percentile(&empty, 50), 0);
+	QCOMPARE(stats_aggregate_avg(&empty), 0);
+}
+
+QTEST_GUILESS_MAIN(TestStatistics)
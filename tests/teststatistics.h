@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSTATISTICS_H
+#define TESTSTATISTICS_H
+
+#include <QtTest>
+
+class TestStatistics : public QObject {
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+
+	void testGroupKeys();
+	void testBuddies();
+	void testDuplicateKeys();
+	void testAggregates();
+	void testSelectedOnly();
+	void testPercentile();
+};
+
+#endif
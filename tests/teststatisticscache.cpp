@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "teststatisticscache.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/file.h"
+#include "core/statisticscache.h"
+#include "core/trip.h"
+
+// The averages are calculated differently (from exact sums instead of
+// running averages), therefore only compare the counts and totals.
+static void compareStats(const stats_t &s1, const stats_t &s2)
+{
+	QCOMPARE(s1.period, s2.period);
+	QCOMPARE(s1.selection_size, s2.selection_size);
+	QCOMPARE(s1.total_time.seconds, s2.total_time.seconds);
+	QCOMPARE(s1.longest_time.seconds, s2.longest_time.seconds);
+	QCOMPARE(s1.max_depth.mm, s2.max_depth.mm);
+	QCOMPARE(s1.combined_max_depth.mm, s2.combined_max_depth.mm);
+	QCOMPARE(s1.max_sac.mliter, s2.max_sac.mliter);
+	QCOMPARE(s1.combined_temp.mkelvin, s2.combined_temp.mkelvin);
+	QCOMPARE(s1.combined_count, s2.combined_count);
+	QCOMPARE(s1.is_trip, s2.is_trip);
+}
+
+static void compareSummaries()
+{
+	stats_summary_auto_free expected, cached;
+	calculate_stats_summary(&expected, false);
+	StatisticsCache::instance()->calculateSummary(&cached, false);
+
+	int i;
+	for (i = 0; expected.stats_yearly[i].period; ++i)
+		compareStats(expected.stats_yearly[i], cached.stats_yearly[i]);
+	QCOMPARE(cached.stats_yearly[i].period, 0);
+	for (i = 0; expected.stats_monthly[i].selection_size; ++i)
+		compareStats(expected.stats_monthly[i], cached.stats_monthly[i]);
+	QCOMPARE(cached.stats_monthly[i].selection_size, 0u);
+	for (i = 0; expected.stats_by_trip[i].is_trip; ++i)
+		compareStats(expected.stats_by_trip[i], cached.stats_by_trip[i]);
+	QCOMPARE(cached.stats_by_trip[i].is_trip, false);
+	for (i = 0; i <= NUM_DIVEMODE; ++i)
+		compareStats(expected.stats_by_type[i], cached.stats_by_type[i]);
+	for (i = 0; i <= STATS_MAX_DEPTH / STATS_DEPTH_BUCKET; ++i)
+		compareStats(expected.stats_by_depth[i], cached.stats_by_depth[i]);
+	for (i = 0; i <= STATS_MAX_TEMP / STATS_TEMP_BUCKET; ++i)
+		compareStats(expected.stats_by_temp[i], cached.stats_by_temp[i]);
+}
+
+void TestStatisticsCache::initTestCase()
+{
+	copy_prefs(&default_prefs, &prefs);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table), 0);
+	process_loaded_dives();
+	QVERIFY(dive_table.nr > 0);
+}
+
+void TestStatisticsCache::cleanupTestCase()
+{
+	StatisticsCache::instance()->invalidate();
+	clear_dive_file_data();
+}
+
+void TestStatisticsCache::testSummary()
+{
+	compareSummaries();
+}
+
+void TestStatisticsCache::testDiveChanged()
+{
+	// Make sure that the cache is filled, then change the longest dive
+	// and inform the cache via the notifier.
+	compareSummaries();
+
+	struct dive *longest = dive_table.dives[0];
+	for (int i = 1; i < dive_table.nr; ++i) {
+		if (dive_table.dives[i]->duration.seconds > longest->duration.seconds)
+			longest = dive_table.dives[i];
+	}
+	longest->duration.seconds = 1;
+	longest->maxdepth.mm += 1000;
+	emit diveListNotifier.divesChanged(QVector<dive *>{ longest }, DiveField::DURATION);
+	compareSummaries();
+}
+
+QTEST_GUILESS_MAIN(TestStatisticsCache)
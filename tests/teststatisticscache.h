@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSTATISTICSCACHE_H
+#define TESTSTATISTICSCACHE_H
+
+#include <QtTest>
+
+class TestStatisticsCache : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void testSummary();
+	void testDiveChanged();
+};
+
+#endif
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testthumbnailpack.h"
+#include "core/metadata.h"
+#include "core/thumbnailpack.h"
+
+#define PACK_NAME "./testthumbnails.pack"
+
+void TestThumbnailPack::init()
+{
+	QFile::remove(PACK_NAME);
+}
+
+void TestThumbnailPack::cleanup()
+{
+	QFile::remove(PACK_NAME);
+}
+
+void TestThumbnailPack::testPutGet()
+{
+	ThumbnailPack pack(PACK_NAME);
+	ThumbnailPack::Entry entry;
+	QByteArray data;
+	QVERIFY(!pack.get("a.jpg", entry, data));
+
+	pack.put("a.jpg", MEDIATYPE_PICTURE, 0, "picture a");
+	pack.put("b.mp4", MEDIATYPE_VIDEO, 42, "video b");
+	QCOMPARE(pack.count(), 2);
+	QVERIFY(pack.get("a.jpg", entry, data));
+	QCOMPARE(data, QByteArray("picture a"));
+	QCOMPARE(entry.type, (quint32)MEDIATYPE_PICTURE);
+	QVERIFY(pack.get("b.mp4", entry, data));
+	QCOMPARE(data, QByteArray("video b"));
+	QCOMPARE(entry.duration, 42);
+
+	// Replacing a thumbnail leaves the old record as garbage
+	QCOMPARE(pack.garbageSize(), 0);
+	pack.put("a.jpg", MEDIATYPE_PICTURE, 0, "new picture a");
+	QCOMPARE(pack.count(), 2);
+	QVERIFY(pack.garbageSize() > 0);
+	QVERIFY(pack.get("a.jpg", entry, data));
+	QCOMPARE(data, QByteArray("new picture a"));
+}
+
+void TestThumbnailPack::testReopen()
+{
+	{
+		ThumbnailPack pack(PACK_NAME);
+		pack.put("a.jpg", MEDIATYPE_PICTURE, 0, "picture a");
+		pack.put("a.jpg", MEDIATYPE_UNKNOWN, 0, "unknown a");
+	}
+	ThumbnailPack pack(PACK_NAME);
+	ThumbnailPack::Entry entry;
+	QByteArray data;
+	QCOMPARE(pack.count(), 1);
+	QVERIFY(pack.get("a.jpg", entry, data));
+	QCOMPARE(data, QByteArray("unknown a"));
+	QCOMPARE(entry.type, (quint32)MEDIATYPE_UNKNOWN);
+}
+
+void TestThumbnailPack::testTruncated()
+{
+	qint64 size;
+	{
+		ThumbnailPack pack(PACK_NAME);
+		pack.put("a.jpg", MEDIATYPE_PICTURE, 0, "picture a");
+		size = pack.fileSize();
+		pack.put("b.jpg", MEDIATYPE_PICTURE, 0, "picture b");
+	}
+
+	// Simulate an interrupted write of the second record
+	QFile file(PACK_NAME);
+	QVERIFY(file.open(QIODevice::ReadWrite));
+	QVERIFY(file.resize(file.size() - 3));
+	file.close();
+
+	ThumbnailPack pack(PACK_NAME);
+	ThumbnailPack::Entry entry;
+	QByteArray data;
+	QCOMPARE(pack.count(), 1);
+	QCOMPARE(pack.fileSize(), size);
+	QVERIFY(!pack.get("b.jpg", entry, data));
+	pack.put("c.jpg", MEDIATYPE_PICTURE, 0, "picture c");
+	QVERIFY(pack.get("c.jpg", entry, data));
+	QCOMPARE(data, QByteArray("picture c"));
+}
+
+void TestThumbnailPack::testCompact()
+{
+	ThumbnailPack pack(PACK_NAME);
+	for (int i = 0; i < 10; ++i) {
+		pack.put("a.jpg", MEDIATYPE_PICTURE, 0, QByteArray(1000, 'a' + i));
+		pack.put("b.jpg", MEDIATYPE_PICTURE, 0, QByteArray(10, 'b'));
+	}
+	qint64 size = pack.fileSize();
+	pack.compact();
+	QCOMPARE(pack.garbageSize(), 0);
+	QVERIFY(pack.fileSize() < size);
+	QCOMPARE(pack.count(), 2);
+
+	ThumbnailPack::Entry entry;
+	QByteArray data;
+	QVERIFY(pack.get("a.jpg", entry, data));
+	QCOMPARE(data, QByteArray(1000, 'a' + 9));
+	QVERIFY(pack.get("b.jpg", entry, data));
+	QCOMPARE(data, QByteArray(10, 'b'));
+}
+
+QTEST_GUILESS_MAIN(TestThumbnailPack)
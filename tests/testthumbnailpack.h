@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTTHUMBNAILPACK_H
+#define TESTTHUMBNAILPACK_H
+
+#include <QtTest>
+
+class TestThumbnailPack : public QObject {
+	Q_OBJECT
+private slots:
+	void init();
+	void cleanup();
+
+	void testPutGet();
+	void testReopen();
+	void testTruncated();
+	void testCompact();
+};
+
+#endif
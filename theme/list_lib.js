@@ -1197,6 +1197,15 @@ var volume_unit = "l";
 */
 function canvas_draw()
 {
+	//dives without samples, or whose samples couldn't be loaded, have no profile
+	if (!items[dive_id].samples || items[dive_id].samples.length === 0) {
+		if (plot1) {
+			plot1.destroy();
+			plot1 = undefined;
+		}
+		document.getElementById("chart1").innerHTML = '<p>' + translate.No_profile + '</p>';
+		return;
+	}
 	document.getElementById("chart1").innerHTML = "";
 	var depthData = new Array();
 	var pressureData = new Array();
@@ -1348,6 +1357,14 @@ function canvas_draw()
 */
 function showDiveDetails(dive)
 {
+	//the samples may be stored in a separate file, load it first.
+	if (items[dive].samples === undefined && items[dive].samples_file !== undefined) {
+		loadSamples(items[dive], function() {
+			showDiveDetails(dive);
+		});
+		return;
+	}
+
 	//set global variables
 	dive_id = dive;
 	points = items[dive_id].samples;
@@ -1368,6 +1385,39 @@ function showDiveDetails(dive)
 	scrollToTheTop();
 }
 
+/**
+*The samples of large exports are written into one file per dive,
+*which calls samples_loaded() with the number of the dive.
+*Loading is done by adding a script element, because browsers
+*don't allow requests to local files. If the file can't be loaded,
+*the dive is shown without profile.
+*/
+var samplesPending = {};
+
+function loadSamples(dive, callback)
+{
+	if (samplesPending[dive.number] !== undefined)
+		return;
+	samplesPending[dive.number] = function(samples) {
+		dive.samples = samples;
+		callback();
+	};
+	var fileref = document.createElement('script');
+	fileref.onerror = function() {
+		samples_loaded(dive.number, []);
+	};
+	fileref.setAttribute("src", location.pathname + "_files/" + dive.samples_file);
+	document.getElementsByTagName("head")[0].appendChild(fileref);
+}
+
+function samples_loaded(number, samples)
+{
+	var callback = samplesPending[number];
+	delete samplesPending[number];
+	if (callback !== undefined)
+		callback(samples);
+}
+
 function setDiveTitle(dive)
 {
 	document.getElementById("dive_no").innerHTML = translate.Dive_No + (settings.subsurfaceNumbers === '0' ?